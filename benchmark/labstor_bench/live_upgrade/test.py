@@ -14,19 +14,34 @@ class LiveUpgradeTest(Test):
         TextFile(new_conf).Save(conf_text)
         return new_conf
 
+    def _Report(self, labstack, n_upgrades, log):
+        #Each line is: key,tenant,reqs,worst_pause_us
+        worst = {}
+        with open(log) as fp:
+            for line in fp:
+                key, tenant, reqs, pause_us = line.strip().split(',')
+                worst[int(tenant)] = max(worst.get(int(tenant), 0), float(pause_us))
+        for tenant, pause_us in sorted(worst.items()):
+            print(f"{labstack},{n_upgrades},tenant={tenant},worst_pause_us={pause_us}")
+
     def Run(self):
         LabStorKernelServerStart().Run()
         LabStorRuntimeStart(os.path.join(self.root, 'conf', 'config.yaml')).Run()
         MountLabStack(os.path.join(self.root, 'conf', 'labstack_async.yaml')).Run()
         MountLabStack(os.path.join(self.root, 'conf', 'labstack_sync.yaml')).Run()
 
+        n_tenants = 4
         n_upgrades = [0, 256, 512, 1024]
         for n in n_upgrades:
             for labstack in ['async', 'sync']:
-                node = LaunchDummy(1, 16, 30).Run(exec_async=True)
+                log = os.path.join(self.config['LOG_DIR'], f"live_upgrade_{labstack}_{n}.csv")
+                if os.path.exists(log):
+                    os.remove(log)
+                node = LaunchDummy(n_tenants, 16, 30, log=log).Run(exec_async=True)
                 for i in range(n):
                     ModifyLabStack(os.path.join(self.root, 'conf', f"labstack_{labstack}.yaml")).Run(exec_async=True)
                 node.Wait()
+                self._Report(labstack, n, log)
 
         LabStorRuntimeStop().Run()
         LabStorKernelServerStop().Run()
@@ -34,6 +34,8 @@ class ModifyLabStack(ExecNode):
         super().__init__(cmd, **kwargs)
 
 class LaunchDummy(ExecNode):
-    def __init__(self, nthreads, qdepth, time, **kwargs):
-        cmd = f"labstor_dummy {nthreads} {qdepth} {time}"
+    def __init__(self, nthreads, qdepth, time, key='lab::dummy', log=None, **kwargs):
+        cmd = f"labstor_dummy {nthreads} {qdepth} {time} {key}"
+        if log is not None:
+            cmd += f" {log}"
         super().__init__(cmd, **kwargs)
\ No newline at end of file
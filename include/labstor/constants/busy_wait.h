@@ -65,6 +65,19 @@
     labstor_timer_out
 #endif
 
+/*CLOCK*/
+#if defined(KERNEL_BUILD)
+static inline uint64_t labstor_get_monotonic_ns(void) {
+    return ktime_get_ns();
+}
+#else
+#include <labstor/types/tsc_clock.h>
+/*One rdtsc once the clock page is attached; clock_gettime before then or without an invariant TSC*/
+static inline uint64_t labstor_get_monotonic_ns(void) {
+    return labstor_tsc_clock_now_ns(__atomic_load_n(&labstor_clock_page, __ATOMIC_ACQUIRE));
+}
+#endif
+
 /*BUSY WAIT*/
 
 #define MAX_YIELDS 1000
@@ -115,7 +128,7 @@
 
 /*RELEASE ARBITRARY SPINLOCK*/
 #define LABSTOR_SPINLOCK_RELEASE(lockptr) \
-    *lockptr = 0;
+    __atomic_store_n(lockptr, 0, __ATOMIC_RELEASE);
 
 /*INFINITE SPINLOCK*/
 
@@ -124,7 +137,7 @@
     LABSTOR_INF_SPINWAIT_PREAMBLE()
 static inline int LABSTOR_INF_LOCK_TRYLOCK(uint16_t *lockptr) {
     uint16_t unlocked = 0, is_locked = 1;
-    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
 }
 #define LABSTOR_INF_LOCK_ACQUIRE(lockptr)\
     LABSTOR_SIMPLE_SPINWAIT_START()\
@@ -136,7 +149,7 @@ static inline int LABSTOR_INF_LOCK_TRYLOCK(uint16_t *lockptr) {
 #define LABSTOR_INF_LOCK_PREAMBLE()
 static inline int LABSTOR_INF_LOCK_TRYLOCK(uint16_t *lockptr) {
     uint16_t unlocked = 0, is_locked = 1;
-    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
 }
 #define LABSTOR_INF_LOCK_ACQUIRE(lockptr) \
     TRACEPOINT("INF SPINLOCK")                                      \
@@ -151,7 +164,7 @@ static inline int LABSTOR_INF_LOCK_TRYLOCK(uint16_t *lockptr) {
     LABSTOR_TIMED_SPINWAIT_PREAMBLE()
 static inline int LABSTOR_TIMED_LOCK_TRYLOCK(uint16_t *lockptr) {
     uint16_t unlocked = 0, is_locked = 1;
-    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(lockptr, &unlocked, is_locked, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
 }
 #define LABSTOR_TIMED_LOCK_ACQUIRE(lockptr, max_ms)\
     LABSTOR_TIMED_SPINWAIT_START(max_ms)\
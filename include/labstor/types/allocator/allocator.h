@@ -38,6 +38,7 @@ namespace labstor {
 
 class GenericAllocator : public shmem_type {
 public:
+    virtual ~GenericAllocator() = default;
     void* Alloc(uint32_t size) {
         return Alloc(size, labstor::ThreadLocal::GetTid());
     }
@@ -53,7 +53,11 @@ static inline void labstor_segment_allocator_Attach(struct labstor_segment_alloc
 }
 
 static inline void *labstor_segment_allocator_Alloc(struct labstor_segment_allocator *alloc, uint32_t size) {
-    void *region = LABSTOR_REGION_ADD(alloc->offset_, alloc->region_);
+    void *region;
+    if(alloc->offset_ + size > alloc->max_size_) {
+        return NULL;
+    }
+    region = LABSTOR_REGION_ADD(alloc->offset_, alloc->region_);
     alloc->offset_ += size;
     return region;
 }
@@ -71,7 +75,7 @@ void labstor_segment_allocator::Attach(void *region, uint32_t size) {
     labstor_segment_allocator_Attach(this, region, size);
 }
 
-template<typename T=void>
+template<typename T>
 T* labstor_segment_allocator::Alloc(uint32_t size) {
     return reinterpret_cast<T*>(labstor_segment_allocator_Alloc(this, size));
 }
@@ -51,6 +51,11 @@
 #define LABSTOR_QP_LOW_LATENCY 0
 #define LABSTOR_QP_SHMEM 0
 
+/*The queues every client gets at connect time*/
+#define LABSTOR_QP_CLIENT_DEFAULT (LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY)
+/*The queues the server creates for modules to forward requests to one another, in the shared pool and in each worker group*/
+#define LABSTOR_QP_PRIVATE_DEFAULT (LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY)
+
 #define LABSTOR_QP_IS_INTERMEDIATE(flags) (flags & LABSTOR_QP_INTERMEDIATE)
 #define LABSTOR_QP_IS_UNORDERED(flags) (flags & LABSTOR_QP_UNORDERED)
 #define LABSTOR_QP_IS_BATCH(flags) (flags & LABSTOR_QP_BATCH)
@@ -67,7 +72,8 @@
 #define LABSTOR_QP_ALL_FLAGS 31
 
 #define LABSTOR_GET_QP_IDX(qid) (qid.cnt_)
-#define LABSTOR_GET_QP_IPC_ID(qid) ((qid).pid_)
+#define LABSTOR_GET_QP_IPC_ID(qid) ((qid).ipc_id_)
+#define LABSTOR_GET_QP_PID(qid) ((qid).pid_)
 
 /*QUEUE DEFINITION*/
 
@@ -114,7 +120,7 @@ struct labstor_queue_pair {
 static inline void labstor_queue_pair_ptr_Init(struct labstor_queue_pair_ptr *ptr, labstor_qid_t qid, void *sq_region, void *cq_region, void *base_region) {
     ptr->sq_off_ = LABSTOR_REGION_SUB(sq_region, base_region);
     ptr->cq_off_ = LABSTOR_REGION_SUB(cq_region, base_region);
-    ptr->pid_ = LABSTOR_GET_QP_IPC_ID(qid);
+    ptr->pid_ = LABSTOR_GET_QP_PID(qid);
 }
 
 static inline uint32_t labstor_queue_pair_GetSize_global(uint32_t queue_depth) {
@@ -232,7 +238,7 @@ static inline labstor_qid_t* labstor_queue_pair_GetQID(struct labstor_queue_pair
 }
 
 static inline int labstor_queue_pair_GetPID(struct labstor_queue_pair *qp) {
-    return LABSTOR_GET_QP_IPC_ID(*labstor_queue_pair_GetQID(qp));
+    return LABSTOR_GET_QP_PID(*labstor_queue_pair_GetQID(qp));
 }
 
 #ifdef __cplusplus
@@ -271,7 +277,15 @@ void labstor_queue_pair::RemoteAttach(labstor::ipc::queue_pair_ptr &ptr, void *k
 }
 
 namespace labstor::ipc {
-struct shmem_queue_pair : public labstor::queue_pair, public labstor_queue_pair {
+struct shmem_queue_pair final : public labstor::queue_pair, public labstor::direct_queue_pair<shmem_queue_pair>, public labstor_queue_pair {
+    //Calls made on a shmem_queue_pair* bypass the vtable
+    using labstor::direct_queue_pair<shmem_queue_pair>::Enqueue;
+    using labstor::direct_queue_pair<shmem_queue_pair>::Peek;
+    using labstor::direct_queue_pair<shmem_queue_pair>::Dequeue;
+    using labstor::direct_queue_pair<shmem_queue_pair>::Complete;
+    using labstor::direct_queue_pair<shmem_queue_pair>::IsComplete;
+    using labstor::direct_queue_pair<shmem_queue_pair>::Wait;
+
     uint32_t GetDepth() {
         return labstor_queue_pair::GetDepth();
     }
@@ -279,8 +293,27 @@ struct shmem_queue_pair : public labstor::queue_pair, public labstor_queue_pair
     inline labstor::ipc::qid_t& GetQID() {
         return labstor_queue_pair::GetQID();
     }
+    //The submission queue is single-producer. Shared queues serialize their producers.
+    bool shared_ = false;
+    uint16_t enqueue_lock_ = 0;
+
+    inline void MarkShared() {
+        shared_ = true;
+    }
+    inline bool IsShared() {
+        return shared_;
+    }
     inline bool _Enqueue(labstor::ipc::request *rq, labstor::ipc::qtok_t &qtok) {
-        if(!labstor_queue_pair_Enqueue(this, reinterpret_cast<labstor::ipc::request*>(rq), &qtok)) {
+        bool ret;
+        if(shared_) {
+            LABSTOR_INF_LOCK_PREAMBLE()
+            LABSTOR_INF_LOCK_ACQUIRE(&enqueue_lock_)
+            ret = labstor_queue_pair_Enqueue(this, reinterpret_cast<labstor::ipc::request*>(rq), &qtok);
+            LABSTOR_INF_LOCK_RELEASE(&enqueue_lock_)
+        } else {
+            ret = labstor_queue_pair_Enqueue(this, reinterpret_cast<labstor::ipc::request*>(rq), &qtok);
+        }
+        if(!ret) {
             throw labstor::FAILED_TO_ENQUEUE.format();
         }
         return true;
@@ -174,7 +174,7 @@ static inline bool labstor_request_ring_buffer_Peek(struct labstor_request_ring_
 #ifdef ENABLE_LOCKING
     if(LABSTOR_INF_LOCK_TRYLOCK(&rbuf->header_->d_lock_)) {
 #endif
-    if(rbuf->header_->enqueued_ == rbuf->header_->dequeued_) { return false; }
+    if((uint32_t)i >= rbuf->header_->enqueued_ - rbuf->header_->dequeued_) { return false; }
     entry = (rbuf->header_->dequeued_ + i) % rbuf->header_->max_depth_;
     *data = rbuf->queue_[entry];
     return true;
@@ -30,6 +30,8 @@
 #include "labstor/constants/busy_wait.h"
 #include "labstor/types/basics.h"
 #include "labstor/types/data_structures/bitmap.h"
+#include "labstor/constants/constants.h"
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #ifdef __cplusplus
 #include "labstor/types/shmem_type.h"
 #include "labstor/userspace/util/errors.h"
@@ -42,9 +44,14 @@ struct labstor_work_queue_secure_header {
     uint16_t plug_[2];
 };
 
+#define LABSTOR_WORK_QUEUE_MODULE_CACHE 4
+
 struct labstor_work_queue_secure_entry {
     struct labstor_queue_pair *qp_;
     struct labstor_credentials *creds_;
+    void *qp_ptr_; //The registered labstor::ipc::shmem_queue_pair, resolved when the QP is assigned
+    uint32_t ns_ids_[LABSTOR_WORK_QUEUE_MODULE_CACHE];
+    void *modules_[LABSTOR_WORK_QUEUE_MODULE_CACHE];
 };
 
 #ifdef __cplusplus
@@ -60,8 +67,12 @@ struct labstor_work_queue_secure {
     inline void* GetRegion();
     inline void Init(void *region, uint32_t region_size, uint32_t max_depth = 0);
     inline void Attach(void *region);
-    inline bool Enqueue(struct labstor_queue_pair *qp, struct labstor_credentials *creds);
-    inline bool Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, int i);
+    inline bool Enqueue(struct labstor_queue_pair *qp, struct labstor_credentials *creds, void *qp_ptr = nullptr);
+    inline bool Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, uint32_t i);
+    inline struct labstor_work_queue_secure_entry* PeekEntry(uint32_t i);
+    inline void ClearModuleCache();
+    inline uint32_t RemoveByPID(uint32_t pid);
+    inline bool Remove(struct labstor_queue_pair *qp);
     inline uint32_t GetDepth();
     inline uint32_t GetMaxDepth();
 #endif
@@ -125,23 +136,87 @@ static inline void labstor_work_queue_secure_Attach(struct labstor_work_queue_se
     rbuf->queue_ = (struct labstor_work_queue_secure_entry*)(rbuf->header_ + 1);
 }
 
-static inline bool labstor_work_queue_secure_Enqueue(struct labstor_work_queue_secure *rbuf, struct labstor_queue_pair *qp, struct labstor_credentials *creds) {
+static inline void labstor_work_queue_secure_ClearEntryCache(struct labstor_work_queue_secure_entry *entry) {
+    int i;
+    for(i = 0; i < LABSTOR_WORK_QUEUE_MODULE_CACHE; ++i) {
+        entry->ns_ids_[i] = (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY;
+        entry->modules_[i] = NULL;
+    }
+}
+
+static inline void labstor_work_queue_secure_ClearModuleCache(struct labstor_work_queue_secure *rbuf) {
+    uint32_t i;
+    for(i = 0; i < rbuf->header_->enqueued_; ++i) {
+        labstor_work_queue_secure_ClearEntryCache(&rbuf->queue_[i]);
+    }
+}
+
+static inline bool labstor_work_queue_secure_Enqueue(
+        struct labstor_work_queue_secure *rbuf, struct labstor_queue_pair *qp, struct labstor_credentials *creds, void *qp_ptr) {
+    struct labstor_work_queue_secure_entry *entry = NULL;
+    uint32_t i;
     AUTO_TRACE("Enqueued", rbuf->header_->enqueued_, "depth", rbuf->header_->max_depth_)
-    if(rbuf->header_->enqueued_ >= rbuf->header_->max_depth_) { return false; }
-    rbuf->queue_[rbuf->header_->enqueued_].qp_ = qp;
-    rbuf->queue_[rbuf->header_->enqueued_].creds_ = creds;
-    ++rbuf->header_->enqueued_;
+    //Reuse a slot freed by Remove or RemoveByPID before growing the queue
+    for(i = 0; i < rbuf->header_->enqueued_; ++i) {
+        if(rbuf->queue_[i].qp_ == NULL) {
+            entry = &rbuf->queue_[i];
+            break;
+        }
+    }
+    if(entry == NULL) {
+        if(rbuf->header_->enqueued_ >= rbuf->header_->max_depth_) { return false; }
+        entry = &rbuf->queue_[rbuf->header_->enqueued_];
+        entry->qp_ = NULL;
+    }
+    entry->creds_ = creds;
+    entry->qp_ptr_ = qp_ptr;
+    labstor_work_queue_secure_ClearEntryCache(entry);
+    __atomic_store_n(&entry->qp_, qp, __ATOMIC_RELEASE);
+    if(entry == &rbuf->queue_[rbuf->header_->enqueued_]) {
+        __atomic_store_n(&rbuf->header_->enqueued_, rbuf->header_->enqueued_ + 1, __ATOMIC_RELEASE);
+    }
     return true;
 }
 
+static inline struct labstor_work_queue_secure_entry* labstor_work_queue_secure_PeekEntry(
+        struct labstor_work_queue_secure *rbuf, uint32_t i) {
+    if(i >= __atomic_load_n(&rbuf->header_->enqueued_, __ATOMIC_ACQUIRE)) { return NULL; }
+    return &rbuf->queue_[i];
+}
+
 static inline bool labstor_work_queue_secure_Peek(
-        struct labstor_work_queue_secure *rbuf, struct labstor_queue_pair **qp, struct labstor_credentials **creds, int i) {
+        struct labstor_work_queue_secure *rbuf, struct labstor_queue_pair **qp, struct labstor_credentials **creds, uint32_t i) {
     if(i >= rbuf->header_->enqueued_) { return false; }
     *qp = rbuf->queue_[i].qp_;
     *creds = rbuf->queue_[i].creds_;
     return true;
 }
 
+/*
+ * Unlinks every QP belonging to pid. The worker may still be using the entry until it
+ * finishes its current pass, so the caller must wait for the worker to quiesce before freeing the QPs.
+ * */
+static inline uint32_t labstor_work_queue_secure_RemoveByPID(struct labstor_work_queue_secure *rbuf, uint32_t pid) {
+    uint32_t i, count = 0;
+    for(i = 0; i < rbuf->header_->enqueued_; ++i) {
+        struct labstor_queue_pair *qp = rbuf->queue_[i].qp_;
+        if(qp == NULL || labstor_queue_pair_GetQID(qp)->pid_ != pid) { continue; }
+        __atomic_store_n(&rbuf->queue_[i].qp_, NULL, __ATOMIC_RELEASE);
+        ++count;
+    }
+    return count;
+}
+
+static inline bool labstor_work_queue_secure_Remove(struct labstor_work_queue_secure *rbuf, struct labstor_queue_pair *qp) {
+    uint32_t i;
+    for(i = 0; i < rbuf->header_->enqueued_; ++i) {
+        if(rbuf->queue_[i].qp_ != qp) { continue; }
+        __atomic_store_n(&rbuf->queue_[i].qp_, NULL, __ATOMIC_RELEASE);
+        return true;
+    }
+    return false;
+}
+
 #ifdef __cplusplus
 namespace labstor::ipc {
     typedef labstor_work_queue_secure work_queue_secure;
@@ -162,12 +237,24 @@ void labstor_work_queue_secure::Init(void *region, uint32_t region_size, uint32_
 void labstor_work_queue_secure::Attach(void *region) {
     labstor_work_queue_secure_Attach(this, region);
 }
-bool labstor_work_queue_secure::Enqueue(struct labstor_queue_pair *qp, struct labstor_credentials *creds) {
-    return labstor_work_queue_secure_Enqueue(this, qp, creds);
+bool labstor_work_queue_secure::Enqueue(struct labstor_queue_pair *qp, struct labstor_credentials *creds, void *qp_ptr) {
+    return labstor_work_queue_secure_Enqueue(this, qp, creds, qp_ptr);
 }
-bool labstor_work_queue_secure::Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, int i) {
+bool labstor_work_queue_secure::Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, uint32_t i) {
     return labstor_work_queue_secure_Peek(this, &qp, &creds, i);
 }
+struct labstor_work_queue_secure_entry* labstor_work_queue_secure::PeekEntry(uint32_t i) {
+    return labstor_work_queue_secure_PeekEntry(this, i);
+}
+void labstor_work_queue_secure::ClearModuleCache() {
+    labstor_work_queue_secure_ClearModuleCache(this);
+}
+uint32_t labstor_work_queue_secure::RemoveByPID(uint32_t pid) {
+    return labstor_work_queue_secure_RemoveByPID(this, pid);
+}
+bool labstor_work_queue_secure::Remove(struct labstor_queue_pair *qp) {
+    return labstor_work_queue_secure_Remove(this, qp);
+}
 uint32_t labstor_work_queue_secure::GetDepth() {
     return labstor_work_queue_secure_GetDepth(this);
 }
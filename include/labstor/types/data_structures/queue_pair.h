@@ -30,9 +30,12 @@
 #include "shmem_qtok.h"
 #include "shmem_request.h"
 #include "labstor/constants/busy_wait.h"
+#include "labstor/types/hash.h"
 
 #ifdef __cplusplus
 
+#include "shmem_string.h"
+
 namespace labstor {
 class queue_pair {
 public:
@@ -92,21 +95,24 @@ public:
         return reinterpret_cast<T*>(_Wait(qtok, max_ms));
     }
 
-    static labstor_qid_t GetQID(labstor_qid_type_t type, labstor_qid_flags_t flags, uint32_t hash, uint32_t num_qps, int pid) {
+    static labstor_qid_t GetQID(labstor_qid_type_t type, labstor_qid_flags_t flags, uint32_t hash, uint32_t num_qps, int pid, uint16_t ipc_id = LABSTOR_KERNEL_IPC_ID) {
         labstor_qid_t qid;
         qid.type_ = type;
         qid.cnt_ = hash % num_qps;
         qid.pid_ = pid;
         qid.flags_ = flags;
+        qid.ipc_id_ = ipc_id;
         return qid;
     }
-    static labstor_qid_t GetQID(labstor_qid_type_t type, labstor_qid_flags_t flags, const std::string &str, uint32_t ns_id, uint32_t num_qps, int pid) {
-        uint32_t hash = 0;
-        for(size_t i = 0; i < str.size(); ++i) {
-            hash += str[i] << 4*(i%4);
-        }
-        hash *= ns_id;
-        return GetQID(type, flags, hash, num_qps, pid);
+    static labstor_qid_t GetQID(labstor_qid_type_t type, labstor_qid_flags_t flags, const std::string &str, uint32_t ns_id, uint32_t num_qps, int pid, uint16_t ipc_id = LABSTOR_KERNEL_IPC_ID) {
+        return GetQID(type, flags, HashKey(labstor_hash64(str.c_str(), str.size()), ns_id), num_qps, pid, ipc_id);
+    }
+    static labstor_qid_t GetQID(labstor_qid_type_t type, labstor_qid_flags_t flags, const labstor::ipc::string &str, uint32_t ns_id, uint32_t num_qps, int pid, uint16_t ipc_id = LABSTOR_KERNEL_IPC_ID) {
+        return GetQID(type, flags, HashKey(str.Hash(), ns_id), num_qps, pid, ipc_id);
+    }
+    static inline uint32_t HashKey(uint64_t str_hash, uint32_t ns_id) {
+        uint64_t hash = labstor_hash64_int(ns_id, str_hash);
+        return (uint32_t)(hash ^ (hash >> 32));
     }
     static uint32_t GetQIDOff(labstor_qid_type_t type, labstor_qid_flags_t flags, uint32_t hash, uint32_t num_qps, int pid) {
         return GetQID(type, flags, hash, num_qps, pid).cnt_;
@@ -158,6 +164,82 @@ private:
     }
 };
 
+/*
+ * Non-virtual front-end for a concrete queue pair type (CRTP).
+ * Hot paths that know the type of their queue (e.g., the Worker loop) call through this
+ * so that Enqueue/Peek/Dequeue/Complete/IsComplete inline. The virtual interface
+ * in labstor::queue_pair remains for modules that only see a labstor::queue_pair*.
+ * */
+template<typename QP>
+class direct_queue_pair {
+public:
+    template<typename T>
+    inline bool Enqueue(T *rq, labstor::ipc::qtok_t &qtok) {
+        return Derived()->QP::_Enqueue(reinterpret_cast<labstor::ipc::request*>(rq), qtok);
+    }
+    template<typename T>
+    inline bool Peek(T *&rq, int i) {
+        return Derived()->QP::_Peek(reinterpret_cast<labstor::ipc::request**>(&rq), i);
+    }
+    template<typename T>
+    inline bool Dequeue(T *&rq) {
+        return Derived()->QP::_Dequeue(reinterpret_cast<labstor::ipc::request**>(&rq));
+    }
+    template<typename S, typename T=S>
+    inline void Complete(S *old_rq, T *new_rq) {
+        Derived()->QP::_Complete(old_rq->req_id_, reinterpret_cast<labstor::ipc::request*>(new_rq));
+    }
+    template<typename T>
+    inline void Complete(T *rq) {
+        Derived()->QP::_Complete(rq->req_id_, reinterpret_cast<labstor::ipc::request*>(rq));
+    }
+    template<typename T>
+    inline void Complete(labstor::ipc::qtok_t &qtok, T *rq) {
+        Derived()->QP::_Complete(qtok.req_id_, reinterpret_cast<labstor::ipc::request*>(rq));
+    }
+    template<typename T>
+    inline bool IsComplete(int req_id, T *&rq) {
+        return Derived()->QP::_IsComplete(req_id, reinterpret_cast<labstor::ipc::request**>(&rq));
+    }
+    template<typename T>
+    inline bool IsComplete(labstor::ipc::qtok_t &qtok, T *&rq) {
+        return Derived()->QP::_IsComplete(qtok.req_id_, reinterpret_cast<labstor::ipc::request**>(&rq));
+    }
+    template<typename T>
+    inline T* Wait(uint32_t req_id) {
+        LABSTOR_INF_SPINWAIT_PREAMBLE()
+        T *ret = NULL;
+        LABSTOR_INF_SPINWAIT_START()
+            if(IsComplete(req_id, ret)) {
+                return ret;
+            }
+        LABSTOR_INF_SPINWAIT_END()
+    }
+    template<typename T>
+    inline T* Wait(uint32_t req_id, uint32_t max_ms) {
+        LABSTOR_TIMED_SPINWAIT_PREAMBLE()
+        T *ret = NULL;
+        LABSTOR_TIMED_SPINWAIT_START(max_ms)
+            if(IsComplete(req_id, ret)) {
+                return ret;
+            }
+        LABSTOR_TIMED_SPINWAIT_END(max_ms)
+        return NULL;
+    }
+    template<typename T>
+    inline T* Wait(labstor::ipc::qtok_t &qtok) {
+        return Wait<T>(qtok.req_id_);
+    }
+    template<typename T>
+    inline T* Wait(labstor::ipc::qtok_t &qtok, uint32_t max_ms) {
+        return Wait<T>(qtok.req_id_, max_ms);
+    }
+private:
+    inline QP* Derived() {
+        return static_cast<QP*>(this);
+    }
+};
+
 class user_queue_pair : public queue_pair {
 private:
     labstor::ipc::qid_t qid_;
@@ -0,0 +1,242 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef LABSTOR_SHMEM_MOUNT_TRIE_H
+#define LABSTOR_SHMEM_MOUNT_TRIE_H
+
+#ifdef __cplusplus
+
+#include <labstor/constants/macros.h>
+#include <labstor/constants/constants.h>
+#include <labstor/types/shmem_type.h>
+#include <labstor/types/data_structures/shmem_string.h>
+
+/*
+ * A radix trie of LabStack mount points, stored in the namespace region.
+ *
+ * Node labels are not copied: each node references a range of the shared key string it was created
+ * from. The server is the only writer. Readers walk the trie without locks, using the generation as a
+ * sequence counter: it is odd while a writer is modifying the trie, and a walk which overlapped a
+ * modification is repeated. The generation also increases whenever a mounted stack is modified,
+ * so clients can use it to invalidate cached resolutions.
+ * */
+
+#define LABSTOR_MOUNT_TRIE_ROOT 0
+#define LABSTOR_MOUNT_TRIE_NULL 0
+#define LABSTOR_MOUNT_POINT_SEP "::"
+
+namespace labstor::ipc {
+
+struct mount_trie_node {
+    labstor::off_t key_off_;
+    uint16_t label_start_;
+    uint16_t label_len_;
+    uint32_t ns_id_;
+    uint32_t first_child_;
+    uint32_t next_sibling_;
+};
+
+struct mount_trie_header {
+    uint32_t generation_;
+    uint32_t num_nodes_;
+    uint32_t max_nodes_;
+};
+
+class mount_trie : public labstor::shmem_type {
+private:
+    mount_trie_header *header_;
+    mount_trie_node *nodes_;
+    void *base_region_;
+public:
+    static inline uint32_t GetSize(uint32_t max_entries) {
+        //Every insertion creates at most one leaf and splits at most one edge
+        return sizeof(mount_trie_header) + (2*max_entries + 1)*sizeof(mount_trie_node);
+    }
+    inline uint32_t GetSize() {
+        return sizeof(mount_trie_header) + header_->max_nodes_*sizeof(mount_trie_node);
+    }
+    inline void* GetRegion() {
+        return header_;
+    }
+
+    inline void Init(void *base_region, void *region, uint32_t region_size, uint32_t max_entries) {
+        base_region_ = base_region;
+        header_ = (mount_trie_header*)region;
+        nodes_ = (mount_trie_node*)(header_ + 1);
+        header_->generation_ = 0;
+        header_->num_nodes_ = 1;
+        header_->max_nodes_ = (region_size - sizeof(mount_trie_header)) / sizeof(mount_trie_node);
+        if(header_->max_nodes_ > 2*max_entries + 1) {
+            header_->max_nodes_ = 2*max_entries + 1;
+        }
+        memset(&nodes_[LABSTOR_MOUNT_TRIE_ROOT], 0, sizeof(mount_trie_node));
+        nodes_[LABSTOR_MOUNT_TRIE_ROOT].ns_id_ = LABSTOR_INVALID_NAMESPACE_KEY;
+    }
+    inline void Attach(void *base_region, void *region) {
+        base_region_ = base_region;
+        header_ = (mount_trie_header*)region;
+        nodes_ = (mount_trie_node*)(header_ + 1);
+    }
+
+    static inline bool IsMountPoint(labstor::ipc::string key) {
+        return memmem(key.c_str(), key.size(), LABSTOR_MOUNT_POINT_SEP, strlen(LABSTOR_MOUNT_POINT_SEP)) != nullptr;
+    }
+
+    inline uint32_t GetGeneration() {
+        return __atomic_load_n(&header_->generation_, __ATOMIC_ACQUIRE) & ~1u;
+    }
+    inline void MarkModified() {
+        __atomic_fetch_add(&header_->generation_, 2, __ATOMIC_RELEASE);
+    }
+
+    inline bool Insert(labstor::ipc::string key, uint32_t ns_id) {
+        const char *str = key.c_str();
+        uint32_t len = key.size(), pos = 0, node = LABSTOR_MOUNT_TRIE_ROOT;
+        if(key.GetRegion() == nullptr || header_->num_nodes_ + 2 > header_->max_nodes_) {
+            return false;
+        }
+        BeginWrite();
+        while(pos < len) {
+            uint32_t *link = &nodes_[node].first_child_, child;
+            while((child = *link) != LABSTOR_MOUNT_TRIE_NULL && GetLabel(child)[0] != str[pos]) {
+                link = &nodes_[child].next_sibling_;
+            }
+
+            //No edge begins with this character: the rest of the key becomes a leaf
+            if(child == LABSTOR_MOUNT_TRIE_NULL) {
+                uint32_t leaf = NewNode(key, pos, len - pos, ns_id);
+                nodes_[leaf].next_sibling_ = nodes_[node].first_child_;
+                nodes_[node].first_child_ = leaf;
+                EndWrite();
+                return true;
+            }
+
+            //Split the edge where the key diverges from its label
+            uint32_t common = 0;
+            const char *label = GetLabel(child);
+            while(common < nodes_[child].label_len_ && pos + common < len && label[common] == str[pos + common]) {
+                ++common;
+            }
+            if(common < nodes_[child].label_len_) {
+                uint32_t mid = header_->num_nodes_++;
+                nodes_[mid] = nodes_[child];
+                nodes_[mid].label_len_ = common;
+                nodes_[mid].ns_id_ = LABSTOR_INVALID_NAMESPACE_KEY;
+                nodes_[mid].first_child_ = child;
+                nodes_[child].label_start_ += common;
+                nodes_[child].label_len_ -= common;
+                nodes_[child].next_sibling_ = LABSTOR_MOUNT_TRIE_NULL;
+                *link = mid;
+                child = mid;
+            }
+            node = child;
+            pos += common;
+        }
+        nodes_[node].ns_id_ = ns_id;
+        EndWrite();
+        return true;
+    }
+
+    inline bool Remove(labstor::ipc::string key) {
+        uint32_t ns_id = LABSTOR_INVALID_NAMESPACE_KEY, match_len = 0;
+        bool removed = false;
+        BeginWrite();
+        uint32_t node = Walk(key.c_str(), key.size(), ns_id, match_len);
+        if(node != LABSTOR_MOUNT_TRIE_NULL && match_len == key.size()) {
+            nodes_[node].ns_id_ = LABSTOR_INVALID_NAMESPACE_KEY;
+            removed = true;
+        }
+        EndWrite();
+        return removed;
+    }
+
+    /*
+     * Find the longest mount point which is a prefix of path and ends at a '/' or the end of the path.
+     * */
+    inline bool Find(const char *path, uint32_t len, uint32_t &ns_id, uint32_t &match_len) {
+        uint32_t gen, node;
+        do {
+            gen = __atomic_load_n(&header_->generation_, __ATOMIC_ACQUIRE);
+            if(gen & 1) { continue; }
+            node = Walk(path, len, ns_id, match_len);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while((gen & 1) || __atomic_load_n(&header_->generation_, __ATOMIC_ACQUIRE) != gen);
+        return node != LABSTOR_MOUNT_TRIE_NULL;
+    }
+
+private:
+    inline const char* GetLabel(uint32_t node) {
+        labstor::ipc::string key;
+        key.Attach(LABSTOR_REGION_ADD(nodes_[node].key_off_, base_region_));
+        return key.c_str() + nodes_[node].label_start_;
+    }
+
+    inline uint32_t NewNode(labstor::ipc::string &key, uint32_t start, uint32_t len, uint32_t ns_id) {
+        uint32_t node = header_->num_nodes_++;
+        nodes_[node].key_off_ = LABSTOR_REGION_SUB(key.GetRegion(), base_region_);
+        nodes_[node].label_start_ = start;
+        nodes_[node].label_len_ = len;
+        nodes_[node].ns_id_ = ns_id;
+        nodes_[node].first_child_ = LABSTOR_MOUNT_TRIE_NULL;
+        nodes_[node].next_sibling_ = LABSTOR_MOUNT_TRIE_NULL;
+        return node;
+    }
+
+    inline uint32_t Walk(const char *path, uint32_t len, uint32_t &ns_id, uint32_t &match_len) {
+        uint32_t node = LABSTOR_MOUNT_TRIE_ROOT, pos = 0, best = LABSTOR_MOUNT_TRIE_NULL;
+        uint32_t max_nodes = header_->max_nodes_;
+        //Bounded by the number of nodes in case the walk races with a writer
+        for(uint32_t steps = 0; pos < len && steps < max_nodes; ++steps) {
+            uint32_t child = __atomic_load_n(&nodes_[node].first_child_, __ATOMIC_ACQUIRE);
+            while(child != LABSTOR_MOUNT_TRIE_NULL && child < max_nodes && GetLabel(child)[0] != path[pos]) {
+                child = __atomic_load_n(&nodes_[child].next_sibling_, __ATOMIC_ACQUIRE);
+            }
+            if(child == LABSTOR_MOUNT_TRIE_NULL || child >= max_nodes) { break; }
+            uint32_t label_len = nodes_[child].label_len_;
+            if(pos + label_len > len || memcmp(GetLabel(child), path + pos, label_len) != 0) { break; }
+            pos += label_len;
+            node = child;
+            if(nodes_[node].ns_id_ != (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY && (pos == len || path[pos] == '/')) {
+                best = node;
+                ns_id = nodes_[node].ns_id_;
+                match_len = pos;
+            }
+        }
+        return best;
+    }
+
+    inline void BeginWrite() {
+        __atomic_fetch_add(&header_->generation_, 1, __ATOMIC_ACQ_REL);
+    }
+    inline void EndWrite() {
+        __atomic_fetch_add(&header_->generation_, 1, __ATOMIC_RELEASE);
+    }
+};
+
+}
+
+#endif
+
+#endif //LABSTOR_SHMEM_MOUNT_TRIE_H
@@ -36,14 +36,23 @@
 typedef uint8_t labstor_qid_flags_t;
 typedef uint8_t labstor_qid_type_t;
 
+/*
+ * Every process connected to the server owns a compact IPC id.
+ * The server resolves a qid to its process through a fixed array indexed by this id.
+ * */
+#define LABSTOR_MAX_IPC_IDS 4096
+#define LABSTOR_KERNEL_IPC_ID 0
+#define LABSTOR_SERVER_IPC_ID 1
+
 typedef struct labstor_qid_t {
     uint8_t flags_;
     uint8_t type_;
     uint16_t cnt_;
     uint32_t pid_;
+    uint16_t ipc_id_;
 #ifdef __cplusplus
     labstor_qid_t() = default;
-    labstor_qid_t(uint32_t qid) : flags_(0), cnt_(qid), pid_(0) {}
+    labstor_qid_t(uint32_t qid) : flags_(0), cnt_(qid), pid_(0), ipc_id_(0) {}
     uint64_t Hash() {
         uint64_t num = 0;
         num += flags_;
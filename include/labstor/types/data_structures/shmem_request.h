@@ -29,15 +29,21 @@
 
 #include <labstor/types/basics.h>
 #include <labstor/types/data_structures/shmem_qtok.h>
+#include <labstor/constants/busy_wait.h>
 #ifdef __cplusplus
 #include <cstring>
 #endif
 
+//Set by the runtime on a request which was already past its deadline when its handler ran
+#define LABSTOR_REQUEST_MISSED_DEADLINE 0x1
+
 struct labstor_request {
     labstor_req_id_t req_id_;
     uint32_t ns_id_;
     uint32_t code_;
     uint16_t op_;
+    uint16_t flags_;
+    uint64_t deadline_ns_; //Absolute CLOCK_MONOTONIC time, 0 if the request has no deadline
 #ifdef __cplusplus
     inline labstor_request() = default;
     inline void Start(uint32_t req_id, uint32_t ns_id, uint16_t op, uint32_t code) {
@@ -45,6 +51,8 @@ struct labstor_request {
         ns_id_ = ns_id;
         op_ = op;
         code_ = code;
+        flags_ = 0;
+        deadline_ns_ = 0;
     }
 
     inline uint32_t GetNamespaceID() { return ns_id_; }
@@ -56,6 +64,23 @@ struct labstor_request {
     inline void SetCode(uint32_t code) { code_ = code; }
     inline void SetRequestID(uint32_t req_id) { req_id_ = req_id; }
     inline void SetOp(uint32_t op) { op_ = op; }
+
+    inline void SetDeadline(uint64_t deadline_ns) {
+        deadline_ns_ = deadline_ns;
+        flags_ &= ~LABSTOR_REQUEST_MISSED_DEADLINE;
+    }
+    inline void SetLatencyBudget(uint64_t budget_ns) { SetDeadline(labstor_get_monotonic_ns() + budget_ns); }
+    inline void ClearDeadline() { SetDeadline(0); }
+    inline void MarkMissedDeadline() { flags_ |= LABSTOR_REQUEST_MISSED_DEADLINE; }
+    inline bool MissedDeadline() { return flags_ & LABSTOR_REQUEST_MISSED_DEADLINE; }
+    inline bool HasDeadline() { return deadline_ns_ != 0; }
+    inline uint64_t GetDeadline() { return deadline_ns_; }
+    inline int64_t GetRemainingBudget() { return GetRemainingBudget(labstor_get_monotonic_ns()); }
+    inline int64_t GetRemainingBudget(uint64_t now_ns) {
+        if(!deadline_ns_) { return INT64_MAX; }
+        return (int64_t)(deadline_ns_ - now_ns);
+    }
+    inline bool IsPastDeadline(uint64_t now_ns) { return deadline_ns_ && now_ns > deadline_ns_; }
 #endif
 };
 
@@ -0,0 +1,174 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef LABSTOR_SHMEM_ROUTE_TABLE_H
+#define LABSTOR_SHMEM_ROUTE_TABLE_H
+
+#ifdef __cplusplus
+
+#include <cstring>
+#include <labstor/constants/macros.h>
+#include <labstor/constants/constants.h>
+#include <labstor/types/basics.h>
+#include <labstor/types/shmem_type.h>
+
+/*
+ * Compiled LabStack routes, stored in the namespace region.
+ *
+ * Mounting a LabStack compiles its DAG into an immutable labstack_routes table taken from a fixed
+ * pool in this section. Each ns_id maps to the stage entry describing it, so a module finds its next
+ * hops with one acquire load instead of a key lookup. A remount fills a new table and re-points each
+ * stage with a single release store, so a stage observes either all of its old edges or all of its
+ * new ones. The server is the only writer, and it only returns a replaced table to the pool once
+ * every worker has passed a quiescent point.
+ * */
+
+#define LABSTOR_LABSTACK_MAX_STAGES 16
+#define LABSTOR_LABSTACK_MAX_FANOUT 8
+#define LABSTOR_ROUTE_TABLE_NULL 0
+
+namespace labstor::ipc {
+
+struct labstack_stage {
+    uint32_t ns_id_;
+    uint16_t num_next_;
+    uint16_t num_prev_;
+    uint32_t qp_flags_;
+    uint32_t qp_type_;
+    uint32_t next_[LABSTOR_LABSTACK_MAX_FANOUT];
+};
+
+struct labstack_routes {
+    uint32_t mount_ns_id_;
+    uint32_t entry_;
+    uint32_t version_;
+    uint32_t num_stages_;
+    labstack_stage stages_[LABSTOR_LABSTACK_MAX_STAGES];
+
+    inline labstack_stage* GetEntry() {
+        return &stages_[entry_];
+    }
+};
+
+struct route_table_header {
+    uint32_t version_;
+    uint32_t max_entries_;
+    uint32_t max_labstacks_;
+    uint32_t num_free_;
+};
+
+class route_table : public labstor::shmem_type {
+private:
+    route_table_header *header_;
+    labstor::off_t *stages_;
+    uint32_t *free_;
+    labstack_routes *tables_;
+    void *base_region_;
+public:
+    static inline uint32_t GetSize(uint32_t max_entries, uint32_t max_labstacks) {
+        return sizeof(route_table_header) + max_entries*sizeof(labstor::off_t) +
+            max_labstacks*(sizeof(uint32_t) + sizeof(labstack_routes));
+    }
+    inline uint32_t GetSize() {
+        return GetSize(header_->max_entries_, header_->max_labstacks_);
+    }
+    inline void* GetRegion() {
+        return header_;
+    }
+
+    inline void Init(void *base_region, void *region, uint32_t max_entries, uint32_t max_labstacks) {
+        header_ = (route_table_header*)region;
+        header_->version_ = 0;
+        header_->max_entries_ = max_entries;
+        header_->max_labstacks_ = max_labstacks;
+        header_->num_free_ = max_labstacks;
+        Attach(base_region, region);
+        memset(stages_, 0, max_entries*sizeof(labstor::off_t));
+        for(uint32_t i = 0; i < max_labstacks; ++i) {
+            free_[i] = max_labstacks - i - 1;
+        }
+    }
+    inline void Attach(void *base_region, void *region) {
+        base_region_ = base_region;
+        header_ = (route_table_header*)region;
+        stages_ = (labstor::off_t*)(header_ + 1);
+        free_ = (uint32_t*)(stages_ + header_->max_entries_);
+        tables_ = (labstack_routes*)(free_ + header_->max_labstacks_);
+    }
+
+    /*Take an unused table from the pool, or nullptr if every table is in use*/
+    inline labstack_routes* AllocRoutes() {
+        if(header_->num_free_ == 0) {
+            return nullptr;
+        }
+        return &tables_[free_[--header_->num_free_]];
+    }
+    inline void FreeRoutes(labstack_routes *routes) {
+        free_[header_->num_free_++] = routes - tables_;
+    }
+
+    /*Point every stage of a fully-built table at its entry*/
+    inline void Publish(labstack_routes *routes) {
+        routes->version_ = __atomic_add_fetch(&header_->version_, 1, __ATOMIC_ACQ_REL);
+        for(uint32_t i = 0; i < routes->num_stages_; ++i) {
+            uint32_t ns_id = routes->stages_[i].ns_id_;
+            if(ns_id < header_->max_entries_) {
+                __atomic_store_n(&stages_[ns_id], LABSTOR_REGION_SUB(&routes->stages_[i], base_region_), __ATOMIC_RELEASE);
+            }
+        }
+    }
+
+    /*Detach the stages still pointing into routes, e.g., when its stack is unmounted*/
+    inline void Unpublish(labstack_routes *routes) {
+        for(uint32_t i = 0; i < routes->num_stages_; ++i) {
+            uint32_t ns_id = routes->stages_[i].ns_id_;
+            labstor::off_t off = LABSTOR_REGION_SUB(&routes->stages_[i], base_region_);
+            if(ns_id < header_->max_entries_) {
+                __atomic_compare_exchange_n(&stages_[ns_id], &off, LABSTOR_ROUTE_TABLE_NULL, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    inline const labstack_stage* Get(uint32_t ns_id) {
+        if(ns_id >= header_->max_entries_) {
+            return nullptr;
+        }
+        labstor::off_t off = __atomic_load_n(&stages_[ns_id], __ATOMIC_ACQUIRE);
+        if(off == LABSTOR_ROUTE_TABLE_NULL) {
+            return nullptr;
+        }
+        return (const labstack_stage*)LABSTOR_REGION_ADD(off, base_region_);
+    }
+
+    inline uint32_t GetVersion() {
+        return __atomic_load_n(&header_->version_, __ATOMIC_ACQUIRE);
+    }
+};
+
+}
+
+#endif
+
+#endif //LABSTOR_SHMEM_ROUTE_TABLE_H
@@ -32,10 +32,12 @@
 #include <string>
 #include <labstor/types/basics.h>
 #include <labstor/types/allocator/allocator.h>
+#include <labstor/types/hash.h>
 
 namespace labstor::ipc {
 
 struct string_header {
+    uint64_t hash_;
     uint32_t length_;
 };
 
@@ -43,44 +45,53 @@ struct string {
     string_header *header_;
     char *data_;
     uint32_t length_;
+    uint64_t hash_;
 
     inline void *GetRegion() {
         return (void*)header_;
     }
 
-    inline string() : header_(nullptr), data_(nullptr), length_(0) {}
+    inline string() : header_(nullptr), data_(nullptr), length_(0), hash_(0) {}
 
     inline string(const std::string &str, labstor::GenericAllocator *alloc) {
-        header_ = (string_header*)alloc->Alloc(str.size());
-        header_->length_ = str.size();
-        length_ = header_->length_;
-        data_ = (char*)(header_ + 1);
-        memcpy(data_, str.c_str(), str.size());
-        data_[length_] = 0;
+        Init(alloc->Alloc(GetSize(str.size())), str);
     }
 
     inline string(char *str) {
+        header_ = nullptr;
         data_ = str;
         length_ = strlen(str);
+        hash_ = hash(data_, length_);
     }
 
     inline string(char *str, int length) {
+        header_ = nullptr;
         data_ = str;
         length_ = length;
+        hash_ = hash(data_, length_);
     }
     inline string(labstor::id &id) {
+        header_ = nullptr;
         data_ = id.key_;
         length_ = strnlen(id.key_, MODULE_KEY_SIZE);
+        hash_ = hash(data_, length_);
     }
     inline string(const std::string &str) {
+        header_ = nullptr;
         data_ = reinterpret_cast<char*>(malloc(str.size()));
         strncpy(data_, str.c_str(), str.size());
         length_ = str.size();
+        hash_ = hash(data_, length_);
     }
     inline string(const string &old_str) {
         header_ = old_str.header_;
         data_ = old_str.data_;
         length_ = old_str.length_;
+        hash_ = old_str.hash_;
+    }
+
+    static inline uint32_t GetSize(uint32_t length) {
+        return sizeof(string_header) + length + 1;
     }
 
     inline void Init(void *region, std::string str) {
@@ -88,7 +99,9 @@ struct string {
         data_ = (char*)(header_ + 1);
         memcpy(data_, str.c_str(), str.size());
         header_->length_ = str.size();
+        header_->hash_ = hash(data_, str.size());
         length_ = header_->length_;
+        hash_ = header_->hash_;
         data_[header_->length_] = 0;
     }
 
@@ -96,12 +109,13 @@ struct string {
         header_ = (string_header*)region;
         data_ = (char*)(header_ + 1);
         length_ = header_->length_;
+        hash_ = header_->hash_;
     }
     std::string ToString() {
         return std::string(c_str(), size());
     }
-    inline uint32_t Hash() {
-        return hash(c_str(), size());
+    inline uint64_t Hash() const {
+        return hash_;
     }
 
     inline char& operator [](int idx) const {
@@ -131,12 +145,8 @@ struct string {
     }
     inline uint32_t size() const { return length_; }
 
-    static inline uint32_t hash(const char *key, const uint32_t length) {
-        uint32_t sum = 0;
-        for(size_t i = 0; i < length; ++i) {
-            sum += key[i] << 4*(i%4);
-        }
-        return sum;
+    static inline uint64_t hash(const char *key, const uint32_t length) {
+        return labstor_hash64(key, length);
     }
 };
 
@@ -0,0 +1,107 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef LABSTOR_UNORDERED_MAP_CONTROL_GROUP_H
+#define LABSTOR_UNORDERED_MAP_CONTROL_GROUP_H
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * One control byte per bucket. Full buckets hold a 7-bit tag of the hash, so a group of
+ * LABSTOR_CTRL_GROUP_SIZE buckets can be matched against a tag with a single vector compare.
+ * The first group is cloned past the end of the table so that groups never need to wrap.
+ * */
+
+#define LABSTOR_CTRL_GROUP_SIZE 16
+#define LABSTOR_CTRL_EMPTY 0x80
+#define LABSTOR_CTRL_DELETED 0xFE
+
+typedef uint8_t labstor_ctrl_t;
+
+static inline labstor_ctrl_t labstor_ctrl_GetTag(uint32_t hash) {
+    return (labstor_ctrl_t)(hash >> 25);
+}
+
+static inline uint32_t labstor_ctrl_GetSize(uint32_t num_buckets) {
+    return (num_buckets + LABSTOR_CTRL_GROUP_SIZE) * sizeof(labstor_ctrl_t);
+}
+
+static inline void labstor_ctrl_Init(labstor_ctrl_t *ctrl, uint32_t num_buckets) {
+    memset(ctrl, LABSTOR_CTRL_EMPTY, labstor_ctrl_GetSize(num_buckets));
+}
+
+static inline void labstor_ctrl_Set(labstor_ctrl_t *ctrl, uint32_t num_buckets, uint32_t idx, labstor_ctrl_t value) {
+    __atomic_store_n(&ctrl[idx], value, __ATOMIC_RELEASE);
+    if(idx < LABSTOR_CTRL_GROUP_SIZE) {
+        __atomic_store_n(&ctrl[num_buckets + idx], value, __ATOMIC_RELEASE);
+    }
+}
+
+#ifdef __SSE2__
+
+typedef __m128i labstor_ctrl_group_t;
+
+static inline labstor_ctrl_group_t labstor_ctrl_Load(const labstor_ctrl_t *group) {
+    return _mm_loadu_si128((const __m128i*)group);
+}
+
+static inline uint32_t labstor_ctrl_Match(labstor_ctrl_group_t group, labstor_ctrl_t tag) {
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+}
+
+#else
+
+typedef struct labstor_ctrl_group {
+    labstor_ctrl_t ctrl_[LABSTOR_CTRL_GROUP_SIZE];
+} labstor_ctrl_group_t;
+
+static inline labstor_ctrl_group_t labstor_ctrl_Load(const labstor_ctrl_t *group) {
+    labstor_ctrl_group_t snapshot;
+    for(int i = 0; i < LABSTOR_CTRL_GROUP_SIZE; ++i) {
+        snapshot.ctrl_[i] = __atomic_load_n(&group[i], __ATOMIC_RELAXED);
+    }
+    return snapshot;
+}
+
+static inline uint32_t labstor_ctrl_Match(labstor_ctrl_group_t group, labstor_ctrl_t tag) {
+    uint32_t mask = 0;
+    for(int i = 0; i < LABSTOR_CTRL_GROUP_SIZE; ++i) {
+        mask |= (uint32_t)(group.ctrl_[i] == tag) << i;
+    }
+    return mask;
+}
+
+#endif
+
+/*Matches are computed from one snapshot of the group, so tag hits and the first empty byte agree*/
+static inline uint32_t labstor_ctrl_MatchEmpty(labstor_ctrl_group_t group) {
+    return labstor_ctrl_Match(group, LABSTOR_CTRL_EMPTY);
+}
+
+#endif //LABSTOR_UNORDERED_MAP_CONTROL_GROUP_H
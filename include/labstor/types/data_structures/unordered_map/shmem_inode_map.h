@@ -56,13 +56,8 @@ struct inode_map_bucket {
     inline bool IsNull() {
         return off_ == null0_null;
     }
-    static inline uint32_t KeyHash(const std::pair<uint64_t,labstor::ipc::string> key, void *region) {
-        uint64_t str_hash = labstor::ipc::string::hash(key.second.c_str(), key.second.size());
-        for(int i = 0; i < 5; ++i) {
-            str_hash += str_hash*key.first;
-            str_hash += str_hash*(key.first+1);
-        }
-        return str_hash;
+    static inline uint64_t KeyHash(const std::pair<uint64_t,labstor::ipc::string> key, void *region) {
+        return labstor_hash64_int(key.first, key.second.Hash());
     }
     static inline bool KeyCompare(std::pair<uint64_t,labstor::ipc::string> key1, std::pair<uint64_t,labstor::ipc::string> key2) {
         return key1 == key2;
@@ -31,6 +31,7 @@
 #include "shmem_unordered_map.h"
 #include "labstor/userspace/util/errors.h"
 #include "labstor/types/shmem_type.h"
+#include "labstor/types/hash.h"
 
 namespace labstor::ipc::mpmc {
 
@@ -48,8 +49,8 @@ struct int_map_bucket {
     inline S GetKey(void *region) {
         return key_;
     }
-    static inline uint32_t KeyHash(const S key, const void *region) {
-        return key;
+    static inline uint64_t KeyHash(const S key, const void *region) {
+        return labstor_hash64_int((uint64_t)key, 0);
     }
     static inline bool KeyCompare(S key1, S key2) {
         return key1==key2;
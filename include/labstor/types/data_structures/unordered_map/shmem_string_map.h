@@ -55,8 +55,8 @@ struct string_map_bucket {
     inline bool IsNull() {
         return off_ == null0_null;
     }
-    static inline uint32_t KeyHash(const labstor::ipc::string key, void *region) {
-        return labstor::ipc::string::hash(key.c_str(), key.size());
+    static inline uint64_t KeyHash(const labstor::ipc::string key, void *region) {
+        return key.Hash();
     }
     static inline bool KeyCompare(labstor::ipc::string key1, labstor::ipc::string key2) {
         return key1 == key2;
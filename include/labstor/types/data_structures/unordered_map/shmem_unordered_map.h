@@ -28,34 +28,95 @@
 #define LABSTOR_UNORDERED_MAP_H
 
 #include "labstor/constants/macros.h"
-#include "labstor/types/data_structures/bit2map.h"
+#include "labstor/constants/busy_wait.h"
 #include "labstor/types/shmem_type.h"
 #include "labstor/userspace/util/errors.h"
+#include "control_group.h"
+#include <cstring>
 
-struct unordered_map_header {
+/*
+ * A concurrent hash map stored entirely in a shared memory region.
+ *
+ * The region holds a header followed by two equally-sized banks. Only one bank is active at a time; the
+ * other is used as the destination of an incremental rehash when the active table fills, exceeds its probe
+ * bound, or accumulates too many tombstones. Writers serialize on a lock in the header and migrate a few
+ * buckets of the draining table on every Set/Remove, so no single operation pays for the entire rehash.
+ *
+ * Each table uses Robin Hood linear probing. A bucket is a single 64-bit word:
+ *      [entry index + 1 : 32][hash fragment : 24][probe distance : 8]
+ * pointing into the bank's entry pool. Entries are written before the word that publishes them, and
+ * insertions shift runs toward higher indices starting from the end of the run, so a reader scanning forward
+ * never skips over an entry. Removal leaves a tombstone which is only reclaimed by the next rehash.
+ *
+ * Each bucket also has a control byte (control_group.h). Find matches a group of 16 control bytes against the
+ * key's tag with one vector compare and only dereferences entries on tag hits, stopping at the first empty
+ * byte. The table's shift counter is a seqlock: it is odd while an insertion shifts a run, in which case the
+ * lookup uses a scalar forward scan instead, and a miss is retried if the counter changed during the lookup.
+ *
+ * Readers never take the writer lock. They register in one of two reader slots before using a layout;
+ * a writer that changes the layout (begins or ends a rehash) waits for readers of the previous layout
+ * to leave before touching memory they may still be reading. A lookup only retries if it races with such a
+ * layout change, which happens twice per rehash.
+ *
+ * Readers may be clients, which can die inside a lookup. Each slot therefore records the layout version its
+ * count belongs to, and the writer only waits LABSTOR_UNORDERED_MAP_READER_TIMEOUT_MS for it to drain. The
+ * next reader of a newer layout takes the slot over, discarding the count of readers that never left, and a
+ * late EndRead on a slot that was taken over does nothing.
+ * */
+
+#define LABSTOR_UNORDERED_MAP_MIN_BUCKETS 16
+#define LABSTOR_UNORDERED_MAP_DEFAULT_PROBE 32
+#define LABSTOR_UNORDERED_MAP_MAX_PROBE 255
+#define LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT 75
+#define LABSTOR_UNORDERED_MAP_MIGRATE_BATCH 8
+#define LABSTOR_UNORDERED_MAP_TOMBSTONE 0xFFFFFFFF
+
+#define LABSTOR_UNORDERED_MAP_ACTIVE 0x1
+#define LABSTOR_UNORDERED_MAP_DRAINING 0x2
+#define LABSTOR_UNORDERED_MAP_VERSION_SHIFT 2
+#define LABSTOR_UNORDERED_MAP_READER_TIMEOUT_MS 1000
+
+struct unordered_map_table {
     uint32_t num_buckets_;
-    uint32_t max_collisions_;
-    labstor_bit2map_t bitmap_[];
+    uint32_t num_entries_;
+    uint32_t num_live_;
+    uint32_t max_dist_;
+    uint32_t num_shifts_;
 };
 
+struct unordered_map_header {
+    uint32_t lock_;
+    uint32_t state_;
+    uint64_t readers_[2]; //[layout version : 32][reader count : 32]
+    uint32_t max_collisions_;
+    uint32_t bank_buckets_;
+    uint32_t rehash_idx_;
+    struct unordered_map_table tables_[2];
+} __attribute__((aligned(64)));
+
 template<typename S, typename T, typename BUCKET_T>
 struct unordered_map : public labstor::shmem_type {
     struct unordered_map_header *header_;
     void *base_region_;
-    uint32_t num_buckets_;
-    BUCKET_T *buckets_;
-    labstor_bit2map_t *bitmap_;
 
-    static inline uint32_t GetHeaderSize(uint32_t num_buckets) {
-        return sizeof(struct unordered_map_header) + labstor_bit2map_GetSize(num_buckets);
+    static inline uint32_t RoundUpPow2(uint32_t n) {
+        uint32_t pow2 = LABSTOR_UNORDERED_MAP_MIN_BUCKETS;
+        while(pow2 < n) { pow2 <<= 1; }
+        return pow2;
+    }
+
+    static inline uint32_t GetBankSize(uint32_t bank_buckets) {
+        return bank_buckets * (sizeof(uint64_t) + sizeof(BUCKET_T)) + labstor_ctrl_GetSize(bank_buckets);
     }
 
     static inline uint32_t GetSize(uint32_t num_buckets) {
-        return GetHeaderSize(num_buckets) + sizeof(BUCKET_T)*num_buckets;
+        //Enough space to hold num_buckets entries within the maximum load, in either bank
+        uint32_t bank_buckets = RoundUpPow2(num_buckets * 100 / LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT);
+        return sizeof(struct unordered_map_header) + 2*GetBankSize(bank_buckets);
     }
 
     inline uint32_t GetSize() {
-        return GetSize(num_buckets_);
+        return sizeof(struct unordered_map_header) + 2*GetBankSize(header_->bank_buckets_);
     }
 
     inline void* GetRegion() {
@@ -67,31 +128,44 @@ struct unordered_map : public labstor::shmem_type {
     }
 
     inline uint32_t GetNumBuckets() {
-        return num_buckets_;
+        uint32_t state = __atomic_load_n(&header_->state_, __ATOMIC_ACQUIRE);
+        return __atomic_load_n(&header_->tables_[state & LABSTOR_UNORDERED_MAP_ACTIVE].num_buckets_, __ATOMIC_ACQUIRE);
+    }
+
+    inline uint32_t GetMaxBuckets() {
+        return header_->bank_buckets_;
     }
 
     inline bool Init(
             void *base_region, void *region, uint32_t region_size, uint32_t num_buckets, uint32_t max_collisions=0) {
+        uint32_t bank_buckets;
         base_region_ = base_region;
         header_ = (struct unordered_map_header*)region;
-        if(region_size < GetSize(num_buckets)) {
+
+        //Size the banks to the largest power of two which fits in the region
+        if(region_size < sizeof(struct unordered_map_header) + 2*GetBankSize(LABSTOR_UNORDERED_MAP_MIN_BUCKETS)) {
             throw labstor::INVALID_UNORDERED_MAP_SIZE.format(region_size, num_buckets);
         }
-        if(num_buckets == 0) {
-            num_buckets = region_size - sizeof(struct unordered_map_header);
-            num_buckets *= LABSTOR_BIT2MAP_ENTRIES_PER_BLOCK;
-            num_buckets /= (sizeof(BUCKET_T)*LABSTOR_BIT2MAP_ENTRIES_PER_BLOCK + sizeof(labstor_bit2map_t));
+        bank_buckets = LABSTOR_UNORDERED_MAP_MIN_BUCKETS;
+        while(sizeof(struct unordered_map_header) + 2*GetBankSize(2*bank_buckets) <= region_size) {
+            bank_buckets <<= 1;
         }
-        if(num_buckets == 0) {
+
+        //The table starts at num_buckets and grows on demand up to the size of a bank
+        num_buckets = RoundUpPow2(num_buckets);
+        if(num_buckets > bank_buckets) {
             throw labstor::INVALID_UNORDERED_MAP_SIZE.format(region_size, num_buckets);
         }
+        if(max_collisions == 0 || max_collisions > LABSTOR_UNORDERED_MAP_MAX_PROBE) {
+            max_collisions = (max_collisions == 0) ? LABSTOR_UNORDERED_MAP_DEFAULT_PROBE : LABSTOR_UNORDERED_MAP_MAX_PROBE;
+        }
 
-        header_->num_buckets_ = num_buckets;
+        memset(header_, 0, sizeof(struct unordered_map_header));
         header_->max_collisions_ = max_collisions;
-        num_buckets_ = header_->num_buckets_;
-        bitmap_ = header_->bitmap_;
-        labstor_bit2map_Init(bitmap_, num_buckets_);
-        buckets_ = (BUCKET_T*)(labstor_bit2map_GetNextSection(bitmap_, num_buckets_));
+        header_->bank_buckets_ = bank_buckets;
+        header_->tables_[0].num_buckets_ = num_buckets;
+        memset(GetBuckets(0), 0, num_buckets*sizeof(uint64_t));
+        labstor_ctrl_Init(GetCtrl(0), num_buckets);
         return true;
     }
 
@@ -99,72 +173,413 @@ struct unordered_map : public labstor::shmem_type {
             void *base_region, void *region) {
         base_region_ = base_region;
         header_ = (struct unordered_map_header*)region;
-        buckets_ = (BUCKET_T*)(header_ + 1);
-        num_buckets_ = header_->num_buckets_;
-        bitmap_ = header_->bitmap_;
-        buckets_ = (BUCKET_T*)(labstor_bit2map_GetNextSection(bitmap_, num_buckets_));
     }
 
     inline int Set(BUCKET_T &bucket) {
-        uint32_t b;
-        int i, iters = header_->max_collisions_ + 1;
-        b = BUCKET_T::KeyHash(bucket.GetKey(base_region_), base_region_) % num_buckets_;
-        for(i = 0; i < iters; ++i) {
-            if(labstor_bit2map_BeginModify(bitmap_, b)) {
-                buckets_[b] = bucket;
-                labstor_bit2map_CommitModify(bitmap_, b);
+        uint32_t hash = Hash(bucket.GetKey(base_region_));
+        bool ret = false;
+        Lock();
+        MigrateStep();
+        for(int attempt = 0; attempt < 2; ++attempt) {
+            uint32_t state = header_->state_;
+            uint32_t bound = attempt ? LABSTOR_UNORDERED_MAP_MAX_PROBE : header_->max_collisions_;
+            if(Insert(state & LABSTOR_UNORDERED_MAP_ACTIVE, bucket, hash, bound)) {
+                //The key may still be present in the table being drained
+                if(state & LABSTOR_UNORDERED_MAP_DRAINING) {
+                    Erase(!(state & LABSTOR_UNORDERED_MAP_ACTIVE), bucket.GetKey(base_region_), hash);
+                }
+                ret = true;
+                break;
+            }
+            if(!Grow()) {
+                break;
+            }
+        }
+        Unlock();
+        return ret;
+    }
+
+    inline int Find(S key, T &value) {
+        uint32_t hash = Hash(key), state;
+        bool found = false;
+        state = BeginRead();
+        if(state & LABSTOR_UNORDERED_MAP_DRAINING) {
+            found = Lookup(!(state & LABSTOR_UNORDERED_MAP_ACTIVE), key, hash, value);
+        }
+        if(!found) {
+            found = Lookup(state & LABSTOR_UNORDERED_MAP_ACTIVE, key, hash, value);
+        }
+        EndRead(state);
+        return found;
+    }
+
+    inline int Remove(S key) {
+        uint32_t hash = Hash(key), state;
+        bool found = false;
+        Lock();
+        MigrateStep();
+        state = header_->state_;
+        if(state & LABSTOR_UNORDERED_MAP_DRAINING) {
+            found = Erase(!(state & LABSTOR_UNORDERED_MAP_ACTIVE), key, hash);
+        }
+        found |= Erase(state & LABSTOR_UNORDERED_MAP_ACTIVE, key, hash);
+        Unlock();
+        return found;
+    }
+
+    inline T operator [](S key) {
+        T value;
+        if(Find(key, value)) {
+            return value;
+        }
+        throw labstor::INVALID_UNORDERED_MAP_KEY.format();
+    }
+
+    /*BUCKET WORDS*/
+
+    static inline uint32_t Hash(S key) {
+        //Buckets provide a 64-bit hash (cached for shared strings); fold it to the bucket index and tag
+        uint64_t h = BUCKET_T::KeyHash(key, nullptr);
+        return (uint32_t)(h ^ (h >> 32));
+    }
+    static inline uint64_t MakeWord(uint32_t entry, uint32_t hash, uint32_t dist) {
+        return ((uint64_t)(entry + 1) << 32) | ((hash >> 8) << 8) | dist;
+    }
+    static inline uint32_t GetEntry(uint64_t word) { return (uint32_t)(word >> 32) - 1; }
+    static inline bool IsTombstone(uint64_t word) { return (uint32_t)(word >> 32) == LABSTOR_UNORDERED_MAP_TOMBSTONE; }
+    static inline uint32_t GetFragment(uint64_t word) { return (uint32_t)word >> 8; }
+    static inline uint32_t GetDist(uint64_t word) { return (uint32_t)word & 0xFF; }
+
+    inline uint64_t* GetBuckets(int bank) {
+        return (uint64_t*)((char*)(header_ + 1) + bank*GetBankSize(header_->bank_buckets_));
+    }
+    inline labstor_ctrl_t* GetCtrl(int bank) {
+        return (labstor_ctrl_t*)(GetBuckets(bank) + header_->bank_buckets_);
+    }
+    inline BUCKET_T* GetEntries(int bank) {
+        return (BUCKET_T*)(GetCtrl(bank) + labstor_ctrl_GetSize(header_->bank_buckets_));
+    }
+
+    /*READERS*/
+
+    static inline uint32_t GetVersion(uint32_t state) { return state >> LABSTOR_UNORDERED_MAP_VERSION_SHIFT; }
+    static inline uint64_t MakeReaders(uint32_t version, uint32_t count) { return ((uint64_t)version << 32) | count; }
+    static inline uint32_t GetReadersVersion(uint64_t readers) { return (uint32_t)(readers >> 32); }
+    static inline uint32_t GetReadersCount(uint64_t readers) { return (uint32_t)readers; }
+    /*Versions wrap at 2^30*/
+    static inline bool IsOlderVersion(uint32_t version, uint32_t than) {
+        return (int32_t)((version - than) << LABSTOR_UNORDERED_MAP_VERSION_SHIFT) < 0;
+    }
+
+    inline uint32_t BeginRead() {
+        uint32_t state, version;
+        uint64_t readers, new_readers;
+        do {
+            state = __atomic_load_n(&header_->state_, __ATOMIC_SEQ_CST);
+            version = GetVersion(state);
+            uint64_t &slot = header_->readers_[version & 1];
+            readers = __atomic_load_n(&slot, __ATOMIC_SEQ_CST);
+            if(GetReadersVersion(readers) == version) {
+                new_readers = readers + 1;
+            } else if(IsOlderVersion(GetReadersVersion(readers), version)) {
+                //Readers still counted in the slot either abort on their state check or were given up on
+                new_readers = MakeReaders(version, 1);
+            } else {
+                continue;
+            }
+            if(!__atomic_compare_exchange_n(&slot, &readers, new_readers, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            if(__atomic_load_n(&header_->state_, __ATOMIC_SEQ_CST) == state) {
+                return state;
+            }
+            EndRead(state);
+        } while(true);
+    }
+
+    inline void EndRead(uint32_t state) {
+        uint32_t version = GetVersion(state);
+        uint64_t &slot = header_->readers_[version & 1];
+        uint64_t readers = __atomic_load_n(&slot, __ATOMIC_RELAXED);
+        do {
+            if(GetReadersVersion(readers) != version || GetReadersCount(readers) == 0) {
+                return;
+            }
+        } while(!__atomic_compare_exchange_n(&slot, &readers, readers - 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    inline bool Lookup(int bank, S key, uint32_t hash, T &value) {
+        struct unordered_map_table &table = header_->tables_[bank];
+        uint32_t num_shifts;
+        while(true) {
+            //A writer is shifting a run; only a forward scan of the bucket words is safe until it finishes
+            num_shifts = __atomic_load_n(&table.num_shifts_, __ATOMIC_ACQUIRE);
+            if(num_shifts & 1) {
+                return LookupScalar(bank, key, hash, value);
+            }
+            if(LookupGroups(bank, key, hash, value)) {
                 return true;
             }
-            b = (b+1)%num_buckets_;
+            //A miss only holds if no shift started or finished while the control bytes were being read
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(__atomic_load_n(&table.num_shifts_, __ATOMIC_RELAXED) == num_shifts) {
+                return false;
+            }
+        }
+    }
+
+    inline bool LookupGroups(int bank, S key, uint32_t hash, T &value) {
+        struct unordered_map_table &table = header_->tables_[bank];
+        uint64_t *buckets = GetBuckets(bank);
+        labstor_ctrl_t *ctrl = GetCtrl(bank);
+        labstor_ctrl_t tag = labstor_ctrl_GetTag(hash);
+        uint32_t num_buckets = __atomic_load_n(&table.num_buckets_, __ATOMIC_ACQUIRE);
+        uint32_t max_dist = __atomic_load_n(&table.max_dist_, __ATOMIC_ACQUIRE);
+        uint32_t mask = num_buckets - 1, b = hash & mask;
+
+        for(uint32_t dist = 0; dist <= max_dist && dist <= mask; dist += LABSTOR_CTRL_GROUP_SIZE) {
+            labstor_ctrl_group_t group = labstor_ctrl_Load(ctrl + b);
+            uint32_t match = labstor_ctrl_Match(group, tag);
+            uint32_t empty = labstor_ctrl_MatchEmpty(group);
+            //Only buckets before the first empty one can belong to this probe sequence
+            if(empty) {
+                match &= (empty & (~empty + 1)) - 1;
+            }
+            while(match) {
+                uint32_t i = (b + __builtin_ctz(match)) & mask;
+                uint64_t word = __atomic_load_n(&buckets[i], __ATOMIC_ACQUIRE);
+                if(word != 0 && !IsTombstone(word) && GetFragment(word) == (hash >> 8)) {
+                    BUCKET_T &entry = GetEntries(bank)[GetEntry(word)];
+                    if(BUCKET_T::KeyCompare(entry.GetKey(base_region_), key)) {
+                        value = entry.GetValue(base_region_);
+                        return true;
+                    }
+                }
+                match &= match - 1;
+            }
+            if(empty) {
+                break;
+            }
+            b = (b + LABSTOR_CTRL_GROUP_SIZE) & mask;
         }
         return false;
     }
 
-    inline int Find(S key, T &value) {
-        int i, iters = header_->max_collisions_ + 1;
-        uint32_t b = BUCKET_T::KeyHash(key, base_region_) % num_buckets_;
-        for(i = 0; i < iters; ++i) {
-            if(labstor_bit2map_IsSet(bitmap_, b, LABSTOR_BIT2MAP_VALID)) {
-                if(BUCKET_T::KeyCompare(buckets_[b].GetKey(base_region_), key)) {
-                    value = buckets_[b].GetValue(base_region_);
+    inline bool LookupScalar(int bank, S key, uint32_t hash, T &value) {
+        uint64_t *buckets = GetBuckets(bank);
+        BUCKET_T *entries = GetEntries(bank);
+        uint32_t mask = __atomic_load_n(&header_->tables_[bank].num_buckets_, __ATOMIC_ACQUIRE) - 1;
+        uint32_t b = hash & mask;
+        for(uint32_t dist = 0; dist <= mask && dist <= LABSTOR_UNORDERED_MAP_MAX_PROBE; ++dist) {
+            uint64_t word = __atomic_load_n(&buckets[b], __ATOMIC_ACQUIRE);
+            if(word == 0 || GetDist(word) < dist) {
+                return false;
+            }
+            if(!IsTombstone(word) && GetFragment(word) == (hash >> 8)) {
+                BUCKET_T &entry = entries[GetEntry(word)];
+                if(BUCKET_T::KeyCompare(entry.GetKey(base_region_), key)) {
+                    value = entry.GetValue(base_region_);
                     return true;
                 }
             }
-            b = (b+1)%num_buckets_;
+            b = (b + 1) & mask;
         }
         return false;
     }
 
-    inline int Remove(S key) {
-        uint32_t b = BUCKET_T::KeyHash(key, base_region_) % num_buckets_;
-        int i, iters = header_->max_collisions_ + 1;
-        int num_failed = 0;
-        while(num_failed != iters) {
-            for(i = 0; i < iters; ++i) {
-                if(labstor_bit2map_BeginRemove(bitmap_, b)) {
-                    if(BUCKET_T::KeyCompare(buckets_[b].GetKey(base_region_), key)) {
-                        labstor_bit2map_CommitRemove(bitmap_, b);
-                        return true;
-                    } else {
-                        labstor_bit2map_IgnoreRemove(bitmap_, b);
-                        ++num_failed;
-                        break;
-                    }
-                }
-                b = (b+1)%num_buckets_;
+    /*WRITERS*/
+
+    inline void Lock() {
+        uint32_t unlocked = 0;
+        while(!__atomic_compare_exchange_n(&header_->lock_, &unlocked, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            unlocked = 0;
+        }
+    }
+
+    inline void Unlock() {
+        __atomic_store_n(&header_->lock_, 0, __ATOMIC_RELEASE);
+    }
+
+    inline void Publish(uint32_t state) {
+        //Wait for readers of the previous layout to leave before its memory is reused
+        uint32_t old_state = header_->state_, old_version = GetVersion(old_state);
+        uint64_t readers, start_ns = 0;
+        state = (state & ~(~0u << LABSTOR_UNORDERED_MAP_VERSION_SHIFT)) |
+                ((old_version + 1) << LABSTOR_UNORDERED_MAP_VERSION_SHIFT);
+        __atomic_store_n(&header_->state_, state, __ATOMIC_SEQ_CST);
+        while(true) {
+            readers = __atomic_load_n(&header_->readers_[old_version & 1], __ATOMIC_SEQ_CST);
+            if(GetReadersVersion(readers) != old_version || GetReadersCount(readers) == 0) {
+                return;
+            }
+            //A reader this late has died inside a lookup, so it is not waited for
+            uint64_t now_ns = labstor_get_monotonic_ns();
+            if(start_ns == 0) {
+                start_ns = now_ns;
+            } else if(LABSTOR_NS_TO_MS((now_ns - start_ns)) > LABSTOR_UNORDERED_MAP_READER_TIMEOUT_MS) {
+                return;
+            }
+            LABSTOR_YIELD();
+        }
+    }
+
+    inline bool Insert(int bank, BUCKET_T &bucket, uint32_t hash, uint32_t bound) {
+        struct unordered_map_table &table = header_->tables_[bank];
+        uint64_t *buckets = GetBuckets(bank);
+        BUCKET_T *entries = GetEntries(bank);
+        labstor_ctrl_t *ctrl = GetCtrl(bank);
+        S key = bucket.GetKey(base_region_);
+        uint32_t mask = table.num_buckets_ - 1, b, end, dist;
+        uint64_t word;
+
+        if((table.num_entries_ + 1)*100 > table.num_buckets_*LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT) {
+            return false;
+        }
+
+        //Replace the entry of an existing key by publishing a new entry in its bucket
+        b = hash & mask;
+        for(dist = 0; dist <= mask; ++dist, b = (b + 1) & mask) {
+            word = buckets[b];
+            if(word == 0 || GetDist(word) < dist) { break; }
+            if(!IsTombstone(word) && GetFragment(word) == (hash >> 8) &&
+               BUCKET_T::KeyCompare(entries[GetEntry(word)].GetKey(base_region_), key)) {
+                entries[table.num_entries_] = bucket;
+                __atomic_store_n(&buckets[b], MakeWord(table.num_entries_, hash, dist), __ATOMIC_RELEASE);
+                ++table.num_entries_;
+                return true;
+            }
+        }
+        if(dist > bound) {
+            return false;
+        }
+
+        //Find the end of the run which gets displaced, verifying it stays within the probe bound
+        for(end = b; buckets[end] != 0; end = (end + 1) & mask) {
+            if(GetDist(buckets[end]) + 1 > bound) {
+                return false;
+            }
+        }
+
+        //Shift the run from its end so that forward scans never miss an entry. The shift counter is odd
+        //while the run is moving, so group lookups know to fall back to a forward scan.
+        bool shifting = (end != b);
+        if(shifting) {
+            __atomic_fetch_add(&table.num_shifts_, 1, __ATOMIC_SEQ_CST);
+        }
+        for(; end != b; end = (end - 1) & mask) {
+            word = buckets[(end - 1) & mask] + 1;
+            __atomic_store_n(&buckets[end], word, __ATOMIC_RELEASE);
+            labstor_ctrl_Set(ctrl, table.num_buckets_, end, ctrl[(end - 1) & mask]);
+            if(GetDist(word) > table.max_dist_) {
+                __atomic_store_n(&table.max_dist_, GetDist(word), __ATOMIC_RELEASE);
+            }
+        }
+        entries[table.num_entries_] = bucket;
+        __atomic_store_n(&buckets[b], MakeWord(table.num_entries_, hash, dist), __ATOMIC_RELEASE);
+        labstor_ctrl_Set(ctrl, table.num_buckets_, b, labstor_ctrl_GetTag(hash));
+        if(dist > table.max_dist_) {
+            __atomic_store_n(&table.max_dist_, dist, __ATOMIC_RELEASE);
+        }
+        if(shifting) {
+            __atomic_fetch_add(&table.num_shifts_, 1, __ATOMIC_SEQ_CST);
+        }
+        ++table.num_entries_;
+        ++table.num_live_;
+        return true;
+    }
+
+    inline bool Erase(int bank, S key, uint32_t hash) {
+        struct unordered_map_table &table = header_->tables_[bank];
+        uint64_t *buckets = GetBuckets(bank);
+        BUCKET_T *entries = GetEntries(bank);
+        uint32_t mask = table.num_buckets_ - 1, b = hash & mask;
+        for(uint32_t dist = 0; dist <= mask; ++dist, b = (b + 1) & mask) {
+            uint64_t word = buckets[b];
+            if(word == 0 || GetDist(word) < dist) { return false; }
+            if(!IsTombstone(word) && GetFragment(word) == (hash >> 8) &&
+               BUCKET_T::KeyCompare(entries[GetEntry(word)].GetKey(base_region_), key)) {
+                __atomic_store_n(&buckets[b], ((uint64_t)LABSTOR_UNORDERED_MAP_TOMBSTONE << 32) | (uint32_t)word, __ATOMIC_RELEASE);
+                labstor_ctrl_Set(GetCtrl(bank), table.num_buckets_, b, LABSTOR_CTRL_DELETED);
+                --table.num_live_;
+                return true;
             }
         }
         return false;
     }
 
-    inline T operator [](S key) {
-        T value;
-        if(Find(key, value)) {
-            return value;
+    inline bool Migrate(uint32_t count) {
+        uint32_t state = header_->state_;
+        int src = !(state & LABSTOR_UNORDERED_MAP_ACTIVE), dst = state & LABSTOR_UNORDERED_MAP_ACTIVE;
+        uint64_t *buckets = GetBuckets(src);
+        BUCKET_T *entries = GetEntries(src);
+        for(uint32_t i = 0; i < count && header_->rehash_idx_ < header_->tables_[src].num_buckets_; ++i) {
+            uint64_t word = buckets[header_->rehash_idx_];
+            if(word != 0 && !IsTombstone(word)) {
+                BUCKET_T &entry = entries[GetEntry(word)];
+                if(!Insert(dst, entry, Hash(entry.GetKey(base_region_)), LABSTOR_UNORDERED_MAP_MAX_PROBE)) {
+                    return false;
+                }
+                __atomic_store_n(&buckets[header_->rehash_idx_], ((uint64_t)LABSTOR_UNORDERED_MAP_TOMBSTONE << 32) | (uint32_t)word, __ATOMIC_RELEASE);
+                labstor_ctrl_Set(GetCtrl(src), header_->tables_[src].num_buckets_, header_->rehash_idx_, LABSTOR_CTRL_DELETED);
+                --header_->tables_[src].num_live_;
+            }
+            ++header_->rehash_idx_;
         }
-        throw labstor::INVALID_UNORDERED_MAP_KEY.format();
+        if(header_->rehash_idx_ == header_->tables_[src].num_buckets_) {
+            Publish(state & ~LABSTOR_UNORDERED_MAP_DRAINING);
+        }
+        return true;
+    }
+
+    inline void MigrateStep() {
+        if(header_->state_ & LABSTOR_UNORDERED_MAP_DRAINING) {
+            Migrate(LABSTOR_UNORDERED_MAP_MIGRATE_BATCH);
+        }
+    }
+
+    inline bool Grow() {
+        uint32_t state = header_->state_, num_buckets, num_live, num_pending;
+        bool drain_now = false;
+        int src, dst;
+
+        //Finish any rehash still in progress
+        if(state & LABSTOR_UNORDERED_MAP_DRAINING) {
+            if(!Migrate(LABSTOR_UNORDERED_MAP_TOMBSTONE)) {
+                return false;
+            }
+            state = header_->state_;
+        }
+        src = state & LABSTOR_UNORDERED_MAP_ACTIVE;
+        dst = !src;
+
+        //Size the new table so the live entries fill at most half of its maximum load. Each Set made
+        //before the drain completes migrates a batch of buckets and may add one entry, so leave room for those.
+        num_live = header_->tables_[src].num_live_ + 1;
+        num_pending = header_->tables_[src].num_buckets_ / LABSTOR_UNORDERED_MAP_MIGRATE_BATCH + 1;
+        num_buckets = RoundUpPow2((2 * num_live + num_pending) * 100 / LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT);
+        if(num_buckets > header_->bank_buckets_) {
+            num_buckets = header_->bank_buckets_;
+            if(num_live*100 > num_buckets*LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT) {
+                return false;
+            }
+            //The bank can't absorb the inserts made during an incremental drain, so migrate everything now
+            drain_now = (num_live + num_pending)*100 > num_buckets*LABSTOR_UNORDERED_MAP_MAX_LOAD_PCT;
+        }
+
+        //Begin draining the active table into the other bank
+        memset(GetBuckets(dst), 0, num_buckets*sizeof(uint64_t));
+        labstor_ctrl_Init(GetCtrl(dst), num_buckets);
+        memset(&header_->tables_[dst], 0, sizeof(struct unordered_map_table));
+        header_->tables_[dst].num_buckets_ = num_buckets;
+        header_->rehash_idx_ = 0;
+        Publish(dst | LABSTOR_UNORDERED_MAP_DRAINING);
+        if(drain_now) {
+            return Migrate(LABSTOR_UNORDERED_MAP_TOMBSTONE);
+        }
+        MigrateStep();
+        return true;
     }
 };
 
 
-#endif //LABSTOR_UNORDERED_MAP_H
\ No newline at end of file
+#endif //LABSTOR_UNORDERED_MAP_H
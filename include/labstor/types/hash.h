@@ -0,0 +1,127 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef LABSTOR_HASH_H
+#define LABSTOR_HASH_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/string.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+/*
+ * A 64-bit hash in the style of wyhash. Keys up to 16 bytes are read with at most four overlapping
+ * loads; longer keys are consumed 48 bytes at a time over three independent multiply-fold lanes, so
+ * long paths hash at close to memory bandwidth.
+ * */
+
+#define LABSTOR_HASH_SEED 0
+#define LABSTOR_HASH_S0 0xa0761d6478bd642fULL
+#define LABSTOR_HASH_S1 0xe7037ed1a0b428dbULL
+#define LABSTOR_HASH_S2 0x8ebc6af09c88c6e3ULL
+#define LABSTOR_HASH_S3 0x589965cc75374cc3ULL
+
+static inline void labstor_hash_mum(uint64_t *a, uint64_t *b) {
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t labstor_hash_mix(uint64_t a, uint64_t b) {
+    labstor_hash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t labstor_hash_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t labstor_hash_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t labstor_hash_r3(const uint8_t *p, size_t len) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[len >> 1]) << 8) | p[len - 1];
+}
+
+static inline uint64_t labstor_hash64_seed(const void *key, size_t len, uint64_t seed) {
+    const uint8_t *p = (const uint8_t*)key;
+    uint64_t a, b;
+    seed ^= labstor_hash_mix(seed ^ LABSTOR_HASH_S0, LABSTOR_HASH_S1);
+    if(len <= 16) {
+        if(len >= 4) {
+            a = (labstor_hash_r4(p) << 32) | labstor_hash_r4(p + ((len >> 3) << 2));
+            b = (labstor_hash_r4(p + len - 4) << 32) | labstor_hash_r4(p + len - 4 - ((len >> 3) << 2));
+        } else if(len > 0) {
+            a = labstor_hash_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if(i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = labstor_hash_mix(labstor_hash_r8(p) ^ LABSTOR_HASH_S1, labstor_hash_r8(p + 8) ^ seed);
+                see1 = labstor_hash_mix(labstor_hash_r8(p + 16) ^ LABSTOR_HASH_S2, labstor_hash_r8(p + 24) ^ see1);
+                see2 = labstor_hash_mix(labstor_hash_r8(p + 32) ^ LABSTOR_HASH_S3, labstor_hash_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while(i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while(i > 16) {
+            seed = labstor_hash_mix(labstor_hash_r8(p) ^ LABSTOR_HASH_S1, labstor_hash_r8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = labstor_hash_r8(p + i - 16);
+        b = labstor_hash_r8(p + i - 8);
+    }
+    a ^= LABSTOR_HASH_S1;
+    b ^= seed;
+    labstor_hash_mum(&a, &b);
+    return labstor_hash_mix(a ^ LABSTOR_HASH_S0 ^ len, b ^ LABSTOR_HASH_S1);
+}
+
+static inline uint64_t labstor_hash64(const void *key, size_t len) {
+    return labstor_hash64_seed(key, len, LABSTOR_HASH_SEED);
+}
+
+static inline uint64_t labstor_hash64_int(uint64_t key, uint64_t seed) {
+    return labstor_hash_mix(key ^ LABSTOR_HASH_S0, seed ^ LABSTOR_HASH_S1);
+}
+
+#endif //LABSTOR_HASH_H
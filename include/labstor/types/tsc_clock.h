@@ -0,0 +1,166 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_TSC_CLOCK_H
+#define LABSTOR_TSC_CLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define LABSTOR_HAS_TSC
+#endif
+
+/*The clock occupies its own page at the head of the namespace region, which clients map read-only*/
+#define LABSTOR_TSC_CLOCK_PAGE_SIZE 4096
+#define LABSTOR_TSC_CLOCK_SHIFT 32
+#define LABSTOR_TSC_CALIBRATE_NS 10000000ull
+
+/*
+ * A TSC-to-ns conversion published by the server:
+ *   ns = ns_base_ + ((tsc - tsc_base_) * mult_) >> LABSTOR_TSC_CLOCK_SHIFT
+ * invariant_ is 0 when the CPU has no invariant TSC, in which case readers fall back to clock_gettime.
+ * seq_ is odd while the server rewrites the conversion.
+ * */
+struct labstor_tsc_clock {
+    uint32_t seq_;
+    uint32_t invariant_;
+    uint64_t mult_;
+    uint64_t tsc_base_;
+    uint64_t ns_base_;
+};
+
+#ifdef __cplusplus
+inline const struct labstor_tsc_clock *labstor_clock_page = nullptr;
+#else
+static const struct labstor_tsc_clock *labstor_clock_page = NULL;
+#endif
+
+static inline void labstor_set_clock_page(const struct labstor_tsc_clock *clock) {
+    __atomic_store_n(&labstor_clock_page, clock, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t labstor_clock_gettime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t labstor_rdtsc(void) {
+#ifdef LABSTOR_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*The TSC ticks at a constant rate across P-states and C-states (CPUID 0x80000007, EDX bit 8)*/
+static inline int labstor_tsc_is_invariant(void) {
+#ifdef LABSTOR_HAS_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return 0;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+static inline uint64_t labstor_tsc_clock_now_ns(const struct labstor_tsc_clock *clock) {
+    uint32_t seq, invariant;
+    uint64_t mult, tsc_base, ns_base;
+    int64_t delta;
+    if(clock == NULL) {
+        return labstor_clock_gettime_ns();
+    }
+    do {
+        seq = __atomic_load_n(&clock->seq_, __ATOMIC_ACQUIRE);
+        invariant = __atomic_load_n(&clock->invariant_, __ATOMIC_RELAXED);
+        mult = __atomic_load_n(&clock->mult_, __ATOMIC_RELAXED);
+        tsc_base = __atomic_load_n(&clock->tsc_base_, __ATOMIC_RELAXED);
+        ns_base = __atomic_load_n(&clock->ns_base_, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || seq != __atomic_load_n(&clock->seq_, __ATOMIC_RELAXED));
+    if(!invariant) {
+        return labstor_clock_gettime_ns();
+    }
+
+    //Another core's TSC may trail tsc_base_ slightly, so the delta is signed
+    delta = (int64_t)(labstor_rdtsc() - tsc_base);
+    return ns_base + (int64_t)(((__int128)delta * mult) >> LABSTOR_TSC_CLOCK_SHIFT);
+}
+
+/*Pair a TSC reading with the clock_gettime reading taken halfway between two TSC reads*/
+static inline void labstor_tsc_sample(uint64_t *tsc, uint64_t *ns) {
+    uint64_t before = labstor_rdtsc();
+    *ns = labstor_clock_gettime_ns();
+    *tsc = before + (labstor_rdtsc() - before) / 2;
+}
+
+/*
+ * Only the server writes the clock. It spins for calibrate_ns to measure the TSC rate.
+ * A recalibrated clock never reads behind the conversion it replaces.
+ * */
+static inline void labstor_tsc_clock_calibrate(struct labstor_tsc_clock *clock, uint64_t calibrate_ns) {
+    uint64_t tsc0 = 0, ns0 = 0, tsc1 = 0, ns1 = 0, mult = 0, prior_ns;
+    uint32_t invariant = (uint32_t)labstor_tsc_is_invariant();
+    uint32_t seq = __atomic_load_n(&clock->seq_, __ATOMIC_RELAXED);
+    if(invariant) {
+        labstor_tsc_sample(&tsc0, &ns0);
+        do {
+            labstor_tsc_sample(&tsc1, &ns1);
+        } while(ns1 - ns0 < calibrate_ns);
+        if(tsc1 > tsc0) {
+            mult = (uint64_t)((((unsigned __int128)(ns1 - ns0)) << LABSTOR_TSC_CLOCK_SHIFT) / (tsc1 - tsc0));
+        }
+        invariant = mult != 0;
+    }
+    //Rebase on what the prior conversion reads at tsc1 if it is ahead of CLOCK_MONOTONIC
+    if(invariant && clock->invariant_) {
+        prior_ns = clock->ns_base_ + (int64_t)(((__int128)(int64_t)(tsc1 - clock->tsc_base_) * clock->mult_) >> LABSTOR_TSC_CLOCK_SHIFT);
+        if(prior_ns > ns1) {
+            ns1 = prior_ns;
+        }
+    }
+    __atomic_store_n(&clock->seq_, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&clock->mult_, mult, __ATOMIC_RELAXED);
+    __atomic_store_n(&clock->tsc_base_, tsc1, __ATOMIC_RELAXED);
+    __atomic_store_n(&clock->ns_base_, ns1, __ATOMIC_RELAXED);
+    __atomic_store_n(&clock->invariant_, invariant, __ATOMIC_RELAXED);
+    __atomic_store_n(&clock->seq_, seq + 2, __ATOMIC_RELEASE);
+}
+
+static inline void labstor_tsc_clock_init(struct labstor_tsc_clock *clock, uint64_t calibrate_ns) {
+    memset(clock, 0, sizeof(struct labstor_tsc_clock));
+    labstor_tsc_clock_calibrate(clock, calibrate_ns);
+}
+
+#endif //LABSTOR_TSC_CLOCK_H
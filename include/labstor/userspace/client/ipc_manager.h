@@ -32,6 +32,8 @@
 #include <vector>
 #include <labstor/userspace/client/macros.h>
 #include <labstor/userspace/types/socket.h>
+#include <labstor/userspace/types/shmem_provider.h>
+#include <labstor/userspace/types/messages.h>
 #include <labstor/constants/constants.h>
 #include <labstor/types/basics.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
@@ -41,19 +43,44 @@
 #include <sys/sysinfo.h>
 #include <sched.h>
 #include <mutex>
+#include <atomic>
 
 #define TRUSTED_SERVER_PATH "/tmp/labstor_trusted_server"
+//Queues per flag combination that GetQueuePairByName hashes names onto
+#define LABSTOR_CLIENT_NAMED_QUEUES 8
 
 namespace labstor::Client {
 
+/*
+ * The queue pairs a thread has claimed, one per flag combination.
+ * Claimed queues are returned to the IPCManager when the thread exits.
+ * */
+struct QueueClaim {
+    labstor::queue_pair *qps_[LABSTOR_MAX_QP_FLAG_COMBOS] = {nullptr};
+    ~QueueClaim();
+};
+
 class IPCManager : public QueuePool, public MemoryManager {
 private:
     int pid_, n_cpu_;
     UnixSocket serversock_;
     bool is_connected_;
+    uint32_t queue_depth_, max_queues_;
+    uint16_t ipc_id_;
+    std::mutex qp_lock_;
+    std::vector<labstor::queue_pair*> free_qps_[LABSTOR_MAX_QP_FLAG_COMBOS];
+    std::atomic<labstor::queue_pair*> named_qps_[LABSTOR_MAX_QP_FLAG_COMBOS][LABSTOR_CLIENT_NAMED_QUEUES];
+    labstor::ShmemProvider *shmem_;
+    labstor::ipc::setup_reply setup_;
+    uint32_t next_prebuilt_;
 public:
-    IPCManager() : is_connected_(false) {
+    IPCManager() : is_connected_(false), queue_depth_(0), max_queues_(0), ipc_id_(0), shmem_(nullptr), next_prebuilt_(0) {
         n_cpu_ = get_nprocs_conf();
+        for(auto &named_qps : named_qps_) {
+            for(auto &qp : named_qps) {
+                qp.store(nullptr, std::memory_order_relaxed);
+            }
+        }
     }
     void Connect();
     bool IsConnected() {
@@ -62,42 +89,68 @@ public:
     inline int GetPID() {
         return pid_;
     }
+    inline uint16_t GetIPCID() {
+        return ipc_id_;
+    }
+    inline labstor::ShmemProvider* GetShmem() {
+        return shmem_;
+    }
     inline int GetNumCPU() {
         return n_cpu_;
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags) {
         AUTO_TRACE("")
+        if(type == 0) {
+            GetQueuePair(qp, flags);
+            return;
+        }
         int off = labstor::queue_pair::GetQIDOff(type, flags, labstor::ThreadLocal::GetTid(), GetNumQueuePairsFast(type, flags), pid_);
         QueuePool::GetQueuePair(qp, type, flags, off);
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags) {
         AUTO_TRACE("")
-        int off = labstor::queue_pair::GetQIDOff(0, flags, labstor::ThreadLocal::GetTid(), GetNumQueuePairsFast(0, flags), pid_);
-        QueuePool::GetQueuePair(qp, 0, flags, off);
+        QueueClaim &claim = GetThreadClaim();
+        if(!claim.qps_[flags]) {
+            claim.qps_[flags] = ClaimQueuePair(flags);
+        }
+        qp = claim.qps_[flags];
+    }
+    inline void GetSharedQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags) {
+        AUTO_TRACE("")
+        //The first queue of every set is the shared MPSC queue
+        QueuePool::GetQueuePair(qp, 0, flags, 0);
     }
     inline void GetQueuePairByName(labstor::queue_pair *&qp, labstor_qid_flags_t flags, const std::string &str, uint32_t ns_id) {
         AUTO_TRACE("")
-        int off = labstor::queue_pair::GetQIDOff(0, flags, str, ns_id, GetNumQueuePairsFast(0, flags), pid_);
-        QueuePool::GetQueuePair(qp, 0, flags, off);
+        //Requests for the same name always land on the same queue. Named queues are never owned by
+        //a thread, so every producer takes the queue's enqueue lock.
+        uint32_t slot = labstor::queue_pair::GetQIDOff(0, flags, str, ns_id, LABSTOR_CLIENT_NAMED_QUEUES, pid_);
+        qp = named_qps_[flags][slot].load(std::memory_order_acquire);
+        if(!qp) {
+            qp = ClaimNamedQueuePair(flags, slot);
+        }
     }
+    void ReleaseQueuePair(labstor::queue_pair *qp);
+    labstor::ipc::shmem_queue_pair* CreateQueuePair(labstor_qid_flags_t flags, uint32_t depth);
+    void DestroyQueuePair(labstor::ipc::shmem_queue_pair *qp);
 
     template<typename T=labstor::ipc::request>
     T* Wait(labstor::ipc::qtok_t &qtok) {
         AUTO_TRACE("")
-        T *rq;
         labstor::queue_pair *qp;
         QueuePool::GetQueuePair(qp, qtok);
-        rq = qp->Wait<T>(qtok.req_id_);
-        return rq;
+        //Queues of the built-in "LabStor" type are always shmem_queue_pairs, so skip the vtable
+        if(qtok.qid_.type_ == 0) {
+            return static_cast<labstor::ipc::shmem_queue_pair*>(qp)->Wait<T>(qtok.req_id_);
+        }
+        return qp->Wait<T>(qtok.req_id_);
     }
     template<typename T=labstor::ipc::request>
     int WaitFree(labstor::ipc::qtok_t &qtok) {
         AUTO_TRACE("")
         int ret;
         T *rq;
-        labstor::queue_pair *qp;
-        QueuePool::GetQueuePair(qp, qtok);
-        rq = qp->Wait<T>(qtok.req_id_);
+        rq = Wait<T>(qtok);
         ret = rq->GetCode();
         FreeRequest<T>(qtok, rq);
         return ret;
@@ -125,7 +178,17 @@ public:
     void WaitForPause();
     void ResumeQueues();
 private:
-    void CreateQueuesSHMEM(int num_queues, int queue_size);
+    static inline QueueClaim& GetThreadClaim() {
+        static thread_local QueueClaim claim;
+        return claim;
+    }
+    labstor::queue_pair* ClaimQueuePair(labstor_qid_flags_t flags);
+    labstor::queue_pair* ClaimNamedQueuePair(labstor_qid_flags_t flags, uint32_t slot);
+    labstor::ipc::shmem_queue_pair* AttachPrebuiltQueuePair(uint32_t i);
+    labstor::ipc::shmem_queue_pair* AllocQueuePair(labstor::ipc::qid_t qid, uint32_t depth);
+    void FreeQueuePair(labstor::ipc::shmem_queue_pair *qp);
+    bool SendRegisterQueuePairs(std::vector<labstor::ipc::shmem_queue_pair*> &new_qps);
+    bool CreateQueuesSHMEM(labstor_qid_flags_t flags, int num_queues, int queue_size);
     void CreatePrivateQueues(int num_queues, int queue_size);
 };
 
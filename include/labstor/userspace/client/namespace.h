@@ -28,6 +28,7 @@
 #define LABSTOR_CLIENT_NAMESPACE_H
 
 #include <vector>
+#include <sys/mman.h>
 
 #include <labstor/userspace/types/shared_namespace.h>
 #include <labstor/constants/macros.h>
@@ -40,7 +41,6 @@
 #include <labstor/types/data_structures/unordered_map/shmem_string_map.h>
 #include <labstor/userspace/types/module.h>
 #include <labmods/registrar/client/registrar_client.h>
-#include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
 
 namespace labstor::Client {
 
@@ -53,16 +53,31 @@ struct Namespace : public labstor::Namespace {
         module_manager_ = LABSTOR_MODULE_MANAGER;
     }
 
-    void Attach(int region_id, uint32_t region_size) {
+    void Attach(int region_id, uint32_t region_size, uint32_t max_entries) {
         region_id_ = region_id;
-        region_ = labstor::kernel::netlink::ShmemClient::MapShmem(region_id, region_size);
+        region_size_ = region_size;
+        max_entries_ = max_entries;
+        private_state_.Init(max_entries);
+        region_ = ipc_manager_->GetShmem()->MapShmem(region_id, region_size);
         void *section = region_;
+        //Only the server writes the clock page
+        clock_ = (struct labstor_tsc_clock*)section;
+        //Fails on huge page mappings, which cannot be split, and the clock works without it
+        if(mprotect(clock_, LABSTOR_TSC_CLOCK_PAGE_SIZE, PROT_READ) < 0) {
+            CLOCK_PAGE_PROTECT_FAILED.format(strerror(errno))->print();
+        }
+        labstor_set_clock_page(clock_);
+        section = (char*)section + LABSTOR_TSC_CLOCK_PAGE_SIZE;
         ns_ids_.Attach(section);
         section = ns_ids_.GetNextSection();
         key_to_ns_id_.Attach(region_, section);
-        section = ns_ids_.GetNextSection();
+        section = key_to_ns_id_.GetNextSection();
+        mount_points_.Attach(region_, section);
+        section = mount_points_.GetNextSection();
+        routes_.Attach(region_, section);
+        section = routes_.GetNextSection();
 
-        TRACEPOINT("SIZES", ns_ids_.GetSize(), key_to_ns_id_.GetSize(), region_id_)
+        TRACEPOINT("SIZES", ns_ids_.GetSize(), key_to_ns_id_.GetSize(), mount_points_.GetSize(), routes_.GetSize(), region_id_)
 
         labstor::ipc::shmem_allocator *alloc;
         alloc = new labstor::ipc::shmem_allocator();
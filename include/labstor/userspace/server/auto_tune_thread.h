@@ -0,0 +1,87 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_AUTO_TUNE_THREAD_H
+#define LABSTOR_AUTO_TUNE_THREAD_H
+
+#include <thread>
+#include <chrono>
+#include <labstor/userspace/util/errors.h>
+#include <labstor/types/daemon.h>
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/ipc_manager.h>
+#include <labstor/userspace/server/work_orchestrator.h>
+#include <labstor/userspace/server/auto_tuner.h>
+
+namespace labstor::Server {
+
+/*
+ * Resizes the queues of clients that connect from now on, based on the fullest client queue the workers
+ * saw over the last interval. Queues of connected clients keep their depth.
+ * */
+class AutoTuneWorker : public DaemonWorker {
+private:
+    LABSTOR_CONFIGURATION_MANAGER_T labstor_config_;
+    LABSTOR_IPC_MANAGER_T ipc_manager_;
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_;
+    uint32_t min_depth_, max_depth_, interval_ms_;
+    std::string emit_path_;
+public:
+    AutoTuneWorker() {
+        labstor_config_ = LABSTOR_CONFIGURATION_MANAGER;
+        ipc_manager_ = LABSTOR_IPC_MANAGER;
+        work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+        const auto &config = labstor_config_->config_["auto_tune"];
+        min_depth_ = LABSTOR_AUTO_TUNE_MIN_QUEUE_DEPTH;
+        max_depth_ = LABSTOR_AUTO_TUNE_MAX_QUEUE_DEPTH;
+        interval_ms_ = 1000;
+        if(config["min_queue_depth"]) { min_depth_ = config["min_queue_depth"].as<uint32_t>(); }
+        if(config["max_queue_depth"]) { max_depth_ = config["max_queue_depth"].as<uint32_t>(); }
+        if(config["interval_ms"]) { interval_ms_ = config["interval_ms"].as<uint32_t>(); }
+        if(config["emit"]) { emit_path_ = config["emit"].as<std::string>(); }
+    }
+
+    void DoWork() override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms_));
+        uint32_t high_water_mark = work_orchestrator_->TakeClientHighWaterMark();
+        uint32_t depth = ipc_manager_->GetClientQueueDepth();
+        uint32_t new_depth = AutoTuner::AdjustQueueDepth(depth, high_water_mark, min_depth_, max_depth_);
+        if(new_depth == depth || !ipc_manager_->SetClientQueueDepth(new_depth)) {
+            return;
+        }
+        TRACEPOINT("Client queue depth", depth, new_depth, "high-water mark", high_water_mark)
+        ipc_manager_->RequestClientRegions();
+        if(!emit_path_.empty()) {
+            YAML::Node config = YAML::Clone(labstor_config_->config_);
+            config["ipc_manager"]["client"]["queue_depth"] = new_depth;
+            AutoTuner::Emit(config, emit_path_);
+        }
+    }
+};
+
+}
+
+#endif //LABSTOR_AUTO_TUNE_THREAD_H
@@ -0,0 +1,340 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_AUTO_TUNER_H
+#define LABSTOR_SERVER_AUTO_TUNER_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <yaml-cpp/yaml.h>
+#include <labstor/constants/debug.h>
+#include <labstor/userspace/util/errors.h>
+#include <labstor/userspace/util/serializeable.h>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+
+#define LABSTOR_AUTO_TUNE_MIN_QUEUE_DEPTH 64
+#define LABSTOR_AUTO_TUNE_MAX_QUEUE_DEPTH 1024
+#define LABSTOR_AUTO_TUNE_CACHE_LINE 64
+#define LABSTOR_AUTO_TUNE_LLC_KB 8192
+
+namespace labstor::Server {
+
+struct CpuInfo {
+    int cpu_id_;
+    int core_id_;
+    int package_id_;
+    int node_id_;
+};
+
+struct CpuTopology {
+    std::vector<CpuInfo> cpus_;
+    uint32_t num_nodes_;
+    uint32_t llc_size_kb_;
+    uint32_t cache_line_;
+};
+
+/*
+ * Derives the configuration values an operator leaves out (or sets to "auto") from the CPU, NUMA, and
+ * last-level cache topology in sysfs. Workers get one SMT thread per physical core, skipping the core of
+ * the admin thread, and the kernel profile gives each NUMA node one kernel worker. Queue counts follow the
+ * worker counts. Queue depths are sized so the requests in flight fit in half of the LLC. Region sizes are
+ * derived last so that LoadMemoryConfig always accepts them.
+ * */
+class AutoTuner {
+private:
+    uint32_t min_depth_, max_depth_;
+public:
+    AutoTuner() : min_depth_(LABSTOR_AUTO_TUNE_MIN_QUEUE_DEPTH), max_depth_(LABSTOR_AUTO_TUNE_MAX_QUEUE_DEPTH) {}
+
+    static bool IsAuto(const YAML::Node &node) {
+        return !node || (node.IsScalar() && node.as<std::string>() == "auto");
+    }
+
+    /*Parse a sysfs cpu list, e.g., "0-3,8,10-11"*/
+    static std::vector<int> ParseCpuList(const std::string &list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ',')) {
+            if(range.find_first_of("0123456789") == std::string::npos) {
+                continue;
+            }
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu) {
+                cpus.emplace_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    /*Without sysfs, every hardware thread is treated as its own core on node 0*/
+    static CpuTopology ReadTopology(const std::string &sysfs_root = "/sys") {
+        CpuTopology topo;
+        std::string cpu_root = sysfs_root + "/devices/system/cpu";
+        std::string node_root = sysfs_root + "/devices/system/node";
+        std::vector<int> online = ParseCpuList(ReadString(cpu_root + "/online"));
+        if(online.empty()) {
+            uint32_t ncpu = std::max(1u, std::thread::hardware_concurrency());
+            for(uint32_t cpu = 0; cpu < ncpu; ++cpu) { online.emplace_back(cpu); }
+        }
+
+        std::set<int> nodes;
+        for(int cpu : online) {
+            std::string path = cpu_root + "/cpu" + std::to_string(cpu);
+            CpuInfo info;
+            info.cpu_id_ = cpu;
+            info.core_id_ = ReadInt(path + "/topology/core_id", cpu);
+            info.package_id_ = ReadInt(path + "/topology/physical_package_id", 0);
+            info.node_id_ = 0;
+            topo.cpus_.emplace_back(info);
+        }
+        std::error_code ec;
+        for(auto &entry : std::filesystem::directory_iterator(node_root, ec)) {
+            std::string name = entry.path().filename();
+            if(name.rfind("node", 0) != 0 || name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+            int node = std::stoi(name.substr(4));
+            for(int cpu : ParseCpuList(ReadString(entry.path().string() + "/cpulist"))) {
+                for(auto &info : topo.cpus_) {
+                    if(info.cpu_id_ == cpu) { info.node_id_ = node; }
+                }
+            }
+        }
+        for(auto &info : topo.cpus_) { nodes.emplace(info.node_id_); }
+        topo.num_nodes_ = nodes.size();
+
+        //The highest cache level of the first CPU is the LLC
+        topo.llc_size_kb_ = LABSTOR_AUTO_TUNE_LLC_KB;
+        topo.cache_line_ = LABSTOR_AUTO_TUNE_CACHE_LINE;
+        int llc_level = 0;
+        std::string cache_root = cpu_root + "/cpu" + std::to_string(topo.cpus_[0].cpu_id_) + "/cache";
+        for(auto &entry : std::filesystem::directory_iterator(cache_root, ec)) {
+            std::string path = entry.path().string();
+            int level = ReadInt(path + "/level", 0);
+            if(level <= llc_level || ReadString(path + "/type") == "Instruction") {
+                continue;
+            }
+            llc_level = level;
+            std::string size = ReadString(path + "/size");
+            if(!size.empty()) {
+                topo.llc_size_kb_ = std::stoul(size);
+                if(size.back() == 'M') { topo.llc_size_kb_ *= 1024; }
+            }
+            topo.cache_line_ = ReadInt(path + "/coherency_line_size", LABSTOR_AUTO_TUNE_CACHE_LINE);
+        }
+        return topo;
+    }
+
+    /*Grow the depth when a client queue came within a quarter of full, and shrink it when it stayed below a quarter*/
+    static uint32_t AdjustQueueDepth(uint32_t depth, uint32_t high_water_mark, uint32_t min_depth, uint32_t max_depth) {
+        uint32_t new_depth = depth;
+        if(4ull * high_water_mark >= 3ull * depth) {
+            new_depth = depth * 2;
+        } else if(4ull * high_water_mark < depth) {
+            new_depth = std::max(depth / 2, 2 * high_water_mark);
+        }
+        return std::min(std::max(new_depth, min_depth), max_depth);
+    }
+
+    static void Emit(const YAML::Node &config, const std::string &path) {
+        std::ofstream out(path);
+        if(!out) {
+            printf("Could not write the tuned configuration to %s\n", path.c_str());
+            return;
+        }
+        out << config << std::endl;
+    }
+
+    void Tune(YAML::Node &config, const CpuTopology &topo) {
+        AUTO_TRACE("")
+        bool userspace_only = config["profile"] && config["profile"].as<std::string>() == "userspace-only";
+        if(config["auto_tune"]["min_queue_depth"]) {
+            min_depth_ = config["auto_tune"]["min_queue_depth"].as<uint32_t>();
+        }
+        if(config["auto_tune"]["max_queue_depth"]) {
+            max_depth_ = config["auto_tune"]["max_queue_depth"].as<uint32_t>();
+        }
+        if(min_depth_ == 0 || min_depth_ > max_depth_) {
+            throw AUTO_TUNE_INVALID.format("min_queue_depth must be between 1 and max_queue_depth");
+        }
+        if(topo.cpus_.empty()) {
+            throw AUTO_TUNE_INVALID.format("no online CPUs were found");
+        }
+
+        if(IsAuto(config["admin_thread"])) {
+            config["admin_thread"] = topo.cpus_[0].cpu_id_;
+        }
+        TuneWorkers(config["work_orchestrator"], topo, config["admin_thread"].as<int>(), userspace_only);
+
+        uint32_t num_server_workers = config["work_orchestrator"]["server_workers"].size();
+        uint32_t num_kernel_workers = std::max<uint32_t>(1, config["work_orchestrator"]["kernel_workers"].size());
+        TuneMemoryConfig(config["ipc_manager"]["client"], topo, 256, num_server_workers, true);
+        TuneMemoryConfig(config["ipc_manager"]["kernel"], topo, 64, num_kernel_workers, false);
+        TuneMemoryConfig(config["ipc_manager"]["private"], topo, 64, num_server_workers, false);
+    }
+
+private:
+    static std::string ReadString(const std::string &path) {
+        std::ifstream in(path);
+        std::string value;
+        std::getline(in, value);
+        return value;
+    }
+
+    static int ReadInt(const std::string &path, int fallback) {
+        std::string value = ReadString(path);
+        if(value.empty() || value.find_first_of("0123456789") == std::string::npos) {
+            return fallback;
+        }
+        return std::stoi(value);
+    }
+
+    static uint32_t FloorPow2(uint32_t n) {
+        uint32_t pow2 = 1;
+        while(pow2 <= n / 2) { pow2 *= 2; }
+        return pow2;
+    }
+
+    static uint32_t DivRoundUp(uint64_t n, uint64_t d) {
+        return (uint32_t)((n + d - 1) / d);
+    }
+
+    void TuneWorkers(YAML::Node config, const CpuTopology &topo, int admin_cpu, bool userspace_only) {
+        //One SMT thread per physical core, grouped by NUMA node
+        std::vector<CpuInfo> cores;
+        std::set<std::tuple<int, int>> seen;
+        std::vector<CpuInfo> cpus = topo.cpus_;
+        std::sort(cpus.begin(), cpus.end(), [](const CpuInfo &a, const CpuInfo &b) {
+            return std::tie(a.node_id_, a.package_id_, a.core_id_, a.cpu_id_) <
+                   std::tie(b.node_id_, b.package_id_, b.core_id_, b.cpu_id_);
+        });
+        const CpuInfo *admin = &cpus[0];
+        for(auto &cpu : cpus) {
+            if(cpu.cpu_id_ == admin_cpu) { admin = &cpu; }
+        }
+        for(auto &cpu : cpus) {
+            bool admin_core = cpu.package_id_ == admin->package_id_ && cpu.core_id_ == admin->core_id_;
+            if(seen.emplace(cpu.package_id_, cpu.core_id_).second && !admin_core) {
+                cores.emplace_back(cpu);
+            }
+        }
+        if(cores.empty()) {
+            cores.emplace_back(*admin);
+        }
+
+        //The kernel profile takes the last core of each node for a kernel worker, keeping one server core
+        std::vector<int> kernel_cpus, server_cpus;
+        if(!userspace_only) {
+            for(auto iter = cores.rbegin(); iter != cores.rend() && cores.size() - kernel_cpus.size() > 1; ++iter) {
+                if(std::none_of(cores.begin(), cores.end(), [&](const CpuInfo &core) {
+                        return core.node_id_ == iter->node_id_ &&
+                               std::find(kernel_cpus.begin(), kernel_cpus.end(), core.cpu_id_) != kernel_cpus.end(); })) {
+                    kernel_cpus.emplace_back(iter->cpu_id_);
+                }
+            }
+        }
+        for(auto &core : cores) {
+            if(std::find(kernel_cpus.begin(), kernel_cpus.end(), core.cpu_id_) == kernel_cpus.end()) {
+                server_cpus.emplace_back(core.cpu_id_);
+            }
+        }
+        if(!userspace_only && kernel_cpus.empty()) {
+            kernel_cpus.emplace_back(server_cpus.back());
+        }
+
+        if(IsAuto(config["server_workers"])) {
+            config["server_workers"] = YAML::Node(YAML::NodeType::Sequence);
+            for(size_t i = 0; i < server_cpus.size(); ++i) {
+                YAML::Node worker;
+                worker["worker_id"] = i;
+                worker["cpu_id"] = server_cpus[i];
+                worker["role"] = "general";
+                config["server_workers"].push_back(worker);
+            }
+        }
+        if(IsAuto(config["kernel_workers"])) {
+            config["kernel_workers"] = YAML::Node(YAML::NodeType::Sequence);
+            for(size_t i = 0; i < kernel_cpus.size(); ++i) {
+                YAML::Node worker;
+                worker["worker_id"] = i;
+                worker["cpu_id"] = kernel_cpus[i];
+                config["kernel_workers"].push_back(worker);
+            }
+        }
+    }
+
+    void TuneMemoryConfig(YAML::Node config, const CpuTopology &topo, uint32_t request_unit,
+                          uint32_t num_queues, bool is_client) {
+        if(IsAuto(config["request_unit_bytes"])) {
+            config["request_unit_bytes"] = DivRoundUp(request_unit, topo.cache_line_) * topo.cache_line_;
+        }
+        if(IsAuto(config["num_queues"])) {
+            config["num_queues"] = num_queues;
+        }
+        request_unit = config["request_unit_bytes"].as<uint32_t>();
+        num_queues = config["num_queues"].as<uint32_t>();
+        uint32_t max_queues = num_queues;
+        if(is_client) {
+            if(IsAuto(config["max_queues"])) {
+                config["max_queues"] = 4 * num_queues;
+            }
+            max_queues = std::max(num_queues, config["max_queues"].as<uint32_t>());
+        }
+
+        //Requests in flight on every queue fit in half of the LLC
+        if(IsAuto(config["queue_depth"])) {
+            uint64_t llc_share = (uint64_t)topo.llc_size_kb_ * SizeType::KB / 2 / ((uint64_t)num_queues * request_unit);
+            uint32_t depth = FloorPow2((uint32_t)std::min<uint64_t>(llc_share, UINT32_MAX));
+            config["queue_depth"] = std::min(std::max(depth, min_depth_), max_depth_);
+        }
+        uint32_t depth = config["queue_depth"].as<uint32_t>();
+        if(IsAuto(config["min_request_region_kb"])) {
+            config["min_request_region_kb"] = DivRoundUp((uint64_t)num_queues * depth * request_unit, SizeType::KB);
+        }
+
+        //Client queues are resized at runtime, so leave room for the largest depth they may reach
+        if(IsAuto(config["max_region_size_kb"])) {
+            uint32_t queue_depth = is_client ? std::max(depth, max_depth_) : depth;
+            uint64_t queue_region = (uint64_t)max_queues * labstor::ipc::shmem_queue_pair::GetSize(queue_depth);
+            uint64_t request_region = (uint64_t)config["min_request_region_kb"].as<uint32_t>() * SizeType::KB;
+            config["max_region_size_kb"] = DivRoundUp(queue_region + request_region, SizeType::KB) + 1;
+        }
+    }
+};
+
+}
+
+#endif //LABSTOR_SERVER_AUTO_TUNER_H
@@ -0,0 +1,102 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_DEADLINE_QUEUE_H
+#define LABSTOR_SERVER_DEADLINE_QUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <labstor/userspace/types/module.h>
+#include <labstor/types/data_structures/shmem_request.h>
+#include "labstor/types/data_structures/c/shmem_work_queue_secure.h"
+
+#define LABSTOR_DEADLINE_QUEUE_MAX_DEPTH 1024
+
+namespace labstor::Server {
+
+struct deadline_request {
+    uint64_t deadline_;
+    uint64_t seq_;
+    labstor_work_queue_secure_entry *entry_;
+    void *qp_ptr_;
+    labstor::ipc::request *rq_;
+    //The instance that started the request, if its handler returned without completing it
+    labstor::Module *module_;
+};
+
+/*
+ * Requests dequeued from UNORDERED queues, ordered earliest-deadline-first.
+ * Requests without a deadline sort after every request with one and keep their arrival order.
+ * */
+class deadline_queue {
+private:
+    std::vector<deadline_request> heap_;
+    uint64_t seq_;
+    uint32_t max_depth_;
+
+    static inline bool Later(const deadline_request &a, const deadline_request &b) {
+        if(a.deadline_ != b.deadline_) { return a.deadline_ > b.deadline_; }
+        return a.seq_ > b.seq_;
+    }
+public:
+    deadline_queue() : seq_(0), max_depth_(LABSTOR_DEADLINE_QUEUE_MAX_DEPTH) {}
+
+    inline void Init(uint32_t max_depth = LABSTOR_DEADLINE_QUEUE_MAX_DEPTH) {
+        max_depth_ = max_depth;
+        heap_.reserve(max_depth_);
+    }
+    inline bool IsFull() { return heap_.size() >= max_depth_; }
+    inline bool IsEmpty() { return heap_.empty(); }
+    inline uint32_t GetDepth() { return heap_.size(); }
+
+    inline void Push(labstor_work_queue_secure_entry *entry, void *qp_ptr, labstor::ipc::request *rq) {
+        uint64_t deadline = rq->HasDeadline() ? rq->GetDeadline() : UINT64_MAX;
+        heap_.emplace_back(deadline_request{deadline, seq_++, entry, qp_ptr, rq, nullptr});
+        std::push_heap(heap_.begin(), heap_.end(), Later);
+    }
+    inline void Push(const deadline_request &drq) {
+        heap_.emplace_back(drq);
+        std::push_heap(heap_.begin(), heap_.end(), Later);
+    }
+    /*Remove every request for which remove(drq) is true, e.g., because its queue pair is being freed*/
+    template<typename F>
+    inline uint32_t RemoveIf(F remove) {
+        size_t depth = heap_.size();
+        heap_.erase(std::remove_if(heap_.begin(), heap_.end(), remove), heap_.end());
+        std::make_heap(heap_.begin(), heap_.end(), Later);
+        return depth - heap_.size();
+    }
+    inline deadline_request Pop() {
+        std::pop_heap(heap_.begin(), heap_.end(), Later);
+        deadline_request drq = heap_.back();
+        heap_.pop_back();
+        return drq;
+    }
+};
+
+}
+
+#endif //LABSTOR_SERVER_DEADLINE_QUEUE_H
@@ -0,0 +1,117 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_DISPATCH_H
+#define LABSTOR_SERVER_DISPATCH_H
+
+#include <labstor/types/data_structures/queue_pair.h>
+#include <labstor/userspace/types/module.h>
+#include <labstor/userspace/server/macros.h>
+#include <labstor/userspace/server/namespace.h>
+
+#define LABSTOR_MAX_INLINE_DEPTH 4
+
+namespace labstor::Server {
+
+/*
+ * The queue pair handed to a module called inline. Everything is forwarded to the caller's
+ * queue pair, except that a completion is kept on this thread instead of being published
+ * to the completion queue, since the caller is waiting on the stack.
+ * */
+class inline_queue_pair : public labstor::queue_pair {
+private:
+    labstor::queue_pair *qp_;
+    labstor::ipc::request *completed_;
+public:
+    explicit inline_queue_pair(labstor::queue_pair *qp) : qp_(qp), completed_(nullptr) {}
+    inline labstor::ipc::qid_t& GetQID() override { return qp_->GetQID(); }
+    inline uint32_t GetDepth() override { return qp_->GetDepth(); }
+    inline labstor::ipc::request* GetCompleted() { return completed_; }
+private:
+    inline bool _Enqueue(labstor::ipc::request *rq, labstor::ipc::qtok_t &qtok) override {
+        return qp_->Enqueue(rq, qtok);
+    }
+    inline bool _Peek(labstor::ipc::request **rq, int i) override {
+        return qp_->Peek(*rq, i);
+    }
+    inline bool _Dequeue(labstor::ipc::request **rq) override {
+        return qp_->Dequeue(*rq);
+    }
+    inline void _Complete(labstor_req_id_t req_id, labstor::ipc::request *rq) override {
+        completed_ = rq;
+    }
+    inline bool _IsComplete(labstor_req_id_t req_id, labstor::ipc::request **rq) override {
+        return qp_->IsComplete(req_id, *rq);
+    }
+};
+
+inline uint32_t& GetInlineDepth() {
+    static thread_local uint32_t depth = 0;
+    return depth;
+}
+
+/*
+ * Submit rq to the module at rq's ns_id through qp.
+ * If that module runs in this runtime, is inlinable, is not being upgraded and is not pinned to a
+ * worker group, its handler is called directly on this thread rather than waiting for a worker to poll qp. Returns true if
+ * the request completed inline, in which case rq points to the completed request and qtok is unused.
+ * Otherwise rq was enqueued on qp (including when the callee could not finish without blocking)
+ * and completes through qtok as usual. ns defaults to the server's namespace.
+ * */
+template<typename T>
+inline bool Dispatch(labstor::queue_pair *qp, T *&rq, labstor::ipc::qtok_t &qtok, labstor::credentials *creds,
+                     labstor::Namespace *ns = nullptr) {
+    labstor::Namespace *namespace_ = ns ? ns : LABSTOR_NAMESPACE;
+    uint32_t &depth = GetInlineDepth();
+    uint32_t ns_id = rq->GetNamespaceID();
+    labstor::Module *module;
+    if(depth < LABSTOR_MAX_INLINE_DEPTH && !namespace_->IsPaused(ns_id) && !namespace_->GetQueueType(ns_id) &&
+        (module = namespace_->GetModule(ns_id)) != nullptr && module->IsInlinable()) {
+        inline_queue_pair inline_qp(qp);
+        bool is_complete;
+        ++depth;
+        LABSTOR_ERROR_HANDLE_TRY {
+            is_complete = module->ProcessRequest(&inline_qp, reinterpret_cast<labstor::ipc::request*>(rq), creds);
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            --depth;
+            throw err;
+        }
+        --depth;
+        if(is_complete) {
+            if(inline_qp.GetCompleted()) {
+                rq = reinterpret_cast<T*>(inline_qp.GetCompleted());
+            }
+            return true;
+        }
+        //The callee would block; a worker resumes it from the state it left in rq
+    }
+    qp->Enqueue(rq, qtok);
+    return false;
+}
+
+}
+
+#endif //LABSTOR_SERVER_DISPATCH_H
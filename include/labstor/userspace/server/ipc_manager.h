@@ -31,13 +31,19 @@
 #include <unistd.h>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
 
 #include <labstor/constants/constants.h>
 #include <labstor/userspace/types/messages.h>
 #include <labstor/userspace/types/socket.h>
+#include <labstor/userspace/types/shmem_provider.h>
 #include <labstor/types/basics.h>
 #include <labstor/types/allocator/allocator.h>
 #include <labstor/types/allocator/segment_allocator.h>
+#include <labstor/types/allocator/shmem_allocator.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include "per_process_ipc.h"
 #include <labstor/types/thread_local.h>
@@ -54,12 +60,22 @@ struct MemoryConfig {
     uint32_t min_request_region;
     uint32_t queue_depth;
     uint32_t num_queues;
+    uint32_t max_queues;
+    uint32_t num_prepared_regions;
     uint32_t queue_region_size;
     uint32_t request_region_size;
     uint32_t request_queue_size;
     uint32_t request_map_size;
 };
 
+/*A client region created ahead of time, with its request allocator and initial queues initialized*/
+struct PreparedClientRegion {
+    int region_id_;
+    void *region_;
+    labstor::ipc::shmem_allocator *alloc_;
+    MemoryConfig memconf_;
+};
+
 class IPCManager {
 private:
     int pid_;
@@ -67,23 +83,45 @@ private:
     void *private_mem_, *kern_base_region_;
     std::mutex lock_;
     labstor::GenericAllocator *private_alloc_;
-    std::unordered_map<uint32_t,PerProcessIPC*> pid_to_ipc_;
+    //Indexed by the IPC id in each qid. Slots are published with release stores and
+    //only reclaimed after every worker has passed a quiescent point.
+    PerProcessIPC *ipcs_[LABSTOR_MAX_IPC_IDS];
+    uint32_t max_ipc_id_;
+    std::unordered_map<uint32_t,uint16_t> pid_to_ipc_id_;
+    labstor::ShmemProvider *shmem_;
+    labstor::ShmemProviderType shmem_type_;
+    std::mutex prepare_lock_;
+    std::condition_variable prepare_cv_;
+    bool refill_requested_;
+    uint32_t num_preparing_;
+    std::vector<PreparedClientRegion> prepared_regions_;
+    std::atomic<uint32_t> client_queue_depth_;
     LABSTOR_CONFIGURATION_MANAGER_T labstor_config_;
 public:
-    IPCManager() {
+    IPCManager() : max_ipc_id_(0), refill_requested_(false), num_preparing_(0), client_queue_depth_(0) {
         pid_ = getpid();
         labstor_config_ = LABSTOR_CONFIGURATION_MANAGER;
+        memset(ipcs_, 0, sizeof(ipcs_));
+        InitShmemProvider();
     }
 
     inline void SetServerFd(int fd) { server_fd_ = fd; }
     inline int GetServerFd() { return server_fd_; }
 
     void LoadMemoryConfig(std::string pid_type, MemoryConfig &config);
+    void InitShmemProvider();
     void InitializeKernelIPCManager();
     void CreateKernelQueues();
     void CreatePrivateQueues();
+    void PrepareClientRegions();
+    void RequestClientRegions();
+    bool WaitForClientRegionRequest(int timeout_ms);
+    uint32_t GetClientQueueDepth();
+    bool SetClientQueueDepth(uint32_t queue_depth);
     void RegisterClient(int client_fd, labstor::credentials &creds);
-    void RegisterClientQP(PerProcessIPC *client_ipc, void *region);
+    void RegisterClientQP(PerProcessIPC *client_ipc);
+    void UnregisterClientQP(PerProcessIPC *client_ipc);
+    void FreeClientRegion(PerProcessIPC *client_ipc);
     void PauseQueues();
     void WaitForPause();
     void ResumeQueues();
@@ -91,53 +129,63 @@ public:
     int GetPID() {
         return pid_;
     }
+    inline labstor::ShmemProvider* GetShmem() { return shmem_; }
+    inline labstor::ShmemProviderType GetShmemType() { return shmem_type_; }
     PerProcessIPC* RegisterIPC(int pid) {
         PerProcessIPC *ipc = new PerProcessIPC(pid);
-        pid_to_ipc_.emplace(pid, ipc);
+        PublishIPC(ipc, pid == KERNEL_PID ? LABSTOR_KERNEL_IPC_ID : LABSTOR_SERVER_IPC_ID);
         return ipc;
     }
     PerProcessIPC* RegisterIPC(int fd, labstor::credentials &creds) {
         PerProcessIPC *ipc = new PerProcessIPC(fd, creds);
-        pid_to_ipc_.emplace(creds.pid_, ipc);
+        PublishIPC(ipc, -1);
+        return ipc;
+    }
+    PerProcessIPC* UnregisterIPC(PerProcessIPC *ipc) {
+        std::lock_guard<std::mutex> lock(lock_);
+        __atomic_store_n(&ipcs_[ipc->GetIPCID()], nullptr, __ATOMIC_RELEASE);
+        pid_to_ipc_id_.erase(ipc->GetPID());
         return ipc;
     }
     inline bool RegisterQueuePair(labstor::queue_pair *qp) {
-        //TODO: Thread safety? Not important now
         TRACEPOINT("pid", qp->GetQID().pid_, "pid", qp->GetQID().type_, "flags", qp->GetQID().flags_, "cnt", qp->GetQID().cnt_)
-        pid_to_ipc_[qp->GetQID().pid_]->RegisterQueuePair(qp);
+        GetIPC(qp->GetQID())->RegisterQueuePair(qp);
         return true;
     }
     inline bool UnregisterQueuePair(labstor::queue_pair *qp) {
-        //Todo: Dynamic queue management
-        return false;
+        PerProcessIPC *ipc = FindIPC(qp->GetQID());
+        if(!ipc) {
+            return false;
+        }
+        return ipc->UnregisterQueuePair(qp);
     }
     inline void* GetRegion(labstor::queue_pair *qp, labstor::credentials *&creds) {
-        PerProcessIPC *ipc = pid_to_ipc_[qp->GetPID()];
+        PerProcessIPC *ipc = GetIPC(qp->GetQID());
         creds = &ipc->creds_;
         return ipc->GetRegion();
     }
     inline void* GetRegion(labstor::queue_pair *qp) {
-        return pid_to_ipc_[LABSTOR_GET_QP_IPC_ID(qp->GetQID())]->GetRegion();
+        return GetIPC(qp->GetQID())->GetRegion();
     }
 
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags, int cnt) {
-        auto &ipc = pid_to_ipc_[pid_];
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(type, flags, labstor::ThreadLocal::GetTid(), ipc->GetNumQueuePairsFast(0, flags), pid_);
-        pid_to_ipc_[qid.pid_]->GetQueuePair(qp, qid);
+        PerProcessIPC *ipc = GetIPCByID(LABSTOR_SERVER_IPC_ID);
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(type, flags, labstor::ThreadLocal::GetTid(), ipc->GetNumQueuePairsFast(0, flags), pid_, LABSTOR_SERVER_IPC_ID);
+        ipc->GetQueuePair(qp, qid);
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags) {
-        auto &ipc = pid_to_ipc_[pid_];
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, labstor::ThreadLocal::GetTid(), ipc->GetNumQueuePairsFast(0, flags), pid_);
-        pid_to_ipc_[qid.pid_]->GetQueuePair(qp, qid);
+        PerProcessIPC *ipc = GetIPCByID(LABSTOR_SERVER_IPC_ID);
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, labstor::ThreadLocal::GetTid(), ipc->GetNumQueuePairsFast(0, flags), pid_, LABSTOR_SERVER_IPC_ID);
+        ipc->GetQueuePair(qp, qid);
     }
     inline void GetQueuePairByName(labstor::queue_pair *&qp, labstor_qid_flags_t flags, const std::string &str, uint32_t ns_id) {
-        auto &ipc = pid_to_ipc_[pid_];
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, str, ns_id, ipc->GetNumQueuePairsFast(0, flags), pid_);
+        PerProcessIPC *ipc = GetIPCByID(LABSTOR_SERVER_IPC_ID);
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, str, ns_id, ipc->GetNumQueuePairsFast(0, flags), pid_, LABSTOR_SERVER_IPC_ID);
         ipc->GetQueuePair(qp, qid);
     }
     inline void GetQueuePairByPidHash(labstor::queue_pair *&qp, labstor_qid_flags_t flags, int pid, int hash) {
-        auto &ipc = pid_to_ipc_[pid];
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, hash, ipc->GetNumQueuePairsFast(0, flags), pid);
+        PerProcessIPC *ipc = GetIPCByPid(pid);
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, hash, ipc->GetNumQueuePairsFast(0, flags), pid, ipc->GetIPCID());
         ipc->GetQueuePair(qp, qid);
     }
     inline void GetQueuePairByHash(labstor::queue_pair *&qp, labstor_qid_flags_t flags, int hash) {
@@ -149,8 +197,13 @@ public:
     inline void GetNextQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags) {
         GetQueuePairByPidHash(qp, flags, pid_, labstor::ThreadLocal::GetTid() + 1);
     }
+    /*Pick a private queue of the given type, i.e., one served by a worker group (see Namespace::GetQueueType).
+     * The flags must be those the queues were created with, e.g., LABSTOR_QP_PRIVATE_DEFAULT.*/
+    inline void GetNextQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags, labstor_qid_type_t type) {
+        GetIPCByID(LABSTOR_SERVER_IPC_ID)->GetQueuePairOfType(qp, type, flags, labstor::ThreadLocal::GetTid() + 1);
+    }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor::ipc::qid_t &qid) {
-        pid_to_ipc_[qid.pid_]->GetQueuePair(qp, qid);
+        GetIPC(qid)->GetQueuePair(qp, qid);
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor::ipc::qtok_t &qtok) {
         GetQueuePair(qp, qtok.qid_);
@@ -158,8 +211,7 @@ public:
 
     template<typename T>
     inline T* AllocRequest(labstor::ipc::qid_t qid, uint32_t size) {
-        auto &ipc = pid_to_ipc_[LABSTOR_GET_QP_IPC_ID(qid)];
-        return ipc->AllocRequest<T>(qid, size);
+        return GetIPC(qid)->AllocRequest<T>(qid, size);
     }
     template<typename T>
     inline T* AllocRequest(labstor::queue_pair *qp, uint32_t size) {
@@ -172,8 +224,7 @@ public:
 
     template<typename T>
     inline void FreeRequest(labstor::ipc::qid_t qid, T *rq) {
-        auto &ipc = pid_to_ipc_[LABSTOR_GET_QP_IPC_ID(qid)];
-        ipc->FreeRequest<T>(qid, rq);
+        GetIPC(qid)->FreeRequest<T>(qid, rq);
     }
     template<typename T>
     inline void FreeRequest(labstor::ipc::qtok_t &qtok, T *rq) {
@@ -193,11 +244,60 @@ public:
         return rq;
     }
 
-    std::unordered_map<uint32_t,PerProcessIPC*>& GetAllIPC() {
-        return pid_to_ipc_;
+    inline uint32_t GetMaxIPCID() {
+        return __atomic_load_n(&max_ipc_id_, __ATOMIC_ACQUIRE);
     }
-    inline PerProcessIPC* GetIPC(int pid) {
-        return pid_to_ipc_[pid];
+    inline PerProcessIPC* GetIPCByID(uint32_t ipc_id) {
+        return __atomic_load_n(&ipcs_[ipc_id % LABSTOR_MAX_IPC_IDS], __ATOMIC_ACQUIRE);
+    }
+    inline PerProcessIPC* FindIPC(labstor::ipc::qid_t &qid) {
+        //The qid lives in memory the client can write, so it must match the process in the slot
+        PerProcessIPC *ipc = GetIPCByID(LABSTOR_GET_QP_IPC_ID(qid));
+        if(!ipc || (uint32_t)ipc->GetPID() != LABSTOR_GET_QP_PID(qid)) {
+            return nullptr;
+        }
+        return ipc;
+    }
+    inline PerProcessIPC* GetIPC(labstor::ipc::qid_t &qid) {
+        PerProcessIPC *ipc = FindIPC(qid);
+        if(!ipc) {
+            throw INVALID_QP_QUERY.format(qid.pid_, qid.type_, qid.flags_, qid.cnt_);
+        }
+        return ipc;
+    }
+    inline PerProcessIPC* GetIPCByPid(int pid) {
+        if(pid == KERNEL_PID) { return GetIPCByID(LABSTOR_KERNEL_IPC_ID); }
+        if(pid == pid_) { return GetIPCByID(LABSTOR_SERVER_IPC_ID); }
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = pid_to_ipc_id_.find(pid);
+        if(iter == pid_to_ipc_id_.end()) {
+            throw INVALID_QP_QUERY.format(pid, 0, 0, 0);
+        }
+        return ipcs_[iter->second];
+    }
+private:
+    void FillSetupReply(labstor::ipc::setup_reply &reply, MemoryConfig &memconf);
+    void CreatePrivateQueuePairs(PerProcessIPC *client_ipc, MemoryConfig &memconf, labstor_qid_type_t type, labstor_qid_flags_t flags, int num_queues);
+    PreparedClientRegion PrepareClientRegion(MemoryConfig &memconf);
+    PreparedClientRegion TakeClientRegion(MemoryConfig &memconf);
+    void FreePreparedClientRegion(PreparedClientRegion &prepared);
+    void LoadMemoryConfig(std::string pid_type, MemoryConfig &config, uint32_t queue_depth);
+    void PublishIPC(PerProcessIPC *ipc, int ipc_id) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if(ipc_id < 0) {
+            for(ipc_id = LABSTOR_SERVER_IPC_ID + 1; ipc_id < LABSTOR_MAX_IPC_IDS; ++ipc_id) {
+                if(!ipcs_[ipc_id]) { break; }
+            }
+            if(ipc_id == LABSTOR_MAX_IPC_IDS) {
+                throw IPC_MANAGER_OUT_OF_IPC_IDS.format(ipc->GetPID(), LABSTOR_MAX_IPC_IDS);
+            }
+        }
+        ipc->ipc_id_ = ipc_id;
+        pid_to_ipc_id_[ipc->GetPID()] = ipc_id;
+        __atomic_store_n(&ipcs_[ipc_id], ipc, __ATOMIC_RELEASE);
+        if((uint32_t)ipc_id >= max_ipc_id_) {
+            __atomic_store_n(&max_ipc_id_, ipc_id + 1, __ATOMIC_RELEASE);
+        }
     }
 };
 
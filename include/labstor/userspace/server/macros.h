@@ -34,6 +34,7 @@
 #define LABSTOR_MODULE_MANAGER_CLASS labstor::Server::ModuleManager
 #define LABSTOR_WORK_ORCHESTRATOR_CLASS labstor::Server::WorkOrchestrator
 #define LABSTOR_NAMESPACE_CLASS labstor::Server::Namespace
+#define LABSTOR_STATE_MANAGER_CLASS labstor::Server::StateManager
 #define LABSTOR_REGISTRAR_CLASS labstor::Registrar::Server
 
 #define LABSTOR_CONFIGURATION_MANAGER_T SINGLETON_T(LABSTOR_CONFIGURATION_MANAGER_CLASS)
@@ -41,6 +42,7 @@
 #define LABSTOR_MODULE_MANAGER_T SINGLETON_T(LABSTOR_MODULE_MANAGER_CLASS)
 #define LABSTOR_WORK_ORCHESTRATOR_T SINGLETON_T(LABSTOR_WORK_ORCHESTRATOR_CLASS)
 #define LABSTOR_NAMESPACE_T SINGLETON_T(LABSTOR_NAMESPACE_CLASS)
+#define LABSTOR_STATE_MANAGER_T SINGLETON_T(LABSTOR_STATE_MANAGER_CLASS)
 #define LABSTOR_REGISTRAR_T SINGLETON_T(LABSTOR_REGISTRAR_CLASS)
 
 #define LABSTOR_CONFIGURATION_MANAGER_SINGLETON scs::Singleton<LABSTOR_CONFIGURATION_MANAGER_CLASS>
@@ -48,6 +50,7 @@
 #define LABSTOR_MODULE_MANAGER_SINGLETON scs::Singleton<LABSTOR_MODULE_MANAGER_CLASS>
 #define LABSTOR_WORK_ORCHESTRATOR_SINGLETON scs::Singleton<LABSTOR_WORK_ORCHESTRATOR_CLASS>
 #define LABSTOR_NAMESPACE_SINGLETON scs::Singleton<LABSTOR_NAMESPACE_CLASS>
+#define LABSTOR_STATE_MANAGER_SINGLETON scs::Singleton<LABSTOR_STATE_MANAGER_CLASS>
 #define LABSTOR_REGISTRAR_SINGLETON scs::Singleton<LABSTOR_REGISTRAR_CLASS>
 
 #define LABSTOR_CONFIGURATION_MANAGER scs::Singleton<LABSTOR_CONFIGURATION_MANAGER_CLASS>::GetInstance()
@@ -55,6 +58,7 @@
 #define LABSTOR_MODULE_MANAGER scs::Singleton<LABSTOR_MODULE_MANAGER_CLASS>::GetInstance()
 #define LABSTOR_WORK_ORCHESTRATOR scs::Singleton<LABSTOR_WORK_ORCHESTRATOR_CLASS>::GetInstance()
 #define LABSTOR_NAMESPACE scs::Singleton<LABSTOR_NAMESPACE_CLASS>::GetInstance()
+#define LABSTOR_STATE_MANAGER scs::Singleton<LABSTOR_STATE_MANAGER_CLASS>::GetInstance()
 #define LABSTOR_REGISTRAR scs::Singleton<LABSTOR_REGISTRAR_CLASS>
 
 #endif //LABSTOR_SERVER_MACROS_H
\ No newline at end of file
@@ -39,15 +39,23 @@ private:
     LABSTOR_CONFIGURATION_MANAGER_T labstor_config_;
     std::unordered_map<labstor::id, labstor::ModulePath> paths_;
     std::set<std::string> repos_;
+    std::mutex load_mutex_;
 public:
     ModuleManager() {
         labstor_config_ = LABSTOR_CONFIGURATION_MANAGER;
     }
     bool LoadRepos();
+    create_module_fn GetModuleConstructor(labstor::id module_id);
+    labstor::Module* UpgradeInstance(labstor::Module *old_instance, labstor::ModuleHandle &module_info);
     void CentralizedUpdateModule(YAML::Node config);
     void DecentralizedUpdateModule(YAML::Node config);
     void AddModulePaths(labstor::id module_id, labstor::ModulePath paths);
     std::string GetModulePath(labstor::id module_id, ModulePathType type);
+private:
+    bool ScanRepo(const std::string &repo_path, YAML::Node &manifest);
+    void AddManifestPaths(const YAML::Node &manifest);
+    void PreloadModules();
+    void LoadModule(labstor::id module_id);
 };
 
 }
@@ -29,6 +29,9 @@
 
 #include <vector>
 #include <queue>
+#include <mutex>
+#include <unordered_map>
+#include <yaml-cpp/yaml.h>
 
 #include <labstor/constants/macros.h>
 #include <labstor/types/basics.h>
@@ -38,25 +41,42 @@
 #include "labstor/types/data_structures/shmem_ring_buffer.h"
 #include <labstor/types/data_structures/unordered_map/shmem_string_map.h>
 #include <labstor/types/data_structures/shmem_string.h>
+#include <labstor/types/data_structures/shmem_route_table.h>
 
 #include "macros.h"
 #include "server.h"
-
-#include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
+#include "ipc_manager.h"
 
 namespace labstor::Server {
 
 class Namespace : public labstor::Namespace {
+private:
+    std::mutex labstack_lock_;
+    std::unordered_map<uint32_t, labstor::ipc::labstack_routes*> labstacks_;
+    std::vector<labstor::ipc::labstack_routes*> retired_routes_;
+    void RestoreMountPoint(const std::string &mount_point, uint32_t mount_ns_id);
 public:
     Namespace();
     void Init();
 
+    /*
+     * Compile the dag of a LabStack whose stages are registered and publish its routes. Remounting
+     * a stack replaces its routes; the prior table is retired until workers have quiesced.
+     * */
+    void MountLabStack(YAML::Node config);
+    /*Retire the routes of the stack mounted at key and stop resolving paths beneath its mount point*/
+    void UnmountLabStack(labstor::ipc::string key, uint32_t mount_ns_id);
+    /*Take the retired tables. The caller frees them with FreeRoutes after a quiescent point.*/
+    std::vector<labstor::ipc::labstack_routes*> TakeRetiredRoutes();
+    void FreeRoutes(std::vector<labstor::ipc::labstack_routes*> &routes);
+
     ~Namespace() {
-        LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC;
+        labstor::ShmemProvider *shmem = LABSTOR_IPC_MANAGER->GetShmem();
         if(shmem_alloc_) { delete shmem_alloc_; }
-        for(auto module : private_state_) {
-            delete module;
+        for(uint32_t ns_id = 0; ns_id < private_state_.GetSize(); ++ns_id) {
+            delete private_state_.Get(ns_id);
         }
+        labstor_set_clock_page(nullptr);
         shmem->FreeShmem(region_id_);
     }
 };
@@ -32,6 +32,7 @@
 #include <labstor/userspace/util/errors.h>
 #include <labstor/userspace/types/queue_pool.h>
 #include <vector>
+#include <atomic>
 #include "labstor/userspace/types/memory_manager.h"
 
 namespace labstor::Server {
@@ -39,18 +40,26 @@ struct PerProcessIPC : public QueuePool, public MemoryManager {
     UnixSocket clisock_;
     labstor::credentials creds_;
     int region_id_;
+    uint16_t ipc_id_;
+    std::atomic<bool> is_setup_;
 
-    PerProcessIPC(int pid) {
+    PerProcessIPC(int pid) : ipc_id_(0), is_setup_(false) {
         creds_.pid_ = pid;
     }
 
-    PerProcessIPC(int fd, labstor::credentials creds) : clisock_(fd), creds_(creds) {}
+    PerProcessIPC(int fd, labstor::credentials creds) : clisock_(fd), creds_(creds), ipc_id_(0), is_setup_(false) {}
 
     inline UnixSocket &GetSocket() { return clisock_; };
 
     inline void *GetRegion() { return MemoryManager::GetRegion(LABSTOR_QP_SHMEM); }
 
     inline int GetPID() { return creds_.pid_; }
+
+    inline uint16_t GetIPCID() { return ipc_id_; }
+
+    //Admin requests are only served by the wreaper once the initial handshake is over
+    inline void MarkSetup() { is_setup_.store(true, std::memory_order_release); }
+    inline bool IsSetup() { return is_setup_.load(std::memory_order_acquire); }
 };
 }
 
@@ -0,0 +1,64 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_PREPARE_THREAD_H
+#define LABSTOR_PREPARE_THREAD_H
+
+#include <labstor/userspace/util/errors.h>
+#include <labstor/types/daemon.h>
+#include <labstor/userspace/server/ipc_manager.h>
+
+namespace labstor::Server {
+
+/*
+ * Refills the pool of prepared client regions. Connecting clients only request a refill,
+ * so creating and initializing the replacement region stays off the accept thread.
+ * */
+class PrepareWorker : public DaemonWorker {
+private:
+    LABSTOR_IPC_MANAGER_T ipc_manager_;
+    int timeout_ms_;
+public:
+    PrepareWorker() {
+        ipc_manager_ = LABSTOR_IPC_MANAGER;
+        timeout_ms_ = 1000;
+    }
+
+    void DoWork() override {
+        if(!ipc_manager_->WaitForClientRegionRequest(timeout_ms_)) {
+            return;
+        }
+        LABSTOR_ERROR_HANDLE_TRY {
+            ipc_manager_->PrepareClientRegions();
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            LABSTOR_ERROR_PTR->print();
+        }
+    }
+};
+
+}
+
+#endif //LABSTOR_PREPARE_THREAD_H
@@ -42,6 +42,15 @@ struct ConfigurationManager {
     void LoadConfig(char *path) {
         config_ = YAML::LoadFile(path);
     }
+    //The userspace-only profile runs without the LabStor kernel modules: no kernel workers,
+    //no kernel queues, and memfd-backed shared memory
+    bool IsUserspaceOnly() {
+        return config_["profile"] && config_["profile"].as<std::string>() == "userspace-only";
+    }
+    //Values left out or set to "auto" are derived from the machine's topology at startup
+    bool IsAutoTuned() {
+        return config_["auto_tune"] && config_["auto_tune"]["enabled"] && config_["auto_tune"]["enabled"].as<bool>();
+    }
 };
 
 }
@@ -0,0 +1,176 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_STATE_MANAGER_H
+#define LABSTOR_SERVER_STATE_MANAGER_H
+
+#include <labstor/userspace/util/errors.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace labstor::Server {
+
+/*
+ * A named region of module state owned by the runtime rather than by a module instance.
+ * version_ describes the layout of data_. It is chosen by the module and must change whenever the layout does.
+ * */
+struct module_state {
+    void *data_;
+    size_t size_;
+    uint32_t version_;
+};
+
+/*Copy or convert the state in old_state into new_state, which is zeroed and sized for the new layout*/
+typedef void (*module_state_migrate_fn)(module_state &old_state, module_state &new_state);
+
+/*A region that was replaced by a new layout while an upgrade of ns_id_ is in progress*/
+struct replaced_module_state {
+    uint32_t ns_id_;
+    std::string key_;
+    module_state old_state_;
+    module_state new_state_;
+};
+
+/*
+ * Modules keep bulk state (e.g., cache indexes, inode tables, free lists) in regions allocated here,
+ * keyed by (ns_id, name). When an instance is replaced during an upgrade, the new instance attaches
+ * to the same regions in StateUpdate. If the layout version is unchanged, it gets the same memory
+ * back without a copy, so upgrade time does not grow with the size of the state. Only a changed
+ * layout calls the module's migration function. Regions outlive instances, so a module must not
+ * free them in its destructor.
+ * A region replaced by a new layout stays mapped for the old instance until the upgrade either
+ * publishes the new instance (Commit) or falls back to the old one (Rollback).
+ * */
+class StateManager {
+private:
+    std::mutex lock_;
+    std::unordered_map<std::string, module_state> states_;
+    std::vector<replaced_module_state> replaced_;
+public:
+    StateManager() = default;
+    ~StateManager() {
+        for(auto &state : states_) {
+            munmap(state.second.data_, state.second.size_);
+        }
+        for(auto &replaced : replaced_) {
+            munmap(replaced.old_state_.data_, replaced.old_state_.size_);
+        }
+    }
+
+    /*
+     * Get the region (ns_id, name) with the given layout version and at least size bytes.
+     * A new region is zero-filled. Returns true if the region already existed.
+     * */
+    bool Attach(uint32_t ns_id, const std::string &name, size_t size, uint32_t version,
+                module_state &state, module_state_migrate_fn migrate = nullptr) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string key = GetKey(ns_id, name);
+        auto iter = states_.find(key);
+        if(iter == states_.end()) {
+            state = Allocate(size, version);
+            states_.emplace(key, state);
+            return false;
+        }
+        module_state &old_state = iter->second;
+        if(old_state.version_ == version && old_state.size_ >= size) {
+            state = old_state;
+            return true;
+        }
+        if(old_state.version_ != version && migrate == nullptr) {
+            throw STATE_LAYOUT_MISMATCH.format(name, ns_id, old_state.version_, version);
+        }
+        state = Allocate(size, version);
+        if(old_state.version_ != version) {
+            migrate(old_state, state);
+        } else {
+            memcpy(state.data_, old_state.data_, old_state.size_);
+        }
+        replaced_.emplace_back(replaced_module_state{ns_id, key, old_state, state});
+        old_state = state;
+        return true;
+    }
+
+    /*The new instance of ns_id was published, so the regions its predecessor used are freed*/
+    void Commit(uint32_t ns_id) {
+        std::lock_guard<std::mutex> lock(lock_);
+        for(size_t i = 0; i < replaced_.size();) {
+            if(replaced_[i].ns_id_ != ns_id) {
+                ++i;
+                continue;
+            }
+            munmap(replaced_[i].old_state_.data_, replaced_[i].old_state_.size_);
+            replaced_.erase(replaced_.begin() + i);
+        }
+    }
+
+    /*The upgrade of ns_id failed, so the old instance gets its regions back and the new ones are freed*/
+    void Rollback(uint32_t ns_id) {
+        std::lock_guard<std::mutex> lock(lock_);
+        for(size_t i = replaced_.size(); i-- > 0;) {
+            replaced_module_state &replaced = replaced_[i];
+            if(replaced.ns_id_ != ns_id) { continue; }
+            munmap(replaced.new_state_.data_, replaced.new_state_.size_);
+            states_[replaced.key_] = replaced.old_state_;
+            replaced_.erase(replaced_.begin() + i);
+        }
+    }
+
+    /*Free a region once no instance of ns_id will use it again*/
+    void Release(uint32_t ns_id, const std::string &name) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = states_.find(GetKey(ns_id, name));
+        if(iter == states_.end()) { return; }
+        munmap(iter->second.data_, iter->second.size_);
+        states_.erase(iter);
+    }
+
+private:
+    static std::string GetKey(uint32_t ns_id, const std::string &name) {
+        return std::to_string(ns_id) + ":" + name;
+    }
+
+    static module_state Allocate(size_t size, uint32_t version) {
+        module_state state;
+        size_t page_size = getpagesize();
+        state.size_ = (size + page_size - 1) / page_size * page_size;
+        if(state.size_ == 0) { state.size_ = page_size; }
+        state.data_ = mmap(nullptr, state.size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(state.data_ == MAP_FAILED) {
+            throw MMAP_FAILED.format(strerror(errno));
+        }
+        state.version_ = version;
+        return state;
+    }
+};
+
+}
+
+#endif //LABSTOR_SERVER_STATE_MANAGER_H
@@ -32,44 +32,65 @@
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/types/messages.h>
 #include <labstor/userspace/server/module_manager.h>
-#include <labstor/userspace/util/timer.h>
+#include <labstor/userspace/server/work_orchestrator.h>
+#include <labstor/userspace/server/namespace.h>
 
 namespace labstor::Server {
 
+/*
+ * Applies upgrades as soon as the registrar queues them. The thread sleeps on the module
+ * manager's upgrade queue rather than polling, and wakes periodically only so it can be stopped
+ * and so routing tables replaced by remounts are returned to the pool.
+ * */
 class UpgradeWorker : public DaemonWorker {
 private:
-    LABSTOR_IPC_MANAGER_T ipc_manager_;
     LABSTOR_MODULE_MANAGER_T module_manager_;
-    labstor::HighResMonotonicTimer t_;
-    int sec_;
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_;
+    LABSTOR_NAMESPACE_T namespace_;
+    int timeout_ms_;
 public:
     UpgradeWorker() {
-        ipc_manager_ = LABSTOR_IPC_MANAGER;
         module_manager_ = LABSTOR_MODULE_MANAGER;
-        sec_ = 5;
-        t_.Resume();
+        work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+        namespace_ = LABSTOR_NAMESPACE;
+        timeout_ms_ = 1000;
     }
 
     void DoWork() override {
-        t_.Pause();
-        if(t_.GetSec() >= sec_) {
-            for(auto &upgrade : module_manager_->GetUpgrades()) {
-                YAML::Node config = YAML::LoadFile(upgrade->yaml_path_);
-                if(config["code_update"]) {
-                    std::string update_type = config["code_update"].as<std::string>();
-                    std::string labmod_uuid = config["labmod_uuid"].as<std::string>();
-                    if(config["code_update"]["centralized"]) {
-                        module_manager_->CentralizedUpdateModule(config);
-                    }
-                    if(config["code_update"]["decentralized"]) {
-                        module_manager_->DecentralizedUpdateModule(config);
-                    }
-                }
+        std::string yaml_path;
+        if(module_manager_->WaitForUpgrade(yaml_path, timeout_ms_)) {
+            Upgrade(yaml_path);
+        }
+        ReclaimRoutes();
+    }
+
+private:
+    void Upgrade(const std::string &yaml_path) {
+        LABSTOR_ERROR_HANDLE_TRY {
+            YAML::Node config = YAML::LoadFile(yaml_path);
+            if(config["code_upgrade"] && config["code_upgrade"]["decentralized"]) {
+                module_manager_->DecentralizedUpdateModule(config);
+            } else {
+                module_manager_->CentralizedUpdateModule(config);
             }
-            t_.Reset();
+            //A modified stack may also have changed its edges
+            if(config["mount_point"] && config["dag"]) {
+                namespace_->MountLabStack(config);
+            }
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            LABSTOR_ERROR_PTR->print();
+        } catch(YAML::Exception &e) {
+            printf("Failed to load upgrade %s: %s\n", yaml_path.c_str(), e.what());
+        }
+    }
+
+    void ReclaimRoutes() {
+        std::vector<labstor::ipc::labstack_routes*> retired = namespace_->TakeRetiredRoutes();
+        if(retired.empty()) {
+            return;
         }
-        t_.Resume();
-        sched_yield();
+        work_orchestrator_->WaitForQuiescence();
+        namespace_->FreeRoutes(retired);
     }
 };
 
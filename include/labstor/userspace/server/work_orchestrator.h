@@ -29,20 +29,35 @@
 
 #include <sys/sysinfo.h>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
+#include <string>
 
 #include <labstor/userspace/server/worker.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 
 namespace labstor::Server {
 
+/*
+ * Workers configured with a group only serve the queue pairs of that group. Each group owns a queue
+ * pair type in the server's private queues; group i has type i + 1 and type 0 is the shared pool.
+ * */
+struct WorkerGroup {
+    std::string name_;
+    labstor_qid_type_t qp_type_;
+    std::vector<int> workers_;
+};
+
 class WorkOrchestrator {
 private:
     int pid_;
     int n_cpu_;
+    std::mutex lock_;
     pthread_t mapper_;
     std::unordered_map<pid_t, std::vector<std::shared_ptr<labstor::Daemon>>> worker_pool_;
+    std::vector<int> general_workers_, latency_workers_, throughput_workers_;
+    std::vector<WorkerGroup> worker_groups_;
     std::shared_ptr<labstor::Daemon> work_balancer_;
 public:
     WorkOrchestrator() {
@@ -54,6 +69,21 @@ public:
     inline int GetNumCPU() { return n_cpu_; }
     void CreateWorkers();
     void AssignQueuePair(labstor::ipc::shmem_queue_pair *qp, int worker_id=-1);
+    /*
+     * Detach queue pairs from their workers. Pending requests taken from them fail and suspended handlers
+     * which refer to them are cancelled. On return no worker refers to them, so they may be freed.
+     * */
+    void RemoveQueuePairs(int pid);
+    void RemoveQueuePair(labstor::ipc::shmem_queue_pair *qp);
+    void WaitForQuiescence();
+    uint32_t TakeClientHighWaterMark();
+    /*Requests of ns_id which every worker together ran past their deadline*/
+    uint64_t GetNumMissedDeadlines(uint32_t ns_id);
+    inline std::vector<WorkerGroup>& GetWorkerGroups() { return worker_groups_; }
+    labstor_qid_type_t GetWorkerGroupType(const std::string &name);
+private:
+    std::vector<int>& GetWorkerGroup(labstor_qid_flags_t flags);
+    void AddToWorkerGroup(const std::string &name, int worker_id);
 };
 
 }
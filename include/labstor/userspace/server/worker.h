@@ -30,45 +30,191 @@
 #ifdef __cplusplus
 
 #include <thread>
+#include <algorithm>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
 #include <labstor/userspace/util/errors.h>
 #include <labstor/userspace/server/macros.h>
 #include <labstor/userspace/server/namespace.h>
 #include <labstor/types/daemon.h>
+#include <labstor/userspace/types/request_frame.h>
+#include <labstor/userspace/server/deadline_queue.h>
 #include "labstor/types/data_structures/c/shmem_work_queue_secure.h"
 
+//A batch's late requests are tracked in a 64-bit mask
+#define LABSTOR_WORKER_MAX_BATCH 64
+
 namespace labstor::Server {
 
+/*
+ * kGeneral workers poll every queue they are assigned.
+ * kLatency workers only serve LOW_LATENCY queues. They never yield the CPU and take
+ * at most one request from a queue per pass so that no queue waits behind another.
+ * kThroughput workers serve BATCH and HIGH_LATENCY queues, draining each queue completely
+ * and yielding the CPU when there is no work.
+ *
+ * Requests from UNORDERED queues are moved into a per-worker deadline queue and
+ * executed earliest-deadline-first. Requests from ordered queues execute in FIFO order,
+ * and up to max_batch consecutive requests for the same ns_id are handed to the module at once.
+ * */
+enum class WorkerRole {
+    kGeneral,
+    kLatency,
+    kThroughput
+};
+
 class Worker : public DaemonWorker {
 private:
-    LABSTOR_NAMESPACE_T namespace_;
+    labstor::Namespace *namespace_;
     void *region_;
     uint32_t id_;
+    WorkerRole role_;
     labstor::ipc::work_queue_secure work_queue_;
+    labstor::request_scheduler scheduler_;
+    deadline_queue edf_;
+    std::vector<deadline_request> edf_retry_;
+    std::atomic<uint64_t> epoch_;
+    std::atomic<uint64_t> missed_deadlines_;
+    std::unique_ptr<std::atomic<uint64_t>[]> missed_deadlines_by_ns_;
+    uint32_t max_ns_ids_;
+    std::atomic<uint32_t> client_hwm_;
+    std::atomic<bool> flush_pending_;
+    labstor::queue_pair *flush_qp_;
+    int flush_pid_;
+    uint32_t cache_gen_;
+    int pid_;
 
-    labstor_queue_pair *qp_struct;
-    labstor::queue_pair *qp;
+    labstor_work_queue_secure_entry *entry;
     labstor::ipc::request *rq;
     labstor::credentials *creds;
     labstor::Module *module;
     uint32_t work_queue_depth, qp_depth;
+    uint32_t max_batch_;
+    labstor::ipc::request *batch_[LABSTOR_WORKER_MAX_BATCH];
     labstor::HighResCpuTimer t;
 public:
-    Worker(uint32_t depth, uint32_t id) {
-        namespace_ = LABSTOR_NAMESPACE;
+    /*ns defaults to the server's namespace*/
+    Worker(uint32_t depth, uint32_t id, WorkerRole role = WorkerRole::kGeneral, uint32_t max_batch = 1,
+           labstor::Namespace *ns = nullptr) {
+        namespace_ = ns ? ns : LABSTOR_NAMESPACE;
         id_ = id;
+        role_ = role;
+        max_batch_ = std::max(1u, std::min(max_batch, (uint32_t)LABSTOR_WORKER_MAX_BATCH));
+        epoch_ = 0;
+        missed_deadlines_ = 0;
+        max_ns_ids_ = namespace_->GetCapacity();
+        missed_deadlines_by_ns_ = std::make_unique<std::atomic<uint64_t>[]>(max_ns_ids_);
+        for(uint32_t i = 0; i < max_ns_ids_; ++i) {
+            missed_deadlines_by_ns_[i].store(0, std::memory_order_relaxed);
+        }
+        client_hwm_ = 0;
+        flush_pending_ = false;
+        flush_qp_ = nullptr;
+        flush_pid_ = -1;
+        pid_ = getpid();
+        cache_gen_ = namespace_->GetGeneration();
         uint32_t region_size = labstor::ipc::work_queue_secure::GetSize(depth);
         region_ = malloc(region_size);
         work_queue_.Init(region_, region_size, depth);
+        scheduler_.Init(FreeSubRequest);
+        edf_.Init();
     }
-    void AssignQP(labstor_queue_pair *qp, labstor::credentials *creds) {
-        if(!work_queue_.Enqueue(qp, creds)) {
+    void AssignQP(labstor::ipc::shmem_queue_pair *qp, labstor::credentials *creds) {
+        if(!work_queue_.Enqueue(qp, creds, qp)) {
             throw FAILED_TO_ASSIGN_QUEUE.format(qp->GetQID().pid_, id_);
         }
     }
+    uint32_t RemoveQPs(uint32_t pid) {
+        return work_queue_.RemoveByPID(pid);
+    }
+    bool RemoveQP(labstor::ipc::shmem_queue_pair *qp) {
+        return work_queue_.Remove(qp);
+    }
+    void WaitForQuiescence() {
+        //Any pass that could have seen a removed QP ends before the epoch moves again
+        uint64_t epoch = epoch_.load(std::memory_order_acquire);
+        while(epoch_.load(std::memory_order_acquire) == epoch) {
+            LABSTOR_YIELD();
+        }
+    }
+    /*
+     * Fail the deadline-queue entries and cancel the suspended handlers that refer to qp (or, if qp is null,
+     * to any queue of pid) so that the queue can be freed. Blocks until the worker has done so at the start
+     * of its next pass, which also means it has quiesced.
+     * */
+    void FlushQueuePairs(labstor::queue_pair *qp, int pid = -1) {
+        flush_qp_ = qp;
+        flush_pid_ = pid;
+        flush_pending_.store(true, std::memory_order_release);
+        while(flush_pending_.load(std::memory_order_acquire)) {
+            LABSTOR_YIELD();
+        }
+    }
     uint32_t GetQueueDepth() {
         return work_queue_.GetDepth();
     }
+    inline uint64_t GetNumMissedDeadlines() {
+        return missed_deadlines_.load(std::memory_order_relaxed);
+    }
+    inline uint64_t GetNumMissedDeadlines(uint32_t ns_id) {
+        if(ns_id >= max_ns_ids_) { return 0; }
+        return missed_deadlines_by_ns_[ns_id].load(std::memory_order_relaxed);
+    }
+    /*The most requests seen pending in one client queue since the last call*/
+    inline uint32_t TakeClientHighWaterMark() {
+        return client_hwm_.exchange(0, std::memory_order_relaxed);
+    }
+    inline WorkerRole GetRole() {
+        return role_;
+    }
+    static WorkerRole GetRoleFromString(const std::string &role) {
+        if(role == "latency") { return WorkerRole::kLatency; }
+        if(role == "throughput") { return WorkerRole::kThroughput; }
+        if(role == "general") { return WorkerRole::kGeneral; }
+        throw INVALID_WORKER_ROLE.format(role);
+    }
     void DoWork();
+private:
+    //Instantiated for the concrete queue type so queue operations inline
+    template<typename QP>
+    bool ProcessQueue(QP *qp);
+    template<typename QP>
+    bool DrainQueue(QP *qp);
+    template<typename QP>
+    inline void TrackHighWaterMark(QP *qp) {
+        if (qp_depth > client_hwm_.load(std::memory_order_relaxed) && qp->GetQID().pid_ != (uint32_t)pid_) {
+            client_hwm_.store(qp_depth, std::memory_order_relaxed);
+        }
+    }
+    bool ProcessDeadlineQueue();
+    void FlushRemovedQueuePairs();
+    static void FreeSubRequest(labstor::queue_pair *qp, labstor::ipc::request *rq);
+    /*
+     * Only requests the module completed count as missed. Whether a request is late is sampled before its
+     * handler runs, since the client may reuse a completed request right away.
+     * */
+    inline void CountMissedDeadlines(uint32_t ns_id, uint32_t num_late) {
+        if(num_late) {
+            missed_deadlines_.fetch_add(num_late, std::memory_order_relaxed);
+            if(ns_id < max_ns_ids_) {
+                missed_deadlines_by_ns_[ns_id].fetch_add(num_late, std::memory_order_relaxed);
+            }
+            TRACEPOINT("Missed deadlines", ns_id, num_late)
+        }
+    }
+    inline labstor::Module* GetModule(labstor_work_queue_secure_entry *qp_entry, uint32_t ns_id) {
+        uint32_t slot = ns_id % LABSTOR_WORK_QUEUE_MODULE_CACHE;
+        if(qp_entry->ns_ids_[slot] == ns_id) {
+            return reinterpret_cast<labstor::Module*>(qp_entry->modules_[slot]);
+        }
+        labstor::Module *ns_module = namespace_->GetModule(ns_id);
+        if(ns_module) {
+            qp_entry->ns_ids_[slot] = ns_id;
+            qp_entry->modules_[slot] = ns_module;
+        }
+        return ns_module;
+    }
 };
 
 }
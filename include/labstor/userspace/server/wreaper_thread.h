@@ -30,6 +30,7 @@
 #include <labstor/userspace/util/errors.h>
 #include <labstor/types/daemon.h>
 #include <labstor/userspace/server/ipc_manager.h>
+#include <labstor/userspace/server/work_orchestrator.h>
 #include <labstor/userspace/types/messages.h>
 
 namespace labstor::Server {
@@ -37,28 +38,56 @@ namespace labstor::Server {
 class WreaperWorker : public DaemonWorker {
 private:
     LABSTOR_IPC_MANAGER_T ipc_manager_;
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_;
 public:
     WreaperWorker() {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
+        work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
     }
 
     void DoWork() override {
-        int op;
-        auto &ipcs = ipc_manager_->GetAllIPC();
-        for(auto iter = ipcs.begin(); iter != ipcs.end();) {
+        uint32_t max_ipc_id = ipc_manager_->GetMaxIPCID();
+        for(uint32_t ipc_id = LABSTOR_SERVER_IPC_ID + 1; ipc_id < max_ipc_id; ++ipc_id) {
+            PerProcessIPC *ipc = ipc_manager_->GetIPCByID(ipc_id);
+            //RegisterClient owns an IPC until its handshake completes, including tearing it down on failure
+            if(!ipc || !ipc->IsSetup()) {
+                continue;
+            }
             LABSTOR_ERROR_HANDLE_TRY {
                 labstor::ipc::admin_request header;
-                PerProcessIPC *ipc = iter->second;
-                if(ipc->GetPID() == ipc_manager_->GetPID()) { continue; }
-                if(ipc->GetPID() == 0) { continue; }
-                if(!ipc->GetSocket().RecvMSGPeek(&header, sizeof(header), false)) {
-                    continue;
+                if(ipc->GetSocket().RecvMSGPeek(&header, sizeof(header), false)) {
+                    ProcessAdminRequest(ipc, header);
                 }
-                ++iter;
             } LABSTOR_ERROR_HANDLE_CATCH {
-                printf("PID %d disconnected\n", iter->first);
-                delete iter->second;
-                iter = ipcs.erase(iter);
+                printf("PID %d disconnected\n", ipc->GetPID());
+                //Workers must stop polling the QPs before they are freed
+                work_orchestrator_->RemoveQueuePairs(ipc->GetPID());
+                //Workers may still hold the IPC from a qid lookup until their next pass
+                ipc_manager_->UnregisterIPC(ipc);
+                work_orchestrator_->WaitForQuiescence();
+                ipc_manager_->FreeClientRegion(ipc);
+                delete ipc;
+            }
+        }
+    }
+
+private:
+    void ProcessAdminRequest(PerProcessIPC *ipc, labstor::ipc::admin_request &header) {
+        AUTO_TRACE(ipc->GetPID(), header.op_)
+        switch(header.op_) {
+            case labstor::ipc::LABSTOR_ADMIN_REGISTER_QP: {
+                ipc_manager_->RegisterClientQP(ipc);
+                break;
+            }
+            case labstor::ipc::LABSTOR_ADMIN_UNREGISTER_QP: {
+                ipc_manager_->UnregisterClientQP(ipc);
+                break;
+            }
+            default: {
+                //Drop the header so the socket does not stall on it
+                ipc->GetSocket().RecvMSG(&header, sizeof(header));
+                TRACEPOINT("Invalid admin request", header.op_)
+                break;
             }
         }
     }
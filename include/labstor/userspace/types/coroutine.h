@@ -0,0 +1,210 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_COROUTINE_H
+#define LABSTOR_COROUTINE_H
+
+/*
+ * Coroutine-style request handlers for server modules.
+ * The runtime itself is built as C++17; a module that includes this header must be compiled
+ * with C++20 (set(CMAKE_CXX_STANDARD 20) in the module's CMakeLists.txt).
+ * */
+
+#if !defined(__cpp_impl_coroutine)
+#error "labstor/userspace/types/coroutine.h requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <labstor/userspace/util/error.h>
+#include <labstor/userspace/types/request_frame.h>
+#ifdef LABSTOR_SERVER
+#include <labstor/userspace/types/module.h>
+#endif
+
+namespace labstor {
+
+class request_task {
+public:
+    struct promise_type {
+        request_task get_return_object() {
+            return request_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        //Keep the frame alive after completion so its owner can check done() and destroy it
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        //The frame still reaches final_suspend; its owner reports the exception and fails the request
+        void unhandled_exception() { exception_ = std::current_exception(); }
+        std::exception_ptr exception_;
+
+        //Frames come from the pool of the worker running the handler. The owning scheduler is stored in a
+        //header sized so that the frame keeps the alignment operator new guarantees.
+        static constexpr size_t kHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+        static_assert(sizeof(request_scheduler*) <= kHeaderSize);
+        static_assert(LABSTOR_REQUEST_FRAME_SIZE % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0);
+
+        static void* operator new(size_t size) {
+            request_scheduler *scheduler = request_scheduler::GetCurrent();
+            size += kHeaderSize;
+            void *header = scheduler ? scheduler->GetPool().Alloc(size) : malloc(size);
+            *reinterpret_cast<request_scheduler**>(header) = scheduler;
+            return reinterpret_cast<char*>(header) + kHeaderSize;
+        }
+        static void operator delete(void *ptr) {
+            void *header = reinterpret_cast<char*>(ptr) - kHeaderSize;
+            request_scheduler *scheduler = *reinterpret_cast<request_scheduler**>(header);
+            if(scheduler) {
+                scheduler->GetPool().Free(header);
+            } else {
+                free(header);
+            }
+        }
+    };
+
+    explicit request_task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    request_task(const request_task&) = delete;
+    request_task(request_task &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+
+    inline std::coroutine_handle<promise_type> Release() {
+        std::coroutine_handle<promise_type> handle = handle_;
+        handle_ = nullptr;
+        return handle;
+    }
+
+    static bool Resume(void *frame) {
+        std::coroutine_handle<> handle = std::coroutine_handle<>::from_address(frame);
+        handle.resume();
+        return handle.done();
+    }
+    static void Destroy(void *frame) {
+        std::coroutine_handle<>::from_address(frame).destroy();
+    }
+    /*Whether a finished handler ended with an exception. The exception is printed.*/
+    static bool Failed(void *frame) {
+        std::exception_ptr exception = std::coroutine_handle<promise_type>::from_address(frame).promise().exception_;
+        if(!exception) {
+            return false;
+        }
+        LABSTOR_ERROR_HANDLE_TRY {
+            std::rethrow_exception(exception);
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            LABSTOR_ERROR_PTR->print();
+        } catch(std::exception &e) {
+            printf("Request handler failed: %s\n", e.what());
+        } catch(...) {
+            printf("Request handler failed\n");
+        }
+        return true;
+    }
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/*
+ * co_await labstor::await_qtok<T>(qp, qtok) suspends the handler until the request
+ * identified by qtok completes on qp, and evaluates to the completed request.
+ * */
+template<typename T=labstor::ipc::request>
+class await_qtok {
+private:
+    labstor::queue_pair *qp_;
+    labstor_req_id_t req_id_;
+    labstor::ipc::request *rq_;
+public:
+    await_qtok(labstor::queue_pair *qp, labstor::ipc::qtok_t &qtok) : qp_(qp), req_id_(qtok.req_id_), rq_(nullptr) {}
+
+    bool await_ready() {
+        return qp_->IsComplete(req_id_, rq_);
+    }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        request_scheduler *scheduler = request_scheduler::GetCurrent();
+        if(!scheduler) {
+            //Not running on a worker, nothing will resume the frame
+            rq_ = qp_->Wait<labstor::ipc::request>(req_id_);
+            return false;
+        }
+        suspended_request req;
+        req.frame_ = handle.address();
+        req.resume_ = request_task::Resume;
+        req.destroy_ = request_task::Destroy;
+        req.failed_ = request_task::Failed;
+        req.await_qp_ = qp_;
+        req.await_req_id_ = req_id_;
+        req.result_ = &rq_;
+        scheduler->Suspend(req);
+        return true;
+    }
+    T* await_resume() {
+        return reinterpret_cast<T*>(rq_);
+    }
+};
+
+#ifdef LABSTOR_SERVER
+/*
+ * A server module whose handler is a coroutine. The worker dequeues a request as soon as its handler
+ * suspends and continues with the rest of the queue. The handler is resumed once the awaited request completes
+ * and must Complete() the original request before returning, as a regular ProcessRequest would.
+ * Suspended handlers are counted in num_suspended_, so the module is not retired while any are pending.
+ * If a handler is cancelled, or throws before completing the original request, its frame is destroyed and the
+ * original request is completed with LABSTOR_REQUEST_FAILED.
+ * */
+class CoroutineModule : public Module {
+public:
+    CoroutineModule(labstor::id module_id) : Module(module_id) {}
+
+    virtual request_task ProcessRequestAsync(
+            labstor::queue_pair *qp,
+            labstor::ipc::request *request,
+            labstor::credentials *creds) = 0;
+
+    bool ProcessRequest(
+            labstor::queue_pair *qp,
+            labstor::ipc::request *request,
+            labstor::credentials *creds) final {
+        request_scheduler *scheduler = request_scheduler::GetCurrent();
+        if(scheduler) {
+            scheduler->SetOrigin(request_origin{qp, request, GetNamespaceID(), &num_suspended_});
+        }
+        std::coroutine_handle<request_task::promise_type> handle = ProcessRequestAsync(qp, request, creds).Release();
+        if(scheduler) {
+            scheduler->SetOrigin(request_origin());
+        }
+        if(handle.done()) {
+            if(request_task::Failed(handle.address())) {
+                request->SetCode(LABSTOR_REQUEST_FAILED);
+                qp->Complete(request);
+            }
+            handle.destroy();
+        }
+        return true;
+    }
+};
+#endif
+
+}
+
+#endif //LABSTOR_COROUTINE_H
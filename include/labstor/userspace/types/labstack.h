@@ -31,29 +31,36 @@
 #include <yaml-cpp/yaml.h>
 #include "labmods/registrar/client/registrar_client.h"
 #include "labstor/userspace/client/namespace.h"
+#include "labstor/userspace/types/labstack_dag.h"
 
 namespace labstor {
 
 class LabStack {
 public:
+    /*
+     * Register every stage the DAG needs, sinks first, then have the runtime compile and
+     * publish the stack's routes. An invalid DAG is rejected before anything is registered.
+     * */
     void MountLabStack(char *path) {
         YAML::Node config = YAML::LoadFile(path);
         std::string labstack_id = config["mount_point"].as<std::string>();
-        std::list<YAML::Node> dag;
-        for(auto vertex : config["dag"]) {
-            dag.emplace_front(vertex);
-        }
-        for(auto vertex : dag) {
-            std::string labmod_uuid = vertex["labmod_uuid"].as<std::string>();
-            labstor::Module *module = LABSTOR_NAMESPACE->LoadClientModule<labstor::Module>(labmod_uuid);
+        labstor::LabStackDAG dag;
+        dag.Compile(config);
+        auto &stages = dag.GetStages();
+        for(auto stage = stages.rbegin(); stage != stages.rend(); ++stage) {
+            labstor::Module *module = LABSTOR_NAMESPACE->LoadClientModule<labstor::Module>(stage->key_);
             if(module == nullptr) {
-                module->Register(vertex);
+                module = LABSTOR_MODULE_MANAGER->GetModuleConstructor(labstor::id(stage->labmod_))();
+                module->Register(stage->config_);
             }
         }
-        LABSTOR_REGISTRAR->MountLabStack(labstack_id, path);
+        if(LABSTOR_REGISTRAR->MountLabStack(labstack_id, path) != LABSTOR_REQUEST_SUCCESS) {
+            throw LABSTACK_INVALID.format(labstack_id, "the runtime could not compile its routes");
+        }
     }
     void UnmountLabStack(char *path) {
-        LABSTOR_REGISTRAR->PushUpgrade(path);
+        YAML::Node config = YAML::LoadFile(path);
+        LABSTOR_REGISTRAR->UnmountLabStack(config["mount_point"].as<std::string>(), path);
     }
     void ModifyLabStack(char *path) {
         LABSTOR_REGISTRAR->PushUpgrade(path);
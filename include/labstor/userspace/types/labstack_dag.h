@@ -0,0 +1,239 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_LABSTACK_DAG_H
+#define LABSTOR_LABSTACK_DAG_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <yaml-cpp/yaml.h>
+
+#include <labstor/constants/constants.h>
+#include <labstor/userspace/util/errors.h>
+#include <labstor/types/data_structures/c/shmem_queue_pair.h>
+#include <labstor/types/data_structures/shmem_route_table.h>
+
+namespace labstor {
+
+struct labstack_vertex {
+    std::string key_;
+    std::string labmod_;
+    std::string worker_group_;
+    std::vector<std::string> next_;
+    std::vector<int> succ_;
+    uint32_t num_prev_;
+    uint32_t qp_flags_;
+    YAML::Node config_;
+};
+
+/*
+ * Validates the "dag" of a LabStack YAML and orders its stages.
+ *
+ * A vertex's "next" is either a key or a list of keys (fan-out). Keys which are not vertices of the
+ * DAG must name modules which are already registered; they are checked when the routes are built.
+ * The optional "queue" hint (latency or throughput) and "unordered" flag select the class of queue
+ * a stage prefers, and "worker_group" pins the stage to the server workers of that group. Stages are stored in topological order, so registering them in reverse creates
+ * every stage after the stages it forwards to.
+ * */
+class LabStackDAG {
+private:
+    std::string mount_point_;
+    std::vector<labstack_vertex> stages_;
+    uint32_t entry_;
+public:
+    LabStackDAG() : entry_(0) {}
+
+    void Compile(YAML::Node config) {
+        std::vector<labstack_vertex> vertices;
+        std::unordered_map<std::string, int> index;
+        mount_point_ = config["mount_point"] ? config["mount_point"].as<std::string>() : "";
+        YAML::Node dag = config["dag"];
+        if(!dag || dag.size() == 0) {
+            throw LABSTACK_INVALID.format(mount_point_, "the dag has no vertices");
+        }
+        if(dag.size() > LABSTOR_LABSTACK_MAX_STAGES) {
+            throw LABSTACK_INVALID.format(mount_point_, "the dag has more than " + std::to_string(LABSTOR_LABSTACK_MAX_STAGES) + " vertices");
+        }
+
+        //Parse the vertices in YAML order
+        for(auto iter : dag) {
+            YAML::Node vertex = dag.IsMap() ? iter.second : iter;
+            labstack_vertex v;
+            if(!vertex["labmod_uuid"] || !vertex["labmod"]) {
+                throw LABSTACK_INVALID.format(mount_point_, "every vertex needs a labmod_uuid and a labmod");
+            }
+            v.key_ = vertex["labmod_uuid"].as<std::string>();
+            v.labmod_ = vertex["labmod"].as<std::string>();
+            v.num_prev_ = 0;
+            v.qp_flags_ = ParseQueueHint(vertex);
+            if(vertex["worker_group"]) {
+                v.worker_group_ = vertex["worker_group"].as<std::string>();
+            }
+            v.config_ = vertex;
+            if(vertex["next"] && vertex["next"].IsSequence()) {
+                for(auto next : vertex["next"]) {
+                    v.next_.emplace_back(next.as<std::string>());
+                }
+            } else if(vertex["next"]) {
+                v.next_.emplace_back(vertex["next"].as<std::string>());
+            }
+            for(size_t j = 0; j < v.next_.size(); ++j) {
+                for(size_t k = 0; k < j; ++k) {
+                    if(v.next_[j] == v.next_[k]) {
+                        throw LABSTACK_INVALID.format(mount_point_, v.key_ + " forwards to " + v.next_[j] + " twice");
+                    }
+                }
+            }
+            if(v.next_.size() > LABSTOR_LABSTACK_MAX_FANOUT) {
+                throw LABSTACK_INVALID.format(mount_point_, v.key_ + " has more than " + std::to_string(LABSTOR_LABSTACK_MAX_FANOUT) + " next stages");
+            }
+            if(!index.emplace(v.key_, vertices.size()).second) {
+                throw LABSTACK_INVALID.format(mount_point_, v.key_ + " appears more than once");
+            }
+            vertices.emplace_back(std::move(v));
+        }
+
+        //Resolve edges between vertices of this DAG
+        for(auto &v : vertices) {
+            for(auto &next : v.next_) {
+                auto iter = index.find(next);
+                if(iter == index.end()) {
+                    v.succ_.emplace_back(-1);
+                    continue;
+                }
+                if(iter->second == index[v.key_]) {
+                    throw LABSTACK_INVALID.format(mount_point_, v.key_ + " forwards to itself");
+                }
+                v.succ_.emplace_back(iter->second);
+                ++vertices[iter->second].num_prev_;
+            }
+        }
+
+        //Kahn's algorithm, preferring YAML order among ready vertices
+        std::vector<uint32_t> in_degree(vertices.size());
+        std::vector<int> order, ready;
+        for(size_t i = vertices.size(); i-- > 0;) {
+            in_degree[i] = vertices[i].num_prev_;
+            if(in_degree[i] == 0) { ready.emplace_back(i); }
+        }
+        while(!ready.empty()) {
+            int i = ready.back();
+            ready.pop_back();
+            order.emplace_back(i);
+            for(auto it = vertices[i].succ_.rbegin(); it != vertices[i].succ_.rend(); ++it) {
+                if(*it >= 0 && --in_degree[*it] == 0) { ready.emplace_back(*it); }
+            }
+        }
+        if(order.size() != vertices.size()) {
+            throw LABSTACK_INVALID.format(mount_point_, "the dag has a cycle");
+        }
+
+        //Renumber successors by topological position
+        std::vector<int> position(vertices.size());
+        for(size_t pos = 0; pos < order.size(); ++pos) {
+            position[order[pos]] = pos;
+        }
+        stages_.clear();
+        stages_.reserve(order.size());
+        for(int i : order) {
+            stages_.emplace_back(std::move(vertices[i]));
+            for(auto &succ : stages_.back().succ_) {
+                if(succ >= 0) { succ = position[succ]; }
+            }
+        }
+
+        //The entry is the stage mounted at the mount point, or else the first source
+        entry_ = 0;
+        auto iter = index.find(mount_point_);
+        if(iter != index.end()) {
+            entry_ = position[iter->second];
+        }
+    }
+
+    inline const std::string& GetMountPoint() { return mount_point_; }
+    inline std::vector<labstack_vertex>& GetStages() { return stages_; }
+    inline labstack_vertex& GetEntry() { return stages_[entry_]; }
+
+    /*
+     * Fill a routes table. resolve maps a key to its ns_id, or
+     * LABSTOR_INVALID_NAMESPACE_KEY if the key is not registered.
+     * */
+    template<typename Resolver>
+    void BuildRoutes(labstor::ipc::labstack_routes *routes, Resolver resolve) {
+        std::vector<uint32_t> ns_ids(stages_.size());
+        for(size_t i = 0; i < stages_.size(); ++i) {
+            ns_ids[i] = resolve(stages_[i].key_);
+            if(ns_ids[i] == (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY) {
+                throw LABSTACK_INVALID.format(mount_point_, stages_[i].key_ + " is not registered");
+            }
+        }
+        routes->mount_ns_id_ = ns_ids[entry_];
+        routes->entry_ = entry_;
+        routes->version_ = 0;
+        routes->num_stages_ = stages_.size();
+        for(size_t i = 0; i < stages_.size(); ++i) {
+            labstack_vertex &v = stages_[i];
+            labstor::ipc::labstack_stage &stage = routes->stages_[i];
+            stage.ns_id_ = ns_ids[i];
+            stage.num_next_ = v.next_.size();
+            stage.num_prev_ = v.num_prev_;
+            stage.qp_flags_ = v.qp_flags_;
+            stage.qp_type_ = 0;
+            for(size_t j = 0; j < v.next_.size(); ++j) {
+                if(v.succ_[j] >= 0) {
+                    stage.next_[j] = ns_ids[v.succ_[j]];
+                    continue;
+                }
+                stage.next_[j] = resolve(v.next_[j]);
+                if(stage.next_[j] == (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY) {
+                    throw LABSTACK_INVALID.format(mount_point_, v.key_ + " forwards to unknown stage " + v.next_[j]);
+                }
+            }
+        }
+    }
+
+private:
+    inline uint32_t ParseQueueHint(YAML::Node vertex) {
+        uint32_t flags = 0;
+        if(vertex["queue"]) {
+            std::string hint = vertex["queue"].as<std::string>();
+            if(hint == "throughput") {
+                flags |= LABSTOR_QP_HIGH_LATENCY | LABSTOR_QP_BATCH;
+            } else if(hint != "latency") {
+                throw LABSTACK_INVALID.format(mount_point_, "queue must be latency or throughput, not " + hint);
+            }
+        }
+        if(vertex["unordered"] && vertex["unordered"].as<bool>()) {
+            flags |= LABSTOR_QP_UNORDERED;
+        }
+        return flags;
+    }
+};
+
+}
+
+#endif //LABSTOR_LABSTACK_DAG_H
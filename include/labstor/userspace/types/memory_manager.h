@@ -30,14 +30,17 @@
 #include <labstor/types/allocator/allocator.h>
 #include <labstor/types/allocator/segment_allocator.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
+#include <unordered_map>
+#include <vector>
 
 namespace labstor {
 
 class MemoryManager {
 private:
-    labstor::GenericAllocator *private_alloc_;
-    labstor::GenericAllocator *shmem_alloc_;
-    labstor::segment_allocator *qp_alloc_;
+    labstor::GenericAllocator *private_alloc_ = nullptr;
+    labstor::GenericAllocator *shmem_alloc_ = nullptr;
+    labstor::segment_allocator *qp_alloc_ = nullptr;
+    std::unordered_map<size_t, std::vector<void*>> free_queues_;
 public:
     void SetPrivateAlloc(labstor::GenericAllocator *private_alloc) {
         private_alloc_ = private_alloc;
@@ -45,6 +48,9 @@ public:
     void SetShmemAlloc(labstor::GenericAllocator *shmem_alloc) {
         shmem_alloc_ = shmem_alloc;
     }
+    labstor::GenericAllocator* GetShmemAlloc() {
+        return shmem_alloc_;
+    }
     void SetQueueAlloc(labstor::segment_allocator *qp_alloc) {
         qp_alloc_ = qp_alloc;
     }
@@ -58,8 +64,18 @@ public:
 
     template<typename T=void*>
     T* AllocShmemQueue(size_t size) {
+        //Reuse the memory of a queue that was torn down before taking new space
+        auto iter = free_queues_.find(size);
+        if(iter != free_queues_.end() && !iter->second.empty()) {
+            void *region = iter->second.back();
+            iter->second.pop_back();
+            return reinterpret_cast<T*>(region);
+        }
         return reinterpret_cast<T*>(qp_alloc_->Alloc(size));
     }
+    void FreeShmemQueue(void *region, size_t size) {
+        free_queues_[size].emplace_back(region);
+    }
     template<typename T=void*>
     T* AllocPrivateQueue(size_t size) {
         return reinterpret_cast<T*>(private_alloc_->Alloc(size));
@@ -67,11 +83,15 @@ public:
 
     template<typename T>
     inline T* AllocRequest(labstor_qid_flags_t flags, uint32_t size) {
+        labstor::ipc::request *rq;
         if(LABSTOR_QP_IS_SHMEM(flags)) {
-            return reinterpret_cast<T*>(shmem_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
+            rq = reinterpret_cast<labstor::ipc::request*>(shmem_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
         } else {
-            return reinterpret_cast<T*>(private_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
+            rq = reinterpret_cast<labstor::ipc::request*>(private_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
         }
+        //Blocks are reused, and requests that are started without Start must not inherit a deadline
+        if(rq) { rq->ClearDeadline(); }
+        return reinterpret_cast<T*>(rq);
     }
     template<typename T>
     inline T* AllocRequest(labstor::ipc::qid_t qid, uint32_t size) {
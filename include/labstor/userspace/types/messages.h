@@ -33,7 +33,8 @@
 namespace labstor::ipc {
 
 enum {
-    LABSTOR_ADMIN_REGISTER_QP
+    LABSTOR_ADMIN_REGISTER_QP,
+    LABSTOR_ADMIN_UNREGISTER_QP
 };
 
 struct admin_request {
@@ -56,15 +57,32 @@ struct setup_reply : public admin_reply {
     uint32_t queue_region_size_;
     uint32_t queue_depth_;
     uint32_t num_queues_;
+    uint32_t max_queues_;
+    uint32_t ipc_id_;
     uint32_t namespace_region_id_;
     uint32_t namespace_region_size_;
     uint32_t namespace_max_entries_;
+    //A labstor::ShmemProviderType. If it passes fds, both region fds follow this reply (region, namespace).
+    uint32_t shmem_provider_;
+
+    //The server prebuilds num_queues_ client queues back to back at the front of the queue region
+    inline uint32_t GetPrebuiltQueueSize() {
+        return labstor::ipc::request_queue::GetSize(queue_depth_) + labstor::ipc::request_map::GetSize(queue_depth_);
+    }
+    inline uint32_t GetPrebuiltRegionSize() {
+        return num_queues_ * GetPrebuiltQueueSize();
+    }
+    inline void GetPrebuiltQueuePointer(int i, uint32_t pid, labstor::ipc::queue_pair_ptr &ptr) {
+        ptr.sq_off_ = request_region_size_ + i * GetPrebuiltQueueSize();
+        ptr.cq_off_ = ptr.sq_off_ + labstor::ipc::request_queue::GetSize(queue_depth_);
+        ptr.pid_ = pid;
+    }
 };
 
 struct register_qp_request : public labstor::ipc::admin_request {
     int count_;
     register_qp_request() {}
-    register_qp_request(int count) : count_(count), labstor::ipc::admin_request(LABSTOR_ADMIN_REGISTER_QP) {}
+    register_qp_request(int count) : labstor::ipc::admin_request(LABSTOR_ADMIN_REGISTER_QP), count_(count) {}
 
     uint32_t GetQueueArrayLength() {
         return count_ * sizeof(labstor::ipc::queue_pair_ptr);
@@ -72,6 +90,13 @@ struct register_qp_request : public labstor::ipc::admin_request {
 };
 typedef admin_reply register_qp_reply;
 
+struct unregister_qp_request : public labstor::ipc::admin_request {
+    labstor::ipc::qid_t qid_;
+    unregister_qp_request() {}
+    unregister_qp_request(labstor::ipc::qid_t qid) : labstor::ipc::admin_request(LABSTOR_ADMIN_UNREGISTER_QP), qid_(qid) {}
+};
+typedef admin_reply unregister_qp_reply;
+
 struct poll_request : public labstor::ipc::request {
     labstor::ipc::qtok_t qtok_;
     labstor::ipc::qtok_t *qtoks_;
@@ -36,7 +36,9 @@
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include "registrar.h"
 #include <labstor/userspace/util/errors.h>
-#include <list>
+#include <queue>
+#include <condition_variable>
+#include <chrono>
 #include <yaml-cpp/yaml.h>
 
 namespace labstor {
@@ -48,6 +50,7 @@ protected:
     uint32_t ns_id_;
 public:
     Module(labstor::id module_id) : module_id_(module_id), ns_id_(0) {}
+    virtual ~Module() = default;
     inline labstor::id GetModuleID() { return module_id_; }
     void SetNamespaceID(uint32_t ns_id) { ns_id_ = ns_id; }
     uint32_t GetNamespaceID() { return ns_id_; }
@@ -63,9 +66,28 @@ class Module {
 protected:
     labstor::id module_id_;
     uint32_t ns_id_;
+    /*
+     * Set by modules whose handler may be called directly by an upstream stage (see labstor::Server::Dispatch).
+     * Such a handler must either complete the request before returning true, or return false leaving its
+     * progress in the request. It must not keep the queue pair it was given past the call.
+     * */
+    bool inlinable_;
+    /*Handlers of this module suspended on a worker (see labstor::CoroutineModule)*/
+    std::atomic<uint32_t> num_suspended_;
+    /*Deadline-queue requests this module returned from without completing, which it must be called for again*/
+    std::atomic<uint32_t> num_started_;
 public:
-    Module(labstor::id module_id) : module_id_(module_id), ns_id_(0) {}
+    Module(labstor::id module_id) : module_id_(module_id), ns_id_(0), inlinable_(false), num_suspended_(0), num_started_(0) {}
+    virtual ~Module() = default;
     inline labstor::id GetModuleID() { return module_id_; }
+    inline bool IsInlinable() { return inlinable_; }
+    inline uint32_t GetNumSuspended() { return num_suspended_.load(std::memory_order_acquire); }
+    inline void AddStarted() { num_started_.fetch_add(1, std::memory_order_relaxed); }
+    inline void RemoveStarted() { num_started_.fetch_sub(1, std::memory_order_release); }
+    /*Work this instance began and has not finished. It must reach zero before the instance is replaced.*/
+    inline uint32_t GetNumPending() {
+        return num_suspended_.load(std::memory_order_acquire) + num_started_.load(std::memory_order_acquire);
+    }
     void SetNamespaceID(uint32_t ns_id) { ns_id_ = ns_id; }
     uint32_t GetNamespaceID() { return ns_id_; }
     virtual bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) = 0;
@@ -82,6 +104,21 @@ public:
             labstor::queue_pair *qp,
             labstor::ipc::request *request,
             labstor::credentials *creds) { return true; };
+    /*
+     * Called with n consecutive requests for this ns_id from one queue, oldest first, and returns how many of
+     * the leading requests completed. The remaining requests stay queued and are passed again later, so a
+     * module may only act on them early if it records its progress in the request.
+     * */
+    virtual uint32_t ProcessRequestBatch(
+            labstor::queue_pair *qp,
+            labstor::ipc::request **requests,
+            uint32_t n,
+            labstor::credentials *creds) {
+        uint32_t i;
+        for(i = 0; i < n && ProcessRequest(qp, requests[i], creds); ++i) {}
+        return i;
+    }
+    /*Runs while this ns_id is paused. Bulk state should be re-attached from the StateManager, not copied.*/
     virtual void StateUpdate(Module *prior) {}
     virtual void StateUpdate(YAML::Node config) {}
 };
@@ -91,11 +128,42 @@ public:
 
 typedef labstor::Module* (*create_module_fn)(void);
 typedef labstor::id (*get_module_id_fn)(void);
+
+/*Constructors of labmods linked into the executable, which are used instead of dlopening the module*/
+class StaticModuleRegistry {
+public:
+    struct Registration {
+        Registration(const char *module_id, create_module_fn constructor) {
+            StaticModuleRegistry::Get()[labstor::id(module_id)] = constructor;
+        }
+    };
+    static create_module_fn Find(labstor::id module_id) {
+        auto iter = Get().find(module_id);
+        if(iter == Get().end()) {
+            return nullptr;
+        }
+        return iter->second;
+    }
+private:
+    static std::unordered_map<labstor::id, create_module_fn>& Get() {
+        static std::unordered_map<labstor::id, create_module_fn> registry;
+        return registry;
+    }
+};
+
+#define LABSTOR_MODULE_CONCAT_INNER(A, B) A##B
+#define LABSTOR_MODULE_CONCAT(A, B) LABSTOR_MODULE_CONCAT_INNER(A, B)
+#ifdef LABSTOR_STATIC_MODULES
+#define LABSTOR_MODULE_CONSTRUCT(MODULE_NAME, MODULE_ID) \
+    static labstor::StaticModuleRegistry::Registration LABSTOR_MODULE_CONCAT(labstor_static_module_, __LINE__)( \
+        MODULE_ID, []() -> labstor::Module* { return new MODULE_NAME(); });
+#else
 #define LABSTOR_MODULE_CONSTRUCT(MODULE_NAME, MODULE_ID) \
     extern "C" {                              \
         labstor::Module* create_module() { return new MODULE_NAME(); } \
         labstor::id get_module_id(void) { return labstor::id(MODULE_ID); } \
     }
+#endif
 
 struct ModulePath {
     std::string client;
@@ -116,15 +184,29 @@ class ModuleTable {
 private:
     std::mutex mutex_;
     std::unordered_map<labstor::id, ModuleHandle> pkg_pool_;
-    std::list<labstor::Registrar::upgrade_request*> upgrades_;
+    std::mutex upgrade_mutex_;
+    std::condition_variable upgrade_cv_;
+    std::queue<std::string> upgrades_;
 public:
     ModuleTable() = default;
 
-    void PushUpgrade(labstor::Registrar::upgrade_request *req) {
-        upgrades_.emplace_back(req);
+    /*Queue the YAML describing an upgrade and wake the upgrade thread*/
+    void PushUpgrade(const std::string &yaml_path) {
+        {
+            std::lock_guard<std::mutex> lock(upgrade_mutex_);
+            upgrades_.emplace(yaml_path);
+        }
+        upgrade_cv_.notify_one();
     }
-    std::list<labstor::Registrar::upgrade_request*>& GetUpgrades() {
-        return upgrades_;
+    /*Block until an upgrade is queued or timeout_ms passes. Returns false on timeout.*/
+    bool WaitForUpgrade(std::string &yaml_path, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(upgrade_mutex_);
+        if(!upgrade_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !upgrades_.empty(); })) {
+            return false;
+        }
+        yaml_path = std::move(upgrades_.front());
+        upgrades_.pop();
+        return true;
     }
     ModuleHandle OpenModule(std::string path, labstor::id &module_id) {
         AUTO_TRACE("")
@@ -151,11 +233,15 @@ public:
         AUTO_TRACE("", (size_t)this)
         mutex_.lock();
         TRACEPOINT("Adding module", module_id.key_, std::hash<labstor::id>()(module_id))
-        if(pkg_pool_.find(module_id) != pkg_pool_.end()) {
-            dlclose(pkg_pool_[module_id].handle_);
+        auto iter = pkg_pool_.find(module_id);
+        if(iter != pkg_pool_.end()) {
+            if(iter->second.handle_) {
+                dlclose(iter->second.handle_);
+            }
+            iter->second = module_info;
+        } else {
+            pkg_pool_.emplace(module_id, module_info);
         }
-        TRACEPOINT("Here")
-        pkg_pool_.emplace(module_id, module_info);
         mutex_.unlock();
     }
 
@@ -30,6 +30,7 @@
 #include <labstor/types/data_structures/queue_pair.h>
 #include <labstor/types/thread_local.h>
 #include <vector>
+#include <algorithm>
 
 namespace labstor {
 
@@ -75,7 +76,38 @@ public:
             throw INVALID_QP_QUERY.format(qid.pid_, qid.type_, qid.flags_, qid.cnt_);
         }
         auto &qps_flags = qps_type[qid.flags_];
-        qps_flags.emplace_back(qp);
+        //Queues are indexed by their count, which may fill a slot freed by UnregisterQueuePair
+        if(qid.cnt_ >= qps_flags.size()) {
+            qps_flags.resize(qid.cnt_ + 1, nullptr);
+        }
+        if(qps_flags[qid.cnt_]) {
+            throw INVALID_QP_QUERY.format(qid.pid_, qid.type_, qid.flags_, qid.cnt_);
+        }
+        qps_flags[qid.cnt_] = qp;
+    }
+    inline bool UnregisterQueuePair(labstor::queue_pair *qp) {
+        labstor::ipc::qid_t qid = qp->GetQID();
+        labstor::queue_pair *cur = FindQueuePair(qid);
+        if(cur != qp) {
+            return false;
+        }
+        qps_[qid.type_][qid.flags_][qid.cnt_] = nullptr;
+        return true;
+    }
+    inline labstor::queue_pair* FindQueuePair(labstor::ipc::qid_t &qid) {
+        if(qid.type_ >= qps_.size()) { return nullptr; }
+        auto &qps_type = qps_[qid.type_];
+        if(qid.flags_ >= qps_type.size()) { return nullptr; }
+        auto &qps_flags = qps_type[qid.flags_];
+        if(qid.cnt_ >= qps_flags.size()) { return nullptr; }
+        return qps_flags[qid.cnt_];
+    }
+    inline int GetFreeQueueSlot(labstor_qid_type_t type, labstor_qid_flags_t flags, size_t start = 0) {
+        auto &qps_flags = qps_[type][flags];
+        for(size_t i = start; i < qps_flags.size(); ++i) {
+            if(!qps_flags[i]) { return (int)i; }
+        }
+        return (int)std::max(start, qps_flags.size());
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags, int off) {
         if(type >= qps_.size()) {
@@ -90,6 +122,20 @@ public:
             throw INVALID_QP_QUERY.format(-1000, type, flags, off);
         }
         qp = qps_flags[off];
+        if(!qp) {
+            throw INVALID_QP_QUERY.format(-1000, type, flags, off);
+        }
+    }
+    /*Pick one of the (type, flags) queues by hash, or one of the type 0 queues if there are none*/
+    inline void GetQueuePairOfType(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags, uint32_t hash) {
+        if(type >= qps_.size() || flags >= qps_[type].size() || qps_[type][flags].empty()) {
+            type = 0;
+        }
+        int num_qps = GetNumQueuePairs(type, flags);
+        if(num_qps == 0) {
+            throw INVALID_QP_QUERY.format(-1000, type, flags, hash);
+        }
+        GetQueuePair(qp, type, flags, (int)(hash % num_qps));
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor::ipc::qid_t &qid) {
         GetQueuePair(qp, qid.type_, qid.flags_, qid.cnt_);
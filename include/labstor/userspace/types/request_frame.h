@@ -0,0 +1,272 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_REQUEST_FRAME_H
+#define LABSTOR_REQUEST_FRAME_H
+
+#include <vector>
+#include <atomic>
+#include <labstor/types/basics.h>
+#include <labstor/constants/constants.h>
+#include <labstor/types/data_structures/queue_pair.h>
+
+#define LABSTOR_REQUEST_FRAME_SIZE 512
+#define LABSTOR_REQUEST_FRAME_COUNT 256
+
+namespace labstor {
+
+/*
+ * Fixed-size block pool for the state (e.g., coroutine frames) of requests a worker
+ * has suspended. Allocations that are too large, or made when the pool is exhausted, fall back to malloc.
+ * */
+class request_frame_pool {
+private:
+    char *region_;
+    uint32_t block_size_, num_blocks_;
+    std::vector<void*> free_;
+public:
+    request_frame_pool() : region_(nullptr), block_size_(0), num_blocks_(0) {}
+    ~request_frame_pool() {
+        if(region_) { free(region_); }
+    }
+
+    void Init(uint32_t block_size = LABSTOR_REQUEST_FRAME_SIZE, uint32_t num_blocks = LABSTOR_REQUEST_FRAME_COUNT) {
+        block_size_ = block_size;
+        num_blocks_ = num_blocks;
+        region_ = (char*)malloc(block_size_ * num_blocks_);
+        free_.reserve(num_blocks_);
+        for(uint32_t i = 0; i < num_blocks_; ++i) {
+            free_.emplace_back(region_ + (size_t)i*block_size_);
+        }
+    }
+
+    inline void* Alloc(size_t size) {
+        if(size > block_size_ || free_.empty()) {
+            return malloc(size);
+        }
+        void *block = free_.back();
+        free_.pop_back();
+        return block;
+    }
+
+    inline void Free(void *block) {
+        if(region_ <= (char*)block && (char*)block < region_ + (size_t)block_size_*num_blocks_) {
+            free_.emplace_back(block);
+            return;
+        }
+        free(block);
+    }
+};
+
+/*
+ * The request a handler was started for. If the handler is cancelled, rq_ is completed on qp_ with an error.
+ * num_suspended_ (if set) counts the frames of the handler's module that are still suspended.
+ * */
+struct request_origin {
+    labstor::queue_pair *qp_;
+    labstor::ipc::request *rq_;
+    uint32_t ns_id_;
+    std::atomic<uint32_t> *num_suspended_;
+};
+
+/*
+ * A request whose handler is waiting for a sub-request (await_qp_, await_req_id_) to complete.
+ * The completed sub-request is written to *result_ before resume_ is called.
+ * resume_ returns true once the handler has finished; the worker then calls destroy_.
+ * failed_ (if set) tells whether a finished handler ended with an exception, in which case its origin request fails.
+ * */
+struct suspended_request {
+    request_origin origin_;
+    void *frame_;
+    bool (*resume_)(void *frame);
+    void (*destroy_)(void *frame);
+    bool (*failed_)(void *frame) = nullptr;
+    labstor::queue_pair *await_qp_;
+    labstor_req_id_t await_req_id_;
+    labstor::ipc::request **result_;
+};
+
+/*
+ * The sub-request of a cancelled handler which had not completed yet. It is freed once it completes.
+ * */
+struct orphaned_request {
+    labstor::queue_pair *qp_;
+    labstor_req_id_t req_id_;
+};
+
+/*
+ * Frees a completed sub-request back to whoever allocated it for the queue pair.
+ * */
+typedef void (*free_request_fn)(labstor::queue_pair *qp, labstor::ipc::request *rq);
+
+/*
+ * Per-worker set of suspended requests. Only the completions that suspended requests are waiting
+ * for are checked on each pass, instead of re-running every stalled request from the top.
+ * */
+class request_scheduler {
+private:
+    request_frame_pool pool_;
+    std::vector<suspended_request> suspended_;
+    std::vector<orphaned_request> orphaned_;
+    request_origin origin_;
+    free_request_fn free_request_;
+    inline static thread_local request_scheduler *current_ = nullptr;
+public:
+    request_scheduler() : origin_(), free_request_(nullptr) {}
+
+    void Init(free_request_fn free_request = nullptr,
+              uint32_t block_size = LABSTOR_REQUEST_FRAME_SIZE, uint32_t num_blocks = LABSTOR_REQUEST_FRAME_COUNT) {
+        free_request_ = free_request;
+        pool_.Init(block_size, num_blocks);
+        suspended_.reserve(num_blocks);
+    }
+
+    static inline request_scheduler* GetCurrent() { return current_; }
+    static inline void SetCurrent(request_scheduler *scheduler) { current_ = scheduler; }
+
+    inline request_frame_pool& GetPool() { return pool_; }
+    inline uint32_t GetNumSuspended() { return suspended_.size(); }
+    inline uint32_t GetNumOrphaned() { return orphaned_.size(); }
+
+    /*The request whose handler is about to run on this worker. Frames suspended by the handler are tagged with it.*/
+    inline void SetOrigin(const request_origin &origin) { origin_ = origin; }
+    inline request_origin& GetOrigin() { return origin_; }
+
+    inline void Suspend(suspended_request &req) {
+        req.origin_ = origin_;
+        if(origin_.num_suspended_) {
+            origin_.num_suspended_->fetch_add(1, std::memory_order_relaxed);
+        }
+        suspended_.emplace_back(req);
+    }
+
+    /*
+     * Resume every suspended request whose sub-request completed and whose ns_id is not held (hold(ns_id)).
+     * Sub-requests orphaned by Cancel are freed as they complete.
+     * Returns the number resumed.
+     * */
+    template<typename F>
+    inline uint32_t Poll(F hold) {
+        uint32_t count = 0;
+        for(size_t i = 0; i < orphaned_.size();) {
+            if(!Reap(orphaned_[i].qp_, orphaned_[i].req_id_)) {
+                ++i;
+                continue;
+            }
+            orphaned_[i] = orphaned_.back();
+            orphaned_.pop_back();
+        }
+        for(size_t i = 0; i < suspended_.size();) {
+            suspended_request &req = suspended_[i];
+            if(hold(req.origin_.ns_id_) || !req.await_qp_->IsComplete(req.await_req_id_, *req.result_)) {
+                ++i;
+                continue;
+            }
+            //Unlink before resuming: the handler may suspend again and append to suspended_
+            suspended_request ready = req;
+            suspended_[i] = suspended_.back();
+            suspended_.pop_back();
+            origin_ = ready.origin_;
+            if(ready.resume_(ready.frame_)) {
+                if(ready.failed_ && ready.failed_(ready.frame_)) {
+                    Fail(ready.origin_);
+                }
+                ready.destroy_(ready.frame_);
+            }
+            Release(ready);
+            ++count;
+        }
+        origin_ = request_origin();
+        return count;
+    }
+    inline uint32_t Poll() {
+        return Poll([](uint32_t ns_id) { return false; });
+    }
+
+    /*
+     * Used before the queue pairs for which removed(qp) is true are torn down.
+     * Every suspended request that started on, or waits on, such a queue pair is destroyed and its
+     * origin request is completed with LABSTOR_REQUEST_FAILED. Its sub-request is freed if it already completed,
+     * dropped along with its queue pair if that is removed, and otherwise orphaned until it completes.
+     * Returns the number cancelled.
+     * */
+    template<typename F>
+    inline uint32_t Cancel(F removed) {
+        uint32_t count = 0;
+        for(size_t i = 0; i < orphaned_.size();) {
+            if(!removed(orphaned_[i].qp_)) {
+                ++i;
+                continue;
+            }
+            orphaned_[i] = orphaned_.back();
+            orphaned_.pop_back();
+        }
+        for(size_t i = 0; i < suspended_.size();) {
+            suspended_request &req = suspended_[i];
+            if(!removed(req.origin_.qp_) && !removed(req.await_qp_)) {
+                ++i;
+                continue;
+            }
+            suspended_request cancelled = req;
+            suspended_[i] = suspended_.back();
+            suspended_.pop_back();
+            cancelled.destroy_(cancelled.frame_);
+            Fail(cancelled.origin_);
+            if(!removed(cancelled.await_qp_) && !Reap(cancelled.await_qp_, cancelled.await_req_id_)) {
+                orphaned_.emplace_back(orphaned_request{cancelled.await_qp_, cancelled.await_req_id_});
+            }
+            Release(cancelled);
+            ++count;
+        }
+        return count;
+    }
+private:
+    inline void Fail(request_origin &origin) {
+        if(origin.rq_) {
+            origin.rq_->SetCode(LABSTOR_REQUEST_FAILED);
+            origin.qp_->Complete(origin.rq_);
+        }
+    }
+    inline bool Reap(labstor::queue_pair *qp, labstor_req_id_t req_id) {
+        labstor::ipc::request *rq;
+        if(!qp->IsComplete(req_id, rq)) {
+            return false;
+        }
+        if(free_request_) {
+            free_request_(qp, rq);
+        }
+        return true;
+    }
+    inline void Release(suspended_request &req) {
+        if(req.origin_.num_suspended_) {
+            req.origin_.num_suspended_->fetch_sub(1, std::memory_order_release);
+        }
+    }
+};
+
+}
+
+#endif //LABSTOR_REQUEST_FRAME_H
@@ -29,6 +29,8 @@
 
 #include <vector>
 #include <queue>
+#include <atomic>
+#include <memory>
 
 #include <labstor/constants/constants.h>
 #include <labstor/constants/macros.h>
@@ -38,9 +40,104 @@
 #include "labstor/types/data_structures/shmem_ring_buffer.h"
 #include <labstor/types/data_structures/unordered_map/shmem_string_map.h>
 #include <labstor/types/data_structures/shmem_string.h>
+#include <labstor/types/data_structures/shmem_mount_trie.h>
+#include <labstor/types/data_structures/shmem_route_table.h>
+#include <labstor/types/hash.h>
+#include <labstor/types/tsc_clock.h>
+#include <labstor/userspace/util/errors.h>
+
+#define LABSTOR_MOUNT_CACHE_SIZE 64
 
 namespace labstor {
 
+struct mount_cache_entry {
+    uint64_t hash_;
+    uint32_t len_;
+    uint32_t generation_;
+    uint32_t ns_id_;
+    uint32_t match_len_;
+};
+
+/*
+ * A fixed-capacity table of module instances indexed by ns_id.
+ * Workers read a slot with a single acquire load. Registration and upgrades publish into a slot with a
+ * release store. The table never reallocates, so a reader can never observe a freed array. An instance
+ * replaced by Publish must only be freed once every worker has passed a quiescent point.
+ * */
+class ModuleStateTable {
+private:
+    std::unique_ptr<std::atomic<labstor::Module*>[]> modules_;
+    std::unique_ptr<std::atomic<bool>[]> paused_;
+    std::atomic<uint32_t> num_paused_;
+    std::atomic<uint32_t> size_;
+    uint32_t capacity_;
+public:
+    ModuleStateTable() : num_paused_(0), size_(0), capacity_(0) {}
+
+    void Init(uint32_t capacity) {
+        modules_ = std::make_unique<std::atomic<labstor::Module*>[]>(capacity);
+        paused_ = std::make_unique<std::atomic<bool>[]>(capacity);
+        for(uint32_t i = 0; i < capacity; ++i) {
+            modules_[i].store(nullptr, std::memory_order_relaxed);
+            paused_[i].store(false, std::memory_order_relaxed);
+        }
+        num_paused_.store(0, std::memory_order_relaxed);
+        size_.store(0, std::memory_order_relaxed);
+        capacity_ = capacity;
+    }
+
+    /*
+     * Requests targeting a paused ns_id are left in their queues until it is resumed.
+     * Workers only look at the per-slot flag while some slot is paused.
+     * */
+    inline void Pause(uint32_t ns_id) {
+        if(ns_id < capacity_ && !paused_[ns_id].exchange(true, std::memory_order_seq_cst)) {
+            num_paused_.fetch_add(1, std::memory_order_seq_cst);
+        }
+    }
+    inline void Resume(uint32_t ns_id) {
+        if(ns_id < capacity_ && paused_[ns_id].exchange(false, std::memory_order_seq_cst)) {
+            num_paused_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+    inline bool IsPaused(uint32_t ns_id) {
+        if(num_paused_.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+        return ns_id < capacity_ && paused_[ns_id].load(std::memory_order_acquire);
+    }
+
+    /*Reserve the next never-used ns_id*/
+    inline uint32_t Reserve() {
+        uint32_t ns_id = size_.fetch_add(1, std::memory_order_acq_rel);
+        if(ns_id >= capacity_) {
+            size_.fetch_sub(1, std::memory_order_acq_rel);
+            throw NAMESPACE_TABLE_FULL.format(capacity_);
+        }
+        return ns_id;
+    }
+
+    /*Atomically replace the instance at ns_id and return the prior one*/
+    inline labstor::Module* Publish(uint32_t ns_id, labstor::Module *module) {
+        if(ns_id >= capacity_) {
+            throw NAMESPACE_TABLE_FULL.format(capacity_);
+        }
+        uint32_t size = size_.load(std::memory_order_acquire);
+        while(size <= ns_id && !size_.compare_exchange_weak(size, ns_id + 1, std::memory_order_acq_rel)) {}
+        return modules_[ns_id].exchange(module, std::memory_order_acq_rel);
+    }
+
+    inline labstor::Module* Get(uint32_t ns_id) {
+        if(ns_id < capacity_) {
+            return modules_[ns_id].load(std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    inline uint32_t GetSize() { return size_.load(std::memory_order_acquire); }
+    inline uint32_t GetCapacity() { return capacity_; }
+};
+
 class Namespace {
 protected:
     labstor::GenericAllocator *shmem_alloc_;
@@ -48,11 +145,15 @@ protected:
     uint32_t region_size_;
     void *region_;
     uint32_t max_entries_;
+    struct labstor_tsc_clock *clock_ = nullptr;
 
     std::unordered_map<labstor::id, std::queue<labstor::Module*>> module_id_to_instance_;
     labstor::ipc::mpmc::ring_buffer<uint32_t> ns_ids_;
     labstor::ipc::mpmc::string_map key_to_ns_id_;
-    std::vector<labstor::Module*> private_state_;
+    labstor::ipc::mount_trie mount_points_;
+    labstor::ipc::route_table routes_;
+    ModuleStateTable private_state_;
+    std::atomic<uint32_t> generation_{0};
 public:
     inline void GetSharedRegion(uint32_t &region_id, uint32_t &region_size, uint32_t &max_entries) {
         region_id = region_id_;
@@ -60,27 +161,114 @@ public:
         max_entries = max_entries_;
     }
 
+    inline const struct labstor_tsc_clock* GetClock() {
+        return clock_;
+    }
+
+    /*The number of ns_ids the module table can hold*/
+    inline uint32_t GetCapacity() {
+        return private_state_.GetCapacity();
+    }
+
     inline void RegisterPrivateState(uint32_t ns_id, labstor::Module *module) {
-        if(ns_id > private_state_.size()) {
-            private_state_.resize(ns_id+1);
+        private_state_.Publish(ns_id, module);
+        MarkModified();
+    }
+
+    /*
+     * Swap the instance serving ns_id. The prior instance is returned to the caller, who
+     * may only free it after every worker has passed a quiescent point.
+     * */
+    inline labstor::Module* PublishModule(uint32_t ns_id, labstor::Module *module) {
+        module->SetNamespaceID(ns_id);
+        labstor::Module *old_module = private_state_.Publish(ns_id, module);
+        MarkModified();
+        return old_module;
+    }
+
+    /*Stop workers from dispatching requests to ns_id, e.g., while its module is replaced*/
+    inline void PauseModule(uint32_t ns_id) {
+        private_state_.Pause(ns_id);
+    }
+    inline void ResumeModule(uint32_t ns_id) {
+        private_state_.Resume(ns_id);
+    }
+    inline bool IsPaused(uint32_t ns_id) {
+        return private_state_.IsPaused(ns_id);
+    }
+
+    /*Bumped whenever an ns_id may map to a different module, so cached lookups can be dropped*/
+    inline void MarkModified() {
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+    inline uint32_t GetGeneration() {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    /*Bumped in shared memory when a LabStack is mounted, unmounted or modified*/
+    inline void MarkMountsModified() {
+        mount_points_.MarkModified();
+    }
+
+    /*
+     * Resolve the mount point owning path, i.e., the longest mounted key which is a prefix of the path.
+     * Resolutions are cached per-thread until the mount table's generation changes.
+     * */
+    inline bool ResolveMountPoint(const char *path, uint32_t len, uint32_t &ns_id, uint32_t &match_len) {
+        static thread_local mount_cache_entry cache[LABSTOR_MOUNT_CACHE_SIZE];
+        uint64_t hash = labstor_hash64(path, len);
+        uint32_t generation = mount_points_.GetGeneration();
+        mount_cache_entry &entry = cache[hash % LABSTOR_MOUNT_CACHE_SIZE];
+        if(entry.hash_ != hash || entry.len_ != len || entry.generation_ != generation) {
+            entry.hash_ = hash;
+            entry.len_ = len;
+            entry.generation_ = generation;
+            if(!mount_points_.Find(path, len, entry.ns_id_, entry.match_len_)) {
+                entry.ns_id_ = LABSTOR_INVALID_NAMESPACE_KEY;
+            }
+        }
+        ns_id = entry.ns_id_;
+        match_len = entry.match_len_;
+        return ns_id != (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY;
+    }
+
+    /*The compiled route of the stage at ns_id, or nullptr if no mounted LabStack contains it*/
+    inline const labstor::ipc::labstack_stage* GetRoute(uint32_t ns_id) {
+        return routes_.Get(ns_id);
+    }
+
+    /*The i-th next hop of the stage at ns_id, or fallback if the stage has no compiled route*/
+    inline uint32_t GetNextHop(uint32_t ns_id, uint32_t fallback, uint32_t i = 0) {
+        const labstor::ipc::labstack_stage *stage = routes_.Get(ns_id);
+        if(stage == nullptr || i >= stage->num_next_) {
+            return fallback;
         }
-        private_state_[ns_id] = module;
+        return stage->next_[i];
+    }
+
+    /*The type of queue pair served by the worker group the stage at ns_id is pinned to, or 0 if unpinned*/
+    inline labstor_qid_type_t GetQueueType(uint32_t ns_id) {
+        const labstor::ipc::labstack_stage *stage = routes_.Get(ns_id);
+        return stage ? stage->qp_type_ : 0;
     }
 
     inline uint32_t AddKey(labstor::ipc::string key, labstor::Module *module) {
         uint32_t ns_id;
-        if(ns_ids_.Dequeue(ns_id)) {
-            private_state_[ns_id] = module;
-        } else {
-            ns_id = private_state_.size();
-            private_state_.emplace_back(module);
+        if(!ns_ids_.Dequeue(ns_id)) {
+            ns_id = private_state_.Reserve();
         }
+        module->SetNamespaceID(ns_id);
+        private_state_.Publish(ns_id, module);
         TRACEPOINT(key.ToString(), key.Hash(),  ns_id);
         if(!key_to_ns_id_.Set(key, ns_id)) {
             FAILED_TO_SET_NAMESPACE_KEY.format(ns_id)->print();
         }
+        if(labstor::ipc::mount_trie::IsMountPoint(key) && !mount_points_.Insert(key, ns_id)) {
+            FAILED_TO_SET_NAMESPACE_KEY.format(ns_id)->print();
+        }
         module_id_to_instance_.emplace(module->GetModuleID(), std::move(std::queue<labstor::Module*>()));
         module_id_to_instance_[module->GetModuleID()].push(module);
+        MarkModified();
         return ns_id;
     }
     inline uint32_t AddKey(labstor::id key, labstor::Module *module) {
@@ -122,10 +310,7 @@ public:
     }
     template<typename T=labstor::Module>
     inline T* GetModule(uint32_t ns_id) {
-        if(0 <= ns_id && ns_id < private_state_.size()) {
-            return reinterpret_cast<T*>(private_state_[ns_id]);
-        }
-        return nullptr;
+        return reinterpret_cast<T*>(private_state_.Get(ns_id));
     }
 
     inline std::queue<labstor::Module*>& AllModuleInstances(labstor::id module_id) {
@@ -0,0 +1,62 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SHMEM_PROVIDER_H
+#define LABSTOR_SHMEM_PROVIDER_H
+
+#include <string>
+#include <cstddef>
+#include <labstor/userspace/util/errors.h>
+
+namespace labstor {
+
+enum class ShmemProviderType {
+    kKernel = 0, //Regions are created, granted, and mapped through the secure_shmem kernel module
+    kMemfd = 1   //Regions are memfds whose file descriptors are passed to clients over the UNIX socket
+};
+
+class ShmemProvider {
+public:
+    virtual ~ShmemProvider() = default;
+    virtual int CreateShmem(size_t region_size, bool user_owned) = 0;
+    virtual int GrantPidShmem(int pid, int region_id) = 0;
+    virtual int FreeShmem(int region_id) = 0;
+    virtual void *MapShmem(int region_id, size_t region_size) = 0;
+    virtual void UnmapShmem(void *region, size_t region_size) = 0;
+
+    //Providers whose region ids are file descriptors must send them alongside the setup message
+    virtual bool PassesFds() { return false; }
+
+    static ShmemProviderType GetTypeFromString(const std::string &type) {
+        if(type == "kernel") { return ShmemProviderType::kKernel; }
+        if(type == "memfd") { return ShmemProviderType::kMemfd; }
+        throw INVALID_SHMEM_PROVIDER.format(type);
+    }
+};
+
+}
+
+#endif //LABSTOR_SHMEM_PROVIDER_H
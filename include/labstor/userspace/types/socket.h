@@ -32,6 +32,9 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <fcntl.h>
+#include <cstring>
+
+#define LABSTOR_MAX_PASSED_FDS 4
 
 namespace labstor {
 
@@ -81,6 +84,56 @@ public:
         }
         return true;
     }
+    //Pass file descriptors (SCM_RIGHTS) along with a single marker byte
+    void SendFDs(int *fds, int count) {
+        if (count <= 0 || count > LABSTOR_MAX_PASSED_FDS) {
+            throw labstor::SHMEM_FD_PASSING_FAILED.format("cannot pass " + std::to_string(count) + " descriptors");
+        }
+        char marker = 0;
+        struct iovec iov = { &marker, sizeof(marker) };
+        char cmsgbuf[CMSG_SPACE(sizeof(int) * LABSTOR_MAX_PASSED_FDS)];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        memset(cmsgbuf, 0, sizeof(cmsgbuf));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cmsgbuf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+        while (sendmsg(fd_, &msg, 0) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { continue; }
+            throw labstor::UNIX_SENDMSG_FAILED.format(strerror(errno));
+        }
+    }
+
+    void RecvFDs(int *fds, int count) {
+        if (count <= 0 || count > LABSTOR_MAX_PASSED_FDS) {
+            throw labstor::SHMEM_FD_PASSING_FAILED.format("cannot receive " + std::to_string(count) + " descriptors");
+        }
+        char marker;
+        struct iovec iov = { &marker, sizeof(marker) };
+        char cmsgbuf[CMSG_SPACE(sizeof(int) * LABSTOR_MAX_PASSED_FDS)];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cmsgbuf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+        int ret;
+        while ((ret = recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC)) <= 0) {
+            if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) { continue; }
+            throw labstor::UNIX_RECVMSG_FAILED.format(ret == 0 ? "socket closed" : strerror(errno));
+        }
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * count)) {
+            throw labstor::SHMEM_FD_PASSING_FAILED.format("expected " + std::to_string(count) + " descriptors");
+        }
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * count);
+    }
 private:
     //NOTE: if ret == 0, means socket is closed
     inline int safe_recv(void *buf, int size, int flags) {
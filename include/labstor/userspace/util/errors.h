@@ -60,6 +60,8 @@ namespace labstor {
     const Error INVALID_REGION_SUB(303, "The pointer {} exists outside of {}");
 
     const Error SHMEM_CREATE_FAILED(400, "Failed to allocate SHMEM");
+    const Error INVALID_SHMEM_PROVIDER(401, "{} is not a valid shmem provider (kernel, memfd)");
+    const Error SHMEM_FD_PASSING_FAILED(402, "Failed to pass SHMEM file descriptors: {}");
 
     const Error INVALID_MODULE_ID(500, "Failed to find module {}");
     const Error INVALID_NAMESPACE_ENTRY(501, "Failed to find namespace entry {}");
@@ -76,6 +78,17 @@ namespace labstor {
     const Error FAILED_TO_SET_NAMESPACE_KEY(512, "Failed to insert {} into the namespace");
     const Error SPDK_CANT_CREATE_QP(513, "Failed to allocate queue {}");
     const Error SPDK_CANT_RESET_ZONE(513, "Failed to reset zone");
+    const Error INVALID_WORKER_ROLE(514, "{} is not a valid worker role (latency, throughput, general)");
+    const Error QUEUE_ALLOC_FAILED(515, "Not enough queue memory for a queue of depth {}");
+    const Error IPC_MANAGER_CANT_UNREGISTER_QP(516, "IPCManager failed to unregister qp {}");
+    const Error IPC_MANAGER_OUT_OF_IPC_IDS(517, "Cannot connect pid {}: all {} IPC ids are in use");
+    const Error NAMESPACE_TABLE_FULL(518, "The namespace cannot hold more than {} modules");
+    const Error STATE_LAYOUT_MISMATCH(519, "State {} of ns_id {} has layout version {}, but version {} was requested without a migration");
+    const Error LABSTACK_INVALID(520, "LabStack {} is invalid: {}");
+    const Error UNKNOWN_WORKER_GROUP(521, "No server worker belongs to group {}");
+    const Error AUTO_TUNE_INVALID(522, "Cannot auto-tune the configuration: {}");
+    const Error MODULE_ID_MISMATCH(523, "{} provides module {}, but module {} was expected");
+    const Error CLOCK_PAGE_PROTECT_FAILED(524, "Could not map the clock page read-only: {}");
 
     const Error FAILED_TO_ENQUEUE(508, "Failed to enqueue a request");
     const Error FAILED_TO_DEQUEUE(509, "Failed to enqueue a request");
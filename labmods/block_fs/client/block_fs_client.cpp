@@ -80,7 +80,7 @@ ssize_t labstor::BlockFS::Client::IO(labstor::GenericPosix::Ops op, int fd, void
     labstor::queue_pair *qp;
     labstor::ipc::qtok_t qtok;
     ssize_t ret;
-    qtok = AIO(op, fd, buf, size);
+    qtok = AIO(op, fd, buf, off, size);
     client_rq = ipc_manager_->Wait<labstor::GenericPosix::io_request>(qtok);
     ret = client_rq->GetSize();
     ipc_manager_->FreeRequest<labstor::GenericPosix::io_request>(qtok, client_rq);
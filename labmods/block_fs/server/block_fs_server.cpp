@@ -28,6 +28,7 @@
 #include <labmods/block_fs/block_fs.h>
 #include <labmods/block_fs/server/block_fs_server.h>
 #include <labmods/generic_block/generic_block.h>
+#include <labstor/userspace/server/dispatch.h>
 #include <list>
 
 bool labstor::BlockFS::Server::ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) {
@@ -67,21 +68,22 @@ inline bool labstor::BlockFS::Server::Close(labstor::queue_pair *qp, labstor::Ge
 inline bool labstor::BlockFS::Server::IO(labstor::queue_pair *qp, labstor::GenericPosix::io_request *client_rq, labstor::credentials *creds) {
     labstor::GenericBlock::io_request *block_rq;
     labstor::queue_pair *priv_qp;
-
-    int i = 0;
     char *buf = reinterpret_cast<char*>(client_rq->buf_);
-    size_t total_io = client_rq->size_;
-    int num_blocks = (total_io/SMALL_BLOCK_SIZE) + 1;
-    labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[num_blocks];
 
     switch(client_rq->GetCode()) {
         //Divide I/O into blocks
         case 0: {
-            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
+            labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[1];
+            uint32_t next_module = namespace_->GetNextHop(GetNamespaceID(), next_module_);
+            ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE_DEFAULT, namespace_->GetQueueType(next_module));
             block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
-            block_rq->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), client_rq->off_, client_rq->size_, buf);
-            priv_qp->Enqueue(block_rq, qtoks[i]);
-            client_rq->SetQtoks(i, qtoks);
+            block_rq->Start(next_module, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), client_rq->off_, client_rq->size_, buf);
+            if(labstor::Server::Dispatch(priv_qp, block_rq, qtoks[0], creds)) {
+                ipc_manager_->FreeRequest(priv_qp, block_rq);
+                delete [] qtoks;
+                return true;
+            }
+            client_rq->SetQtoks(1, qtoks);
             client_rq->SetCode(1);
             return false;
         }
@@ -93,8 +95,10 @@ inline bool labstor::BlockFS::Server::IO(labstor::queue_pair *qp, labstor::Gener
                 if(!priv_qp->IsComplete(client_rq->qtoks_[i], block_rq)) {
                     return  false;
                 }
+                ipc_manager_->FreeRequest(priv_qp, block_rq);
                 ++client_rq->cur_qtok_;
             }
+            delete [] client_rq->qtoks_;
             return true;
         }
     }
@@ -41,6 +41,7 @@ struct io_request : public labstor::ipc::request {
     size_t off_;
     size_t size_;
     void *buf_;
+    labstor::ipc::qtok_t qtok_;
 
     inline void Start(int ns_id, Ops op, size_t off, size_t size, void *buf) {
         op_ = static_cast<int>(op);
@@ -60,76 +60,77 @@ int labstor::GenericPosix::Client::Open(const char *path, int oflag) {
     }
 
     //Determine the module belonging to the path
-    int len = strlen(path);
-    uint32_t ns_id;
+    uint32_t ns_id, len;
     labstor::Posix::Client *module;
-    while(len > 0) {
-        labstor::ipc::string path_str(std::string(path, len));
-        TRACEPOINT(std::string(path, len))
-        if(namespace_->GetNamespaceID(path_str, ns_id)) {
-            TRACEPOINT("FOUND IT!")
-            module = namespace_->GetModule<labstor::Posix::Client>(ns_id);
-            if(module == nullptr) {
-                module = namespace_->LoadClientModule<labstor::Posix::Client>(ns_id);
-            }
-            break;
-        }
-        len = PriorSlash(path, len);
-    }
-    if(len == 0) {
+    if(!namespace_->ResolveMountPoint(path, strlen(path), ns_id, len)) {
         return LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
     }
+    TRACEPOINT("Mount point", std::string(path, len), ns_id)
+    module = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    if(module == nullptr) {
+        module = namespace_->LoadClientModule<labstor::Posix::Client>(ns_id);
+    }
 
-    //Allocate an fd & track which module the fd belongs to
+    //Allocate an fd and call the client's implementation of open()
     fd = AllocateFD();
-    fd_to_ns_id_.emplace(fd, ns_id);
     TRACEPOINT("FD", fd)
+    int ret = module->Open(fd, path, len, oflag);
+    if(ret < 0) {
+        FreeFD(fd);
+        return ret;
+    }
 
-    //Call the client's implementation of open()
-    fd = module->Open(fd, path, len, oflag);
+    //Track which module the fd belongs to
+    fd_table_.Install(fd, module, ns_id, oflag);
     return fd;
 }
 
 int labstor::GenericPosix::Client::Close(int fd) {
-    if(fd < fd_min_) { return LABSTOR_INVALID_FD; }
-    int ns_id = fd_to_ns_id_[fd];
-    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    labstor::Posix::Client *client = fd_table_.Remove(fd);
+    if(client == nullptr) { return LABSTOR_GENERIC_FS_INVALID_FD; }
     client->Close(fd);
-    fd_to_ns_id_.erase(fd);
     FreeFD(fd);
     return 0;
 }
 
 labstor::ipc::qtok_t labstor::GenericPosix::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return labstor::ipc::qtok_t(); }
-    uint32_t ns_id = fd_to_ns_id_[fd];
-    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
-    return client->AIO(op, fd, buf, off, size);
+    labstor::GenericPosix::FDEntry *entry = fd_table_.Acquire(fd);
+    if(entry == nullptr) { return labstor::ipc::qtok_t(); }
+    labstor::ipc::qtok_t qtok = entry->module_.load(std::memory_order_relaxed)->AIO(op, fd, buf, off, size);
+    fd_table_.Release(entry);
+    return qtok;
 }
 
 labstor::ipc::qtok_t labstor::GenericPosix::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return labstor::ipc::qtok_t(); }
-    uint32_t ns_id = fd_to_ns_id_[fd];
-    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
-    return client->AIO(op, fd, buf, size);
+    labstor::GenericPosix::FDEntry *entry = fd_table_.Acquire(fd);
+    if(entry == nullptr) { return labstor::ipc::qtok_t(); }
+    //The transfer size is unknown until completion, so the full request is reserved
+    size_t off = entry->ReserveOffset(size);
+    labstor::ipc::qtok_t qtok = entry->module_.load(std::memory_order_relaxed)->AIO(op, fd, buf, off, size);
+    fd_table_.Release(entry);
+    return qtok;
 }
 
 ssize_t labstor::GenericPosix::Client::IO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return -1; }
-    uint32_t ns_id = fd_to_ns_id_[fd];
-    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
-    return client->IO(op, fd, buf, off, size);
+    labstor::GenericPosix::FDEntry *entry = fd_table_.Acquire(fd);
+    if(entry == nullptr) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    ssize_t ret = entry->module_.load(std::memory_order_relaxed)->IO(op, fd, buf, off, size);
+    fd_table_.Release(entry);
+    return ret;
 }
 
 ssize_t labstor::GenericPosix::Client::IO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return -1; }
-    uint32_t ns_id = fd_to_ns_id_[fd];
-    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
-    return client->IO(op, fd, buf, size);
+    labstor::GenericPosix::FDEntry *entry = fd_table_.Acquire(fd);
+    if(entry == nullptr) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    size_t off = entry->ReserveOffset(size);
+    ssize_t ret = entry->module_.load(std::memory_order_relaxed)->IO(op, fd, buf, off, size);
+    entry->CommitOffset(off, size, ret);
+    fd_table_.Release(entry);
+    return ret;
 }
 
 LABSTOR_MODULE_CONSTRUCT(labstor::GenericPosix::Client, GENERIC_POSIX_MODULE_ID);
\ No newline at end of file
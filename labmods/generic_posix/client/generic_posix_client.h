@@ -36,7 +36,9 @@
 #include <labstor/userspace/client/ipc_manager.h>
 #include <labstor/userspace/client/namespace.h>
 #include <labstor/userspace/util/error.h>
+#include <labmods/generic_posix/lib/posix_client.h>
 #include <mutex>
+#include <atomic>
 
 //TODO: Make this configurable
 #define LABSTOR_FD_MIN 50000
@@ -67,6 +69,7 @@ struct FDAllocator {
         if(fd >= min_fd_ + max_fds_) {
             throw TOO_MANY_FDS.format();
         }
+        ++alloced_fds_;
         return fd;
     }
     void Free(int fd) {
@@ -74,6 +77,85 @@ struct FDAllocator {
     }
 };
 
+/*
+ * An open LabStor file. The entry holds one reference while the file is open and one for
+ * every call using it, so Close can wait for concurrent I/O on the fd before tearing it down.
+ * */
+struct FDEntry {
+    std::atomic<labstor::Posix::Client*> module_;
+    std::atomic<uint32_t> refs_;
+    std::atomic<size_t> off_;
+    uint32_t ns_id_;
+    int flags_;
+    FDEntry() : module_(nullptr), refs_(0), off_(0), ns_id_(0), flags_(0) {}
+
+    /*Reserve size bytes at the file offset so threads sharing the fd don't overlap*/
+    inline size_t ReserveOffset(ssize_t size) {
+        return off_.fetch_add(size, std::memory_order_relaxed);
+    }
+    /*
+     * Move the offset to the end of the bytes actually transferred. The unused part of the
+     * reservation is only returned if no later call has reserved past it.
+     * */
+    inline void CommitOffset(size_t off, ssize_t size, ssize_t transferred) {
+        size_t reserved = off + size;
+        if(transferred >= size) { return; }
+        off_.compare_exchange_strong(reserved, off + (transferred > 0 ? transferred : 0), std::memory_order_relaxed);
+    }
+};
+
+class FDTable {
+private:
+    FDEntry *entries_;
+    int fd_min_, num_fds_;
+public:
+    FDTable(int fd_min, int num_fds) : fd_min_(fd_min), num_fds_(num_fds) {
+        entries_ = new FDEntry[num_fds];
+    }
+    ~FDTable() {
+        delete [] entries_;
+    }
+    inline bool IsLabStorFD(int fd) {
+        return fd_min_ <= fd && fd < fd_min_ + num_fds_;
+    }
+    inline void Install(int fd, labstor::Posix::Client *module, uint32_t ns_id, int flags) {
+        FDEntry &entry = entries_[fd - fd_min_];
+        entry.ns_id_ = ns_id;
+        entry.flags_ = flags;
+        entry.off_.store(0, std::memory_order_relaxed);
+        entry.refs_.fetch_add(1, std::memory_order_relaxed);
+        entry.module_.store(module, std::memory_order_release);
+    }
+    inline FDEntry* Acquire(int fd) {
+        if(!IsLabStorFD(fd)) { return nullptr; }
+        FDEntry &entry = entries_[fd - fd_min_];
+        if(entry.module_.load(std::memory_order_acquire) == nullptr) { return nullptr; }
+        //Store-then-load against Remove's exchange-then-load, which only seq_cst orders
+        entry.refs_.fetch_add(1, std::memory_order_seq_cst);
+        //The fd may have been closed between the check and the reference
+        if(entry.module_.load(std::memory_order_seq_cst) == nullptr) {
+            Release(&entry);
+            return nullptr;
+        }
+        return &entry;
+    }
+    inline void Release(FDEntry *entry) {
+        entry->refs_.fetch_sub(1, std::memory_order_release);
+    }
+    inline labstor::Posix::Client* Remove(int fd) {
+        if(!IsLabStorFD(fd)) { return nullptr; }
+        FDEntry &entry = entries_[fd - fd_min_];
+        labstor::Posix::Client *module = entry.module_.exchange(nullptr, std::memory_order_seq_cst);
+        if(module == nullptr) { return nullptr; }
+        //Drop the open reference and wait for in-flight calls on the fd
+        Release(&entry);
+        while(entry.refs_.load(std::memory_order_seq_cst) != 0) {
+            LABSTOR_YIELD();
+        }
+        return module;
+    }
+};
+
 class Client : public labstor::Module {
 private:
     LABSTOR_IPC_MANAGER_T ipc_manager_;
@@ -83,9 +165,10 @@ private:
     int fd_min_;
     std::string prefix_;
     std::vector<FDAllocator> fds_;
-    std::unordered_map<int, uint32_t> fd_to_ns_id_;
+    FDTable fd_table_;
 public:
-    Client() : labstor::Module(GENERIC_POSIX_MODULE_ID) {
+    Client() : labstor::Module(GENERIC_POSIX_MODULE_ID),
+               fd_table_(LABSTOR_FD_MIN, LABSTOR_IPC_MANAGER->GetNumCPU()*LABSTOR_MAX_FDS_PER_THREAD) {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
         namespace_ = LABSTOR_NAMESPACE;
         is_initialized_ = false;
@@ -93,8 +176,8 @@ public:
         char *region = (char*)malloc( fd_alloc_size * ipc_manager_->GetNumCPU());
         fds_.reserve(ipc_manager_->GetNumCPU());
         for(int i = 0; i < ipc_manager_->GetNumCPU(); ++i) {
-            region += fd_alloc_size;
             fds_.emplace_back(LABSTOR_FD_MIN + i*LABSTOR_MAX_FDS_PER_THREAD, region, fd_alloc_size, LABSTOR_MAX_FDS_PER_THREAD);
+            region += fd_alloc_size;
         }
     }
     void Register(YAML::Node config) override;
@@ -28,6 +28,7 @@
 #include <labmods/labstor_fs/labstor_fs.h>
 #include <labmods/labstor_fs/server/labstor_fs_server.h>
 #include <labmods/generic_block/generic_block.h>
+#include <labstor/userspace/server/dispatch.h>
 #include <list>
 
 bool labstor::LabFS::Server::ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) {
@@ -112,7 +113,8 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
     char *buf = reinterpret_cast<char*>(client_rq->buf_);
     size_t total_io = client_rq->size_;
     int num_blocks = (total_io/SMALL_BLOCK_SIZE) + 1;
-    labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[num_blocks];
+    labstor::ipc::qtok_t *qtoks;
+    uint32_t next_module;
 
     //For a read, we must identify the set of blocks
     //For a write, we must allocate new blocks
@@ -120,8 +122,10 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
     switch(client_rq->GetCode()) {
         //Divide I/O into blocks
         case 0: {
-            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
-            for (size_t cur_io = 0; cur_io < total_io; ++i) {
+            qtoks = new labstor::ipc::qtok_t[num_blocks];
+            next_module = namespace_->GetNextHop(GetNamespaceID(), next_module_);
+            ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE_DEFAULT, namespace_->GetQueueType(next_module));
+            for (size_t cur_io = 0; cur_io < total_io;) {
                 size_t io_size = (total_io - cur_io < LARGE_BLOCK_SIZE) ? SMALL_BLOCK_SIZE : LARGE_BLOCK_SIZE;
                 switch(static_cast<labstor::GenericPosix::Ops>(client_rq->op_)) {
                     case labstor::GenericPosix::Ops::kWrite: {
@@ -133,10 +137,21 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
                     }
                 }
                 block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
-                block_rq->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), block.off_, block.size_, buf);
-                priv_qp->Enqueue(block_rq, qtoks[i]);
+                block_rq->Start(next_module, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), block.off_, block.size_, buf);
+                //Blocks completed inline are committed now; the rest are waited on below
+                if(labstor::Server::Dispatch(priv_qp, block_rq, qtoks[i], creds)) {
+                    log_.GetCoreLog().LogModify(block_rq);
+                    ipc_manager_->FreeRequest(priv_qp, block_rq);
+                } else {
+                    ++i;
+                }
+                cur_io += io_size;
                 buf += io_size;
             }
+            if(i == 0) {
+                delete [] qtoks;
+                return true;
+            }
             client_rq->SetQtoks(i, qtoks);
             client_rq->SetCode(1);
             return false;
@@ -150,8 +165,10 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
                     return  false;
                 }
                 log_.GetCoreLog().LogModify(block_rq);
+                ipc_manager_->FreeRequest(priv_qp, block_rq);
                 ++client_rq->cur_qtok_;
             }
+            delete [] client_rq->qtoks_;
             return true;
         }
     }
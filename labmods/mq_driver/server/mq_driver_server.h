@@ -43,6 +43,7 @@ private:
 public:
     Server() : labstor::GenericQueue::Server(MQ_DRIVER_MODULE_ID) {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
+        inlinable_ = true;
     }
     bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds);
     bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override;
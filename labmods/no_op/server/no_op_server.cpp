@@ -29,6 +29,8 @@
 #include <labmods/generic_queue/generic_queue.h>
 #include <labmods/generic_queue/server/generic_queue_server.h>
 
+#include <labstor/userspace/server/dispatch.h>
+
 #include "no_op_server.h"
 
 bool labstor::iosched::NoOp::Server::ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) {
@@ -41,6 +43,11 @@ bool labstor::iosched::NoOp::Server::ProcessRequest(labstor::queue_pair *qp, lab
         case labstor::GenericBlock::Ops::kRead: {
             return IO(qp, reinterpret_cast<labstor::GenericBlock::io_request*>(request), creds);
         }
+        default: {
+            request->SetCode(LABSTOR_REQUEST_FAILED);
+            qp->Complete(request);
+            return true;
+        }
     }
 }
 
@@ -63,16 +70,49 @@ bool labstor::iosched::NoOp::Server::Initialize(labstor::queue_pair *qp, labstor
     queue_depth_ = stats_rq->queue_depth_;
     ipc_manager_->FreeRequest<labstor::GenericQueue::stats_request>(priv_qp, stats_rq);
     TRACEPOINT("num_hw_queues",num_hw_queues_,queue_depth_)
+    return true;
 }
 
 bool labstor::iosched::NoOp::Server::IO(labstor::queue_pair *qp, labstor::GenericBlock::io_request *client_rq, labstor::credentials *creds) {
     labstor::queue_pair *priv_qp;
     labstor::GenericQueue::io_request *rq;
-    int hctx = labstor::ThreadLocal::GetTid() % num_hw_queues_;
 
-    ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
-    rq = ipc_manager_->AllocRequest<labstor::GenericQueue::io_request>(priv_qp);
-    rq->Start(next_module_, client_rq->op_, client_rq->off_, client_rq->size_, client_rq->buf_, hctx);
+    switch(client_rq->GetCode()) {
+        //Forward the I/O to the driver, inline if it runs in this runtime
+        case 0: {
+            int hctx = labstor::ThreadLocal::GetTid() % num_hw_queues_;
+            uint32_t next_module = namespace_->GetNextHop(GetNamespaceID(), next_module_);
+            ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE_DEFAULT, namespace_->GetQueueType(next_module));
+            rq = ipc_manager_->AllocRequest<labstor::GenericQueue::io_request>(priv_qp);
+            rq->Start(next_module, client_rq->op_, client_rq->off_, client_rq->size_, client_rq->buf_, hctx);
+            if(!labstor::Server::Dispatch(priv_qp, rq, client_rq->qtok_, creds)) {
+                client_rq->SetCode(1);
+                return false;
+            }
+            break;
+        }
+
+        //Wait for the driver to complete the I/O
+        case 1: {
+            ipc_manager_->GetQueuePair(priv_qp, client_rq->qtok_);
+            if(!priv_qp->IsComplete(client_rq->qtok_, rq)) {
+                return false;
+            }
+            break;
+        }
+
+        //The request's progress is corrupt
+        default: {
+            client_rq->SetCode(LABSTOR_REQUEST_FAILED);
+            qp->Complete(client_rq);
+            return true;
+        }
+    }
+
+    client_rq->SetCode(LABSTOR_REQUEST_SUCCESS);
+    ipc_manager_->FreeRequest<labstor::GenericQueue::io_request>(priv_qp, rq);
+    qp->Complete(client_rq);
+    return true;
 }
 
 LABSTOR_MODULE_CONSTRUCT(labstor::iosched::NoOp::Server, NO_OP_IOSCHED_MODULE_ID);
\ No newline at end of file
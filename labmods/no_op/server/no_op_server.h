@@ -47,6 +47,7 @@ public:
     Server() : labstor::Module(NO_OP_IOSCHED_MODULE_ID) {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
         namespace_ = LABSTOR_NAMESPACE;
+        inlinable_ = true;
     }
     bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds);
     bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override;
@@ -26,6 +26,7 @@
 
 #include "registrar.h"
 #include "registrar_client.h"
+#include <labstor/userspace/client/namespace.h>
 
 uint32_t labstor::Registrar::Client::GetNamespaceID(std::string key) {
     labstor::queue_pair *qp;
@@ -33,6 +34,12 @@ uint32_t labstor::Registrar::Client::GetNamespaceID(std::string key) {
     labstor::Registrar::namespace_id_request *rq;
     uint32_t ns_id;
 
+    //The key map is in shared memory, so most lookups need no round trip
+    ns_id = LABSTOR_NAMESPACE->GetNamespaceID(key);
+    if(ns_id != (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY) {
+        return ns_id;
+    }
+
     ipc_manager_->GetQueuePair(qp, 0);
     rq = ipc_manager_->AllocRequest<namespace_id_request>(qp);
     rq->GetNamespaceIDStart(key);
@@ -44,11 +51,33 @@ uint32_t labstor::Registrar::Client::GetNamespaceID(std::string key) {
 }
 
 int labstor::Registrar::Client::MountLabStack(std::string key, std::string yaml_path) {
-    return 0;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    labstor::Registrar::labstack_request *rq;
+
+    ipc_manager_->GetQueuePair(qp, 0);
+    rq = ipc_manager_->AllocRequest<labstack_request>(qp, sizeof(labstack_request) + yaml_path.size() + 1);
+    rq->MountLabStackStart(key, yaml_path);
+    qp->Enqueue(rq, qtok);
+    rq = ipc_manager_->Wait<labstack_request>(qtok);
+    int rc = rq->GetCode();
+    ipc_manager_->FreeRequest(qtok, rq);
+    return rc;
 }
 
 int labstor::Registrar::Client::UnmountLabStack(std::string key, std::string yaml_path) {
-    return 0;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    labstor::Registrar::labstack_request *rq;
+
+    ipc_manager_->GetQueuePair(qp, 0);
+    rq = ipc_manager_->AllocRequest<labstack_request>(qp, sizeof(labstack_request) + 1);
+    rq->UnmountLabStackStart(key);
+    qp->Enqueue(rq, qtok);
+    rq = ipc_manager_->Wait<labstack_request>(qtok);
+    int rc = rq->GetCode();
+    ipc_manager_->FreeRequest(qtok, rq);
+    return rc;
 }
 
 int labstor::Registrar::Client::PushUpgrade(std::string yaml_path) {
@@ -81,6 +110,22 @@ std::string labstor::Registrar::Client::GetModulePath(int ns_id) {
     return std::move(path);
 }
 
+uint64_t labstor::Registrar::Client::GetMissedDeadlines(uint32_t ns_id) {
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    labstor::Registrar::missed_deadlines_request *rq;
+    uint64_t num_missed;
+
+    ipc_manager_->GetQueuePair(qp, 0);
+    rq = ipc_manager_->AllocRequest<missed_deadlines_request>(qp);
+    rq->GetMissedDeadlinesStart(ns_id);
+    qp->Enqueue(rq, qtok);
+    rq = ipc_manager_->Wait<missed_deadlines_request>(qtok);
+    num_missed = rq->num_missed_;
+    ipc_manager_->FreeRequest(qtok, rq);
+    return num_missed;
+}
+
 void labstor::Registrar::Client::TerminateServer() {
     labstor::queue_pair *qp;
     labstor::ipc::qtok_t qtok;
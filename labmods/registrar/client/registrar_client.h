@@ -68,6 +68,8 @@ public:
     int MountLabStack(std::string key, std::string yaml_path);
     int UnmountLabStack(std::string key, std::string yaml_path);
     int PushUpgrade(std::string yaml_path);
+    /*The number of requests of ns_id the runtime ran past their deadline*/
+    uint64_t GetMissedDeadlines(uint32_t ns_id);
     void TerminateServer();
 };
 
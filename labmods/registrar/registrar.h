@@ -40,7 +40,10 @@ enum class Ops {
     kGetModulePath,
     kGetNamespaceId,
     kPushUpgrade,
+    kMountLabStack,
+    kUnmountLabStack,
     kTerminate,
+    kGetMissedDeadlines,
 };
 
 struct register_request : labstor::ipc::request {
@@ -92,13 +95,47 @@ struct upgrade_request : labstor::ipc::request {
     void PushUpgradeStart(const std::string &yaml_path) {
         ns_id_ = LABSTOR_REGISTRAR_ID;
         op_ = static_cast<int>(Ops::kPushUpgrade);
-        memcpy(yaml_path_, yaml_path.c_str(), yaml_path.size());
+        memcpy(yaml_path_, yaml_path.c_str(), yaml_path.size() + 1);
     }
     void PushUpgradeEnd() {
         SetCode(LABSTOR_REQUEST_SUCCESS);
     }
 };
 
+struct labstack_request : labstor::ipc::request {
+    labstor::id key_;
+    char yaml_path_[];
+    void MountLabStackStart(const std::string &key, const std::string &yaml_path) {
+        ns_id_ = LABSTOR_REGISTRAR_ID;
+        op_ = static_cast<int>(Ops::kMountLabStack);
+        key_.copy(key);
+        memcpy(yaml_path_, yaml_path.c_str(), yaml_path.size() + 1);
+    }
+    void UnmountLabStackStart(const std::string &key) {
+        ns_id_ = LABSTOR_REGISTRAR_ID;
+        op_ = static_cast<int>(Ops::kUnmountLabStack);
+        key_.copy(key);
+        yaml_path_[0] = 0;
+    }
+    void LabStackEnd(uint32_t code) {
+        SetCode(code);
+    }
+};
+
+struct missed_deadlines_request : labstor::ipc::request {
+    uint32_t module_ns_id_;
+    uint64_t num_missed_;
+    void GetMissedDeadlinesStart(uint32_t ns_id) {
+        ns_id_ = LABSTOR_REGISTRAR_ID;
+        op_ = static_cast<int>(Ops::kGetMissedDeadlines);
+        module_ns_id_ = ns_id;
+    }
+    void GetMissedDeadlinesEnd(uint64_t num_missed) {
+        SetCode(LABSTOR_REQUEST_SUCCESS);
+        num_missed_ = num_missed;
+    }
+};
+
 struct terminate_request : labstor::ipc::request {
     void TerminateStart() {
         ns_id_ = LABSTOR_REGISTRAR_ID;
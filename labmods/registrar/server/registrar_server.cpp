@@ -56,7 +56,45 @@ bool labstor::Registrar::Server::ProcessRequest(labstor::queue_pair *qp, labstor
             return true;
         }
         case Ops::kPushUpgrade: {
-            module_manager_->PushUpgrade(reinterpret_cast<upgrade_request*>(request));
+            upgrade_request *rq = reinterpret_cast<upgrade_request *>(request);
+            module_manager_->PushUpgrade(rq->yaml_path_);
+            rq->PushUpgradeEnd();
+            qp->Complete<upgrade_request>(rq);
+            return true;
+        }
+        case Ops::kMountLabStack: {
+            labstack_request *rq = reinterpret_cast<labstack_request *>(request);
+            uint32_t code = LABSTOR_REQUEST_SUCCESS;
+            LABSTOR_ERROR_HANDLE_TRY {
+                namespace_->MountLabStack(YAML::LoadFile(rq->yaml_path_));
+            } LABSTOR_ERROR_HANDLE_CATCH {
+                LABSTOR_ERROR_PTR->print();
+                code = LABSTOR_REQUEST_FAILED;
+            } catch(YAML::Exception &e) {
+                printf("Failed to load LabStack %s: %s\n", rq->yaml_path_, e.what());
+                code = LABSTOR_REQUEST_FAILED;
+            }
+            rq->LabStackEnd(code);
+            qp->Complete<labstack_request>(rq);
+            return true;
+        }
+        case Ops::kUnmountLabStack: {
+            labstack_request *rq = reinterpret_cast<labstack_request *>(request);
+            labstor::ipc::string key(rq->key_.key_);
+            uint32_t ns_id = namespace_->GetNamespaceID(key);
+            if(ns_id == (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY) {
+                rq->LabStackEnd(LABSTOR_REQUEST_FAILED);
+            } else {
+                namespace_->UnmountLabStack(key, ns_id);
+                rq->LabStackEnd(LABSTOR_REQUEST_SUCCESS);
+            }
+            qp->Complete<labstack_request>(rq);
+            return true;
+        }
+        case Ops::kGetMissedDeadlines: {
+            missed_deadlines_request *rq = reinterpret_cast<missed_deadlines_request *>(request);
+            rq->GetMissedDeadlinesEnd(LABSTOR_WORK_ORCHESTRATOR->GetNumMissedDeadlines(rq->module_ns_id_));
+            qp->Complete<missed_deadlines_request>(rq);
             return true;
         }
         case Ops::kTerminate: {
@@ -34,6 +34,7 @@
 #include <labstor/userspace/server/module_manager.h>
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/server/namespace.h>
+#include <labstor/userspace/server/work_orchestrator.h>
 
 namespace labstor::Registrar {
 
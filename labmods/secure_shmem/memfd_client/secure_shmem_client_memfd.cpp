@@ -0,0 +1,124 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <atomic>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <labstor/constants/debug.h>
+#include "secure_shmem_client_memfd.h"
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB 0x0004U
+#endif
+
+void labstor::memfd::ShmemClient::SetHugePages(bool hugetlb, size_t huge_page_size) {
+    hugetlb_ = hugetlb;
+    page_size_ = hugetlb ? huge_page_size : getpagesize();
+}
+
+int labstor::memfd::ShmemClient::CreateShmem(size_t region_size, bool) {
+    AUTO_TRACE(region_size, (int)hugetlb_)
+    int flags = MFD_CLOEXEC | MFD_ALLOW_SEALING | (hugetlb_ ? MFD_HUGETLB : 0);
+    int fd = (int)syscall(SYS_memfd_create, "labstor", flags);
+    bool sealable = fd >= 0;
+    if(fd < 0 && errno == ENOSYS) {
+        fd = CreateShmOpen();
+    }
+    if(fd < 0) {
+        return -1;
+    }
+    if(ftruncate(fd, RoundUp(region_size)) < 0) {
+        close(fd);
+        return -1;
+    }
+    //Seals are unsupported on shm_open objects and on hugetlbfs before 4.16; those regions work without them.
+    //Otherwise an unsealed region could be truncated under the server, so refuse to hand it out.
+    if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        TRACEPOINT("Could not seal region", strerror(errno))
+        if(sealable && !(hugetlb_ && errno == EINVAL)) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int labstor::memfd::ShmemClient::CreateShmOpen() {
+    static std::atomic<uint32_t> count(0);
+    char name[64];
+    snprintf(name, sizeof(name), "/labstor.%d.%u", getpid(), count.fetch_add(1));
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if(fd >= 0) {
+        shm_unlink(name);
+    }
+    return fd;
+}
+
+int labstor::memfd::ShmemClient::FreeShmem(int region_id) {
+    return close(region_id);
+}
+
+void* labstor::memfd::ShmemClient::MapShmem(int region_id, size_t region_size) {
+    //The creator may have rounded the region up to its (huge) page size
+    struct stat st;
+    if(fstat(region_id, &st) < 0) {
+        return nullptr;
+    }
+    if((size_t)st.st_size > region_size) {
+        region_size = st.st_size;
+    }
+    void *data = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, region_id, 0);
+    if(data == MAP_FAILED) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(lock_);
+    mapped_[data] = region_size;
+    return data;
+}
+
+void labstor::memfd::ShmemClient::UnmapShmem(void *region, size_t region_size) {
+    //Unmap exactly what MapShmem mapped
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = mapped_.find(region);
+        if(iter != mapped_.end()) {
+            region_size = iter->second;
+            mapped_.erase(iter);
+        }
+    }
+    munmap(region, RoundUp(region_size));
+}
@@ -0,0 +1,69 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SECURE_SHMEM_MEMFD_H
+#define LABSTOR_SECURE_SHMEM_MEMFD_H
+
+#include <unistd.h>
+#include <mutex>
+#include <unordered_map>
+#include <labstor/userspace/types/shmem_provider.h>
+
+namespace labstor::memfd {
+
+/*
+ * Userspace regions backed by anonymous memfds (or unlinked shm_open objects when memfd_create
+ * is unavailable). The region id is the file descriptor, so granting access to another process
+ * means passing the fd over a UNIX socket; GrantPidShmem is a no-op. Regions are sealed against
+ * resizing so a client cannot truncate one out from under the server.
+ */
+class ShmemClient : public labstor::ShmemProvider {
+private:
+    bool hugetlb_;
+    size_t page_size_;
+    std::mutex lock_;
+    std::unordered_map<void*, size_t> mapped_; //Length of each mapping, which may exceed the size asked for
+public:
+    ShmemClient() : hugetlb_(false) {
+        page_size_ = getpagesize();
+    }
+    void SetHugePages(bool hugetlb, size_t huge_page_size);
+    int CreateShmem(size_t region_size, bool user_owned) override;
+    int GrantPidShmem(int, int) override { return 0; }
+    int FreeShmem(int region_id) override;
+    void *MapShmem(int region_id, size_t region_size) override;
+    void UnmapShmem(void *region, size_t region_size) override;
+    bool PassesFds() override { return true; }
+private:
+    inline size_t RoundUp(size_t region_size) {
+        return ((region_size + page_size_ - 1) / page_size_) * page_size_;
+    }
+    int CreateShmOpen();
+};
+
+}
+
+#endif //LABSTOR_SECURE_SHMEM_MEMFD_H
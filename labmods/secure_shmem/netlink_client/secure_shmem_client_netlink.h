@@ -29,12 +29,13 @@
 
 #include <labstor/kernel/client/macros.h>
 #include <labstor/kernel/client/kernel_client.h>
+#include <labstor/userspace/types/shmem_provider.h>
 
 #define SHMEM_CHRDEV "/dev/labstor_shared_shmem0"
 
 namespace labstor::kernel::netlink {
 
-class ShmemClient {
+class ShmemClient : public labstor::ShmemProvider {
 private:
     LABSTOR_KERNEL_CLIENT_T kernel_client_;
     int page_size_;
@@ -43,11 +44,11 @@ public:
         kernel_client_ = LABSTOR_KERNEL_CLIENT;
         page_size_ = getpagesize();
     }
-    int CreateShmem(size_t region_size, bool user_owned);
-    int GrantPidShmem(int pid, int region_id);
-    int FreeShmem(int region_id);
-    static void *MapShmem(int region_id, size_t region_size);
-    static void UnmapShmem(void *region, size_t region_size);
+    int CreateShmem(size_t region_size, bool user_owned) override;
+    int GrantPidShmem(int pid, int region_id) override;
+    int FreeShmem(int region_id) override;
+    void *MapShmem(int region_id, size_t region_size) override;
+    void UnmapShmem(void *region, size_t region_size) override;
 };
 
 }
@@ -37,6 +37,7 @@
 #include <labstor/userspace/client/ipc_manager.h>
 #include <labstor/userspace/client/namespace.h>
 #include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
+#include <labmods/secure_shmem/memfd_client/secure_shmem_client_memfd.h>
 #include <sys/sysinfo.h>
 
 void labstor::Client::IPCManager::Connect() {
@@ -87,23 +88,45 @@ void labstor::Client::IPCManager::Connect() {
     labstor::ipc::setup_reply reply;
     serversock_.RecvMSG(&reply, sizeof(reply));
     TRACEPOINT("Receive reply", "region_id", reply.region_id_, "region_size", reply.region_size_, "queue_size", reply.queue_region_size_, "queue_depth", reply.queue_depth_)
-    region = labstor::kernel::netlink::ShmemClient::MapShmem(reply.region_id_, reply.region_size_);
+    switch(static_cast<labstor::ShmemProviderType>(reply.shmem_provider_)) {
+        case labstor::ShmemProviderType::kKernel: {
+            shmem_ = LABSTOR_KERNEL_SHMEM_ALLOC;
+            break;
+        }
+        case labstor::ShmemProviderType::kMemfd: {
+            //The region ids in the reply are the server's fds; ours arrive with SCM_RIGHTS
+            int fds[2];
+            serversock_.RecvFDs(fds, 2);
+            reply.region_id_ = fds[0];
+            reply.namespace_region_id_ = fds[1];
+            shmem_ = new labstor::memfd::ShmemClient();
+            break;
+        }
+        default: {
+            throw INVALID_SHMEM_PROVIDER.format(std::to_string(reply.shmem_provider_));
+        }
+    }
+    region = shmem_->MapShmem(reply.region_id_, reply.region_size_);
+    if(!region) {
+        throw MMAP_FAILED.format(strerror(errno));
+    }
 
     //Receive and initialize namespace
-    LABSTOR_NAMESPACE->Attach(reply.namespace_region_id_, reply.namespace_region_size_);
+    LABSTOR_NAMESPACE->Attach(reply.namespace_region_id_, reply.namespace_region_size_, reply.namespace_max_entries_);
 
-    //Initialize SHMEM request allocator
+    //Attach SHMEM request allocator (the server initialized it before we connected)
     TRACEPOINT("Attach SHMEM allocator")
     labstor::ipc::shmem_allocator *shmem_alloc;
     shmem_alloc = new labstor::ipc::shmem_allocator();
-    shmem_alloc->Init(region, region, reply.request_region_size_, reply.request_unit_, n_cpu_);
+    shmem_alloc->Attach(region, region);
     SetShmemAlloc(shmem_alloc);
     TRACEPOINT("SHMEM allocator", (size_t)shmem_alloc->GetRegion())
 
-    //Initialize SHMEM queue allocator
+    //Initialize SHMEM queue allocator past the queues the server prebuilt
     labstor::segment_allocator *qp_alloc = new labstor::segment_allocator();
     qp_alloc->Attach(
-            LABSTOR_REGION_ADD(reply.request_region_size_, region), reply.queue_region_size_);
+            LABSTOR_REGION_ADD(reply.request_region_size_ + reply.GetPrebuiltRegionSize(), region),
+            reply.queue_region_size_ - reply.GetPrebuiltRegionSize());
     SetQueueAlloc(qp_alloc);
 
     //Initialize internal allocator
@@ -114,40 +137,61 @@ void labstor::Client::IPCManager::Connect() {
     SetPrivateAlloc(private_alloc);
     TRACEPOINT("Internal allocator", (size_t)private_alloc->GetRegion())
 
-    //Create the SHMEM queues
-    TRACEPOINT("Create SHMEM queues")
-    CreateQueuesSHMEM(reply.num_queues_, reply.queue_depth_);
+    //Attach the shared SHMEM queue. The other prebuilt queues are attached when a thread claims one.
+    TRACEPOINT("Attach SHMEM queues")
+    setup_ = reply;
+    queue_depth_ = reply.queue_depth_;
+    ipc_id_ = reply.ipc_id_;
+    max_queues_ = reply.max_queues_;
+    ReserveQueues(0, LABSTOR_QP_CLIENT_DEFAULT, max_queues_);
+    AttachPrebuiltQueuePair(0)->MarkShared();
+    next_prebuilt_ = 1;
     CreatePrivateQueues(n_cpu_, reply.queue_depth_);
 
     //Mark as connected
     is_connected_ = true;
 }
 
-void labstor::Client::IPCManager::CreateQueuesSHMEM(int num_queues, int depth) {
-    AUTO_TRACE("")
-    labstor::ipc::register_qp_request request(num_queues);
-    labstor::ipc::register_qp_reply reply;
-    labstor::ipc::queue_pair_ptr *qps = (labstor::ipc::queue_pair_ptr *)malloc(request.GetQueueArrayLength());
+labstor::ipc::shmem_queue_pair* labstor::Client::IPCManager::AttachPrebuiltQueuePair(uint32_t i) {
+    AUTO_TRACE(i)
+    labstor::ipc::queue_pair_ptr ptr;
+    setup_.GetPrebuiltQueuePointer(i, pid_, ptr);
+    labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
+    qp->Attach(ptr, GetRegion(LABSTOR_QP_SHMEM));
+    RegisterQueuePair(qp);
+    return qp;
+}
+
+labstor::ipc::shmem_queue_pair* labstor::Client::IPCManager::AllocQueuePair(labstor::ipc::qid_t qid, uint32_t depth) {
     uint32_t request_queue_size = labstor::ipc::request_queue::GetSize(depth);
     uint32_t request_map_size = labstor::ipc::request_map::GetSize(depth);
+    void *sq_region = AllocShmemQueue(request_queue_size);
+    if(!sq_region) {
+        return nullptr;
+    }
+    void *cq_region = AllocShmemQueue(request_map_size);
+    if(!cq_region) {
+        FreeShmemQueue(sq_region, request_queue_size);
+        return nullptr;
+    }
+    labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
+    qp->Init(qid, GetRegion(LABSTOR_QP_SHMEM), sq_region, request_queue_size, cq_region, request_map_size);
+    return qp;
+}
 
-    //Allocate SHMEM queues for the client
-    ReserveQueues(0, LABSTOR_QP_SHMEM, num_queues);
-    for(int i = 0; i < num_queues; ++i) {
-        labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
-                0,
-                LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY,
-                i,
-                num_queues,
-                pid_);
-        void *sq_region = AllocShmemQueue(request_queue_size);
-        void *cq_region = AllocShmemQueue(request_map_size);
-        TRACEPOINT("Creating queue", i, qid.Hash());
-        qp->Init(qid, GetRegion(LABSTOR_QP_SHMEM), sq_region, request_queue_size, cq_region, request_map_size);
-        RegisterQueuePair(qp);
-        qp->GetPointer(qps[i], GetRegion(LABSTOR_QP_SHMEM));
-        TRACEPOINT("Created queue", i, qid.Hash());
+void labstor::Client::IPCManager::FreeQueuePair(labstor::ipc::shmem_queue_pair *qp) {
+    FreeShmemQueue(labstor_request_queue_GetRegion(&qp->sq_), labstor_request_queue_GetSize(&qp->sq_));
+    FreeShmemQueue(labstor_request_map_GetRegion(&qp->cq_), labstor_request_map_GetSize(&qp->cq_));
+    delete qp;
+}
+
+bool labstor::Client::IPCManager::SendRegisterQueuePairs(std::vector<labstor::ipc::shmem_queue_pair*> &new_qps) {
+    AUTO_TRACE(new_qps.size())
+    labstor::ipc::register_qp_request request(new_qps.size());
+    labstor::ipc::register_qp_reply reply;
+    labstor::ipc::queue_pair_ptr *qps = (labstor::ipc::queue_pair_ptr *)malloc(request.GetQueueArrayLength());
+    for(size_t i = 0; i < new_qps.size(); ++i) {
+        new_qps[i]->GetPointer(qps[i], GetRegion(LABSTOR_QP_SHMEM));
     }
 
     //Send an IPC request to the server
@@ -157,25 +201,198 @@ void labstor::Client::IPCManager::CreateQueuesSHMEM(int num_queues, int depth) {
     //Receive SHMEM IPCs
     serversock_.RecvMSG((void*)&reply, sizeof(labstor::ipc::register_qp_reply));
     free(qps);
+    if(reply.code_ != 0) {
+        for(auto qp : new_qps) { FreeQueuePair(qp); }
+        return false;
+    }
+    return true;
+}
+
+bool labstor::Client::IPCManager::CreateQueuesSHMEM(labstor_qid_flags_t flags, int num_queues, int depth) {
+    AUTO_TRACE(flags, num_queues)
+    std::vector<labstor::ipc::shmem_queue_pair*> new_qps;
+    new_qps.reserve(num_queues);
+
+    //Allocate SHMEM queues for the client
+    //The queue set grows at runtime, so reserve the maximum to keep existing pointers valid
+    ReserveQueues(0, flags, max_queues_);
+    int first = GetNumQueuePairs(0, flags);
+    for(int i = 0; i < num_queues; ++i) {
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
+                0,
+                flags,
+                first + i,
+                max_queues_,
+                pid_,
+                ipc_id_);
+        TRACEPOINT("Creating queue", first + i, qid.Hash());
+        labstor::ipc::shmem_queue_pair *qp = AllocQueuePair(qid, depth);
+        if(!qp) {
+            break;
+        }
+        new_qps.emplace_back(qp);
+    }
+    if(new_qps.empty() || !SendRegisterQueuePairs(new_qps)) {
+        return false;
+    }
+
+    //Only make the queues visible once the server polls them
+    for(auto qp : new_qps) {
+        if(qp->GetQID().cnt_ == 0) {
+            qp->MarkShared();
+        } else {
+            free_qps_[flags].emplace_back(qp);
+        }
+        RegisterQueuePair(qp);
+    }
+    return true;
+}
+
+labstor::ipc::shmem_queue_pair* labstor::Client::IPCManager::CreateQueuePair(labstor_qid_flags_t flags, uint32_t depth) {
+    AUTO_TRACE(flags, depth)
+    if(!LABSTOR_QP_IS_SHMEM(flags)) {
+        throw INVALID_QP_FLAGS.format(flags);
+    }
+    std::lock_guard<std::mutex> lock(qp_lock_);
+    ReserveQueues(0, flags, max_queues_);
+    //Slots of prebuilt queues stay reserved even before they are attached
+    int cnt = GetFreeQueueSlot(0, flags, flags == LABSTOR_QP_CLIENT_DEFAULT ? setup_.num_queues_ : 0);
+    if((uint32_t)cnt >= max_queues_) {
+        throw INVALID_QP_CNT.format(cnt);
+    }
+    labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, cnt, max_queues_, pid_, ipc_id_);
+    labstor::ipc::shmem_queue_pair *qp = AllocQueuePair(qid, depth);
+    if(!qp) {
+        throw QUEUE_ALLOC_FAILED.format(depth);
+    }
+    std::vector<labstor::ipc::shmem_queue_pair*> new_qps = {qp};
+    if(!SendRegisterQueuePairs(new_qps)) {
+        throw IPC_MANAGER_CANT_REGISTER_QP.format();
+    }
+    RegisterQueuePair(qp);
+    return qp;
+}
+
+void labstor::Client::IPCManager::DestroyQueuePair(labstor::ipc::shmem_queue_pair *qp) {
+    AUTO_TRACE(qp->GetQID().Hash())
+    //Drain: every request must have been dequeued by the server.
+    //The caller must already have waited on the requests it submitted.
+    while(qp->GetDepth()) {
+        LABSTOR_YIELD();
+    }
+    std::lock_guard<std::mutex> lock(qp_lock_);
+
+    //Detach: the server stops polling the queue and forgets it
+    labstor::ipc::unregister_qp_request request(qp->GetQID());
+    labstor::ipc::unregister_qp_reply reply;
+    serversock_.SendMSG((void*)&request, sizeof(labstor::ipc::unregister_qp_request));
+    serversock_.RecvMSG((void*)&reply, sizeof(labstor::ipc::unregister_qp_reply));
+    if(reply.code_ != 0) {
+        throw IPC_MANAGER_CANT_UNREGISTER_QP.format(qp->GetQID().Hash());
+    }
+
+    //Free: the queue memory is reused by the next queue of the same depth
+    UnregisterQueuePair(qp);
+    FreeQueuePair(qp);
 }
 
 void labstor::Client::IPCManager::CreatePrivateQueues(int num_queues, int queue_size) {
     AUTO_TRACE("")
+    labstor_qid_flags_t flags = LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY;
+    ReserveQueues(0, flags, num_queues);
     for(int i = 0; i < num_queues; ++i) {
         labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
         labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
                 0,
-                LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY,
+                flags,
                 i,
                 num_queues,
-                pid_);
+                pid_,
+                ipc_id_);
         void *sq_region = AllocPrivateQueue(queue_size);
         void *cq_region = AllocPrivateQueue(queue_size);
         qp->Init(qid, GetRegion(LABSTOR_QP_PRIVATE), sq_region, queue_size, cq_region, queue_size);
+        if(i == 0) {
+            qp->MarkShared();
+        } else {
+            free_qps_[flags].emplace_back(qp);
+        }
         RegisterQueuePair(qp);
     }
 }
 
+labstor::queue_pair* labstor::Client::IPCManager::ClaimQueuePair(labstor_qid_flags_t flags) {
+    AUTO_TRACE(flags)
+    std::lock_guard<std::mutex> lock(qp_lock_);
+    auto &free_qps = free_qps_[flags];
+    //Use up the queues the server prebuilt before asking it for more
+    if(free_qps.empty() && flags == LABSTOR_QP_CLIENT_DEFAULT && next_prebuilt_ < setup_.num_queues_) {
+        free_qps.emplace_back(AttachPrebuiltQueuePair(next_prebuilt_++));
+    }
+    //Grow the SHMEM queue set by doubling it, up to the limit the server gave us.
+    //The first claim under other flags creates that set's shared queue 0 and one dedicated queue.
+    if(free_qps.empty() && LABSTOR_QP_IS_SHMEM(flags) && LABSTOR_QP_IS_PRIMARY(flags)) {
+        int num_qps = GetNumQueuePairs(0, flags);
+        int num_new = std::min<int>(num_qps ? num_qps : 2, (int)max_queues_ - num_qps);
+        if(num_new > 0 && !CreateQueuesSHMEM(flags, num_new, queue_depth_) && !num_qps) {
+            throw IPC_MANAGER_CANT_REGISTER_QP.format();
+        }
+    }
+    labstor::queue_pair *qp;
+    if(free_qps.empty()) {
+        //Only SHMEM primary queue sets are created on demand
+        if(GetNumQueuePairs(0, flags) == 0) {
+            throw INVALID_QP_FLAGS.format(flags);
+        }
+        //Every dedicated queue is taken, so producers share the MPSC queue
+        TRACEPOINT("Falling back to shared queue", flags)
+        GetSharedQueuePair(qp, flags);
+        if(!static_cast<labstor::ipc::shmem_queue_pair*>(qp)->IsShared()) {
+            throw INVALID_QP_QUERY.format(pid_, 0, flags, 0);
+        }
+        return qp;
+    }
+    qp = free_qps.back();
+    free_qps.pop_back();
+    return qp;
+}
+
+labstor::queue_pair* labstor::Client::IPCManager::ClaimNamedQueuePair(labstor_qid_flags_t flags, uint32_t slot) {
+    AUTO_TRACE(flags, slot)
+    //The claimed queue has no owner yet, so it can be made shared before any thread sees it
+    labstor::queue_pair *qp = ClaimQueuePair(flags);
+    labstor::queue_pair *named_qp;
+    {
+        std::lock_guard<std::mutex> lock(qp_lock_);
+        named_qp = named_qps_[flags][slot].load(std::memory_order_relaxed);
+        if(!named_qp) {
+            static_cast<labstor::ipc::shmem_queue_pair*>(qp)->MarkShared();
+            named_qps_[flags][slot].store(qp, std::memory_order_release);
+            return qp;
+        }
+    }
+    //Another thread named this slot first
+    ReleaseQueuePair(qp);
+    return named_qp;
+}
+
+void labstor::Client::IPCManager::ReleaseQueuePair(labstor::queue_pair *qp) {
+    AUTO_TRACE("")
+    if(qp->GetQID().cnt_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(qp_lock_);
+    free_qps_[qp->GetQID().flags_].emplace_back(qp);
+}
+
+labstor::Client::QueueClaim::~QueueClaim() {
+    for(auto qp : qps_) {
+        if(qp) {
+            LABSTOR_IPC_MANAGER->ReleaseQueuePair(qp);
+        }
+    }
+}
+
 void labstor::Client::IPCManager::PauseQueues() {
 }
 
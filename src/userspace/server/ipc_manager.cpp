@@ -38,16 +38,41 @@
 #include <labstor/userspace/types/messages.h>
 #include <labmods/ipc_manager/netlink_client/ipc_manager_client_netlink.h>
 #include <labmods/work_orchestrator/netlink_client/work_orchestrator_client_netlink.h>
+#include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
+#include <labmods/secure_shmem/memfd_client/secure_shmem_client_memfd.h>
 
 LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
 
 void labstor::Server::IPCManager::LoadMemoryConfig(std::string pid_type, MemoryConfig &memconf) {
+    //The auto-tuner may resize the queues of clients that connect from now on
+    uint32_t queue_depth = 0;
+    if(pid_type == "client") {
+        queue_depth = client_queue_depth_.load(std::memory_order_acquire);
+    }
+    LoadMemoryConfig(pid_type, memconf, queue_depth);
+}
+
+void labstor::Server::IPCManager::LoadMemoryConfig(std::string pid_type, MemoryConfig &memconf, uint32_t queue_depth) {
     memconf.region_size = labstor_config_->config_["ipc_manager"][pid_type]["max_region_size_kb"].as<uint32_t>() * SizeType::KB;
     memconf.request_unit = labstor_config_->config_["ipc_manager"][pid_type]["request_unit_bytes"].as<uint32_t>() * SizeType::BYTES;
     memconf.min_request_region = labstor_config_->config_["ipc_manager"][pid_type]["min_request_region_kb"].as<uint32_t>() * SizeType::KB;
     memconf.queue_depth = labstor_config_->config_["ipc_manager"][pid_type]["queue_depth"].as<uint32_t>();
+    if(queue_depth) {
+        memconf.queue_depth = queue_depth;
+    }
     memconf.num_queues = labstor_config_->config_["ipc_manager"][pid_type]["num_queues"].as<uint32_t>();
-    memconf.queue_region_size = memconf.num_queues * labstor::ipc::shmem_queue_pair::GetSize(memconf.queue_depth);
+    memconf.max_queues = memconf.num_queues;
+    memconf.num_prepared_regions = 2;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["prepared_regions"]) {
+        memconf.num_prepared_regions = labstor_config_->config_["ipc_manager"][pid_type]["prepared_regions"].as<uint32_t>();
+    }
+    if(labstor_config_->config_["ipc_manager"][pid_type]["max_queues"]) {
+        memconf.max_queues = labstor_config_->config_["ipc_manager"][pid_type]["max_queues"].as<uint32_t>();
+    }
+    if(memconf.max_queues < memconf.num_queues) {
+        memconf.max_queues = memconf.num_queues;
+    }
+    memconf.queue_region_size = memconf.max_queues * labstor::ipc::shmem_queue_pair::GetSize(memconf.queue_depth);
     memconf.request_region_size = memconf.region_size - memconf.queue_region_size;
     if(memconf.queue_region_size >= memconf.region_size) {
         throw NOT_ENOUGH_REQUEST_MEMORY.format(pid_type,
@@ -63,6 +88,35 @@ void labstor::Server::IPCManager::LoadMemoryConfig(std::string pid_type, MemoryC
     memconf.request_map_size = labstor::ipc::request_map::GetSize(memconf.queue_depth);
 }
 
+void labstor::Server::IPCManager::InitShmemProvider() {
+    const auto &config = labstor_config_->config_["shmem"];
+    shmem_type_ = labstor::ShmemProviderType::kKernel;
+    if(config && config["provider"]) {
+        shmem_type_ = labstor::ShmemProvider::GetTypeFromString(config["provider"].as<std::string>());
+    }
+    if(labstor_config_->IsUserspaceOnly()) {
+        shmem_type_ = labstor::ShmemProviderType::kMemfd;
+    }
+    switch(shmem_type_) {
+        case labstor::ShmemProviderType::kKernel: {
+            shmem_ = LABSTOR_KERNEL_SHMEM_ALLOC;
+            break;
+        }
+        case labstor::ShmemProviderType::kMemfd: {
+            labstor::memfd::ShmemClient *memfd = new labstor::memfd::ShmemClient();
+            if(config && config["hugetlb"] && config["hugetlb"].as<bool>()) {
+                uint32_t huge_page_size = 2 * SizeType::MB;
+                if(config["huge_page_kb"]) {
+                    huge_page_size = config["huge_page_kb"].as<uint32_t>() * SizeType::KB;
+                }
+                memfd->SetHugePages(true, huge_page_size);
+            }
+            shmem_ = memfd;
+            break;
+        }
+    }
+}
+
 void labstor::Server::IPCManager::InitializeKernelIPCManager() {
     AUTO_TRACE("")
     MemoryConfig memconf;
@@ -71,7 +125,7 @@ void labstor::Server::IPCManager::InitializeKernelIPCManager() {
     //Create new IPC for the kernel
     PerProcessIPC *client_ipc = RegisterIPC(KERNEL_PID);
 
-    //Create SHMEM region
+    //Create SHMEM region (the kernel can only map regions from the kernel shmem provider)
     LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC;
     int region_id = shmem->CreateShmem(memconf.region_size, true);
     if(region_id < 0) {
@@ -112,7 +166,7 @@ void labstor::Server::IPCManager::CreateKernelQueues() {
     std::vector<labstor_assign_qp_request> assign_qp_vec;
 
     //Get Kernel IPC region
-    PerProcessIPC *client_ipc = pid_to_ipc_[KERNEL_PID];
+    PerProcessIPC *client_ipc = GetIPCByID(LABSTOR_KERNEL_IPC_ID);
 
     //Allocate & register SHMEM queues for the kernel
     LABSTOR_KERNEL_WORK_ORCHESTRATOR_T kernel_work_orchestrator = LABSTOR_KERNEL_WORK_ORCHESTRATOR;
@@ -126,7 +180,8 @@ void labstor::Server::IPCManager::CreateKernelQueues() {
                 LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY,
                 i,
                 memconf.num_queues,
-                KERNEL_PID);
+                KERNEL_PID,
+                LABSTOR_KERNEL_IPC_ID);
         void *sq_region = client_ipc->AllocShmemQueue(memconf.request_queue_size);
         void *cq_region = client_ipc->AllocShmemQueue(memconf.request_map_size);
         remote_qp->Init(qid, client_ipc->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.request_map_size);
@@ -177,17 +232,31 @@ void labstor::Server::IPCManager::CreatePrivateQueues() {
     client_ipc->SetQueueAlloc(qp_alloc);
 
     //Allocate & register PRIVATE intermediate streaming queues for modules to communicate internally
-    labstor_qid_flags_t flags = LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY;
-    client_ipc->ReserveQueues(0, flags, memconf.num_queues);
-    for(int i = 0; i < memconf.num_queues; ++i) {
+    labstor_qid_flags_t flags = LABSTOR_QP_PRIVATE_DEFAULT;
+    CreatePrivateQueuePairs(client_ipc, memconf, 0, flags, memconf.num_queues);
+
+    //Each worker group gets its own queue type, served only by the group's workers
+    for(auto &group : work_orchestrator_->GetWorkerGroups()) {
+        int type = client_ipc->RegisterQueuePairType("group:" + group.name_, LABSTOR_QP_ALL_FLAGS);
+        if(type != group.qp_type_) {
+            throw INVALID_QP_QUERY.format(pid_, type, flags, 0);
+        }
+        CreatePrivateQueuePairs(client_ipc, memconf, type, flags, group.workers_.size());
+    }
+}
+
+void labstor::Server::IPCManager::CreatePrivateQueuePairs(PerProcessIPC *client_ipc, MemoryConfig &memconf, labstor_qid_type_t type, labstor_qid_flags_t flags, int num_queues) {
+    client_ipc->ReserveQueues(type, flags, num_queues);
+    for(int i = 0; i < num_queues; ++i) {
         //Initialize QP
         labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
         labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
-                0,
+                type,
                 flags,
                 i,
-                memconf.num_queues,
-                pid_);
+                num_queues,
+                pid_,
+                LABSTOR_SERVER_IPC_ID);
         void *sq_region = client_ipc->AllocShmemQueue(memconf.request_queue_size);
         void *cq_region = client_ipc->AllocShmemQueue(memconf.request_map_size);
         qp->Init(qid, private_alloc_->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.request_map_size);
@@ -204,49 +273,230 @@ void labstor::Server::IPCManager::CreatePrivateQueues() {
     }
 }
 
+void labstor::Server::IPCManager::FillSetupReply(labstor::ipc::setup_reply &reply, MemoryConfig &memconf) {
+    reply.region_size_ = memconf.region_size;
+    reply.request_unit_ = memconf.request_unit;
+    reply.request_region_size_ = memconf.request_region_size;
+    reply.queue_region_size_ = memconf.queue_region_size;
+    reply.queue_depth_ = memconf.queue_depth;
+    reply.num_queues_ = memconf.num_queues;
+    reply.max_queues_ = memconf.max_queues;
+    reply.shmem_provider_ = static_cast<uint32_t>(shmem_type_);
+}
+
+labstor::Server::PreparedClientRegion labstor::Server::IPCManager::PrepareClientRegion(MemoryConfig &memconf) {
+    AUTO_TRACE("")
+    PreparedClientRegion prepared;
+    labstor::ipc::setup_reply layout;
+    FillSetupReply(layout, memconf);
+
+    //Create shared memory
+    prepared.region_id_ = shmem_->CreateShmem(memconf.region_size, true);
+    if(prepared.region_id_ < 0) {
+        throw SHMEM_CREATE_FAILED.format();
+    }
+    shmem_->GrantPidShmem(getpid(), prepared.region_id_);
+    prepared.region_ = shmem_->MapShmem(prepared.region_id_, memconf.region_size);
+    if(!prepared.region_) {
+        std::string reason = strerror(errno);
+        shmem_->FreeShmem(prepared.region_id_);
+        throw MMAP_FAILED.format(reason);
+    }
+
+    //Initialize the request allocator on the client's behalf
+    prepared.memconf_ = memconf;
+    prepared.alloc_ = new labstor::ipc::shmem_allocator();
+    prepared.alloc_->Init(prepared.region_, prepared.region_, memconf.request_region_size, memconf.request_unit, get_nprocs_conf());
+
+    //Prebuild the client's initial queues. They are stamped with the client's qids when it connects.
+    labstor::ipc::queue_pair_ptr ptr;
+    labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, LABSTOR_QP_CLIENT_DEFAULT, (uint32_t)0, memconf.max_queues, 0, (uint16_t)0);
+    for(uint32_t i = 0; i < memconf.num_queues; ++i) {
+        labstor::ipc::shmem_queue_pair qp;
+        layout.GetPrebuiltQueuePointer(i, 0, ptr);
+        qp.Init(qid, prepared.region_,
+                LABSTOR_REGION_ADD(ptr.sq_off_, prepared.region_), memconf.request_queue_size,
+                LABSTOR_REGION_ADD(ptr.cq_off_, prepared.region_), memconf.request_map_size);
+    }
+    return prepared;
+}
+
+void labstor::Server::IPCManager::PrepareClientRegions() {
+    AUTO_TRACE("")
+    MemoryConfig memconf;
+    std::vector<PreparedClientRegion> stale;
+    LoadMemoryConfig("client", memconf);
+
+    //Regions prepared before the client queue depth changed are replaced
+    {
+        std::lock_guard<std::mutex> lock(prepare_lock_);
+        for(auto iter = prepared_regions_.begin(); iter != prepared_regions_.end();) {
+            if(iter->memconf_.queue_depth != memconf.queue_depth) {
+                stale.emplace_back(*iter);
+                iter = prepared_regions_.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+    for(auto &prepared : stale) {
+        FreePreparedClientRegion(prepared);
+    }
+
+    //Regions are reserved under the lock, so concurrent callers do not overshoot the pool
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(prepare_lock_);
+            if(prepared_regions_.size() + num_preparing_ >= memconf.num_prepared_regions) {
+                return;
+            }
+            ++num_preparing_;
+        }
+        PreparedClientRegion prepared;
+        LABSTOR_ERROR_HANDLE_TRY {
+            prepared = PrepareClientRegion(memconf);
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            std::lock_guard<std::mutex> lock(prepare_lock_);
+            --num_preparing_;
+            throw;
+        }
+        //The depth may have changed while the region was being prepared
+        bool is_stale = prepared.memconf_.queue_depth != GetClientQueueDepth();
+        {
+            std::lock_guard<std::mutex> lock(prepare_lock_);
+            --num_preparing_;
+            if(!is_stale) {
+                prepared_regions_.emplace_back(prepared);
+            }
+        }
+        if(is_stale) {
+            FreePreparedClientRegion(prepared);
+            return;
+        }
+    }
+}
+
+void labstor::Server::IPCManager::RequestClientRegions() {
+    {
+        std::lock_guard<std::mutex> lock(prepare_lock_);
+        refill_requested_ = true;
+    }
+    prepare_cv_.notify_one();
+}
+
+bool labstor::Server::IPCManager::WaitForClientRegionRequest(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(prepare_lock_);
+    if(!prepare_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return refill_requested_; })) {
+        return false;
+    }
+    refill_requested_ = false;
+    return true;
+}
+
+void labstor::Server::IPCManager::FreePreparedClientRegion(PreparedClientRegion &prepared) {
+    AUTO_TRACE(prepared.region_id_)
+    delete prepared.alloc_;
+    shmem_->UnmapShmem(prepared.region_, prepared.memconf_.region_size);
+    shmem_->FreeShmem(prepared.region_id_);
+}
+
+uint32_t labstor::Server::IPCManager::GetClientQueueDepth() {
+    MemoryConfig memconf;
+    LoadMemoryConfig("client", memconf);
+    return memconf.queue_depth;
+}
+
+bool labstor::Server::IPCManager::SetClientQueueDepth(uint32_t queue_depth) {
+    AUTO_TRACE(queue_depth)
+    MemoryConfig memconf;
+    //The queues must still fit in the client region alongside its minimum request region
+    LABSTOR_ERROR_HANDLE_TRY {
+        LoadMemoryConfig("client", memconf, queue_depth);
+    } LABSTOR_ERROR_HANDLE_CATCH {
+        return false;
+    }
+    client_queue_depth_.store(queue_depth, std::memory_order_release);
+    return true;
+}
+
+labstor::Server::PreparedClientRegion labstor::Server::IPCManager::TakeClientRegion(MemoryConfig &memconf) {
+    {
+        std::lock_guard<std::mutex> lock(prepare_lock_);
+        if(prepared_regions_.size()) {
+            PreparedClientRegion prepared = prepared_regions_.back();
+            prepared_regions_.pop_back();
+            return prepared;
+        }
+    }
+    TRACEPOINT("No prepared client regions left")
+    return PrepareClientRegion(memconf);
+}
+
 void labstor::Server::IPCManager::RegisterClient(int client_fd, labstor::credentials &creds) {
     AUTO_TRACE(client_fd)
-    void *region;
-    uint32_t lpid;
     MemoryConfig memconf;
     LoadMemoryConfig("client", memconf);
 
     //Create new IPC
     PerProcessIPC *client_ipc = RegisterIPC(client_fd, creds);
 
-    //Create shared memory
-    LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC; 
-    client_ipc->region_id_ = shmem->CreateShmem(memconf.region_size, true);
-    if(client_ipc->region_id_ < 0) {
-        throw SHMEM_CREATE_FAILED.format();
-    }
-    shmem->GrantPidShmem(getpid(), client_ipc->region_id_);
-    shmem->GrantPidShmem(creds.pid_, client_ipc->region_id_);
-    region = shmem->MapShmem(client_ipc->region_id_, memconf.region_size);
-    if(!region) {
-        throw MMAP_FAILED.format(strerror(errno));
-    }
+    //The wreaper ignores IPCs until they are set up, so a failed handshake is torn down here
+    LABSTOR_ERROR_HANDLE_TRY {
+        //Hand the client a region whose allocator and queues are already initialized
+        PreparedClientRegion prepared = TakeClientRegion(memconf);
+        memconf = prepared.memconf_;
+        client_ipc->region_id_ = prepared.region_id_;
+        client_ipc->SetShmemAlloc(prepared.alloc_);
+        shmem_->GrantPidShmem(creds.pid_, client_ipc->region_id_);
+
+        //Setup metadata for the client
+        labstor::ipc::setup_reply reply;
+        FillSetupReply(reply, memconf);
+        reply.region_id_ = client_ipc->region_id_;
+        reply.ipc_id_ = client_ipc->GetIPCID();
+        LABSTOR_NAMESPACE->GetSharedRegion(reply.namespace_region_id_, reply.namespace_region_size_, reply.namespace_max_entries_);
+        shmem_->GrantPidShmem(creds.pid_, reply.namespace_region_id_);
+
+        //Stamp the prebuilt queues with the client's qids and schedule them before the client can submit
+        labstor::ipc::queue_pair_ptr ptr;
+        client_ipc->ReserveQueues(0, LABSTOR_QP_CLIENT_DEFAULT, memconf.max_queues);
+        for(uint32_t i = 0; i < memconf.num_queues; ++i) {
+            labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
+            reply.GetPrebuiltQueuePointer(i, creds.pid_, ptr);
+            qp->Attach(ptr, client_ipc->GetRegion());
+            qp->GetQID() = labstor::queue_pair::GetQID(0, LABSTOR_QP_CLIENT_DEFAULT, i, memconf.max_queues, creds.pid_, client_ipc->GetIPCID());
+            if(!RegisterQueuePair(qp)) {
+                throw IPC_MANAGER_CANT_REGISTER_QP.format();
+            }
+            work_orchestrator_->AssignQueuePair(qp, i);
+        }
 
-    //Send shared memory to client
-    labstor::ipc::setup_reply reply;
-    reply.region_id_ = client_ipc->region_id_;
-    reply.region_size_ = memconf.region_size;
-    reply.request_unit_ = memconf.request_unit;
-    reply.request_region_size_ = memconf.request_region_size;
-    reply.queue_region_size_ = memconf.queue_region_size;
-    reply.queue_depth_ = memconf.queue_depth;
-    reply.num_queues_ = memconf.num_queues;
-    LABSTOR_NAMESPACE->GetSharedRegion(reply.namespace_region_id_, reply.namespace_region_size_, reply.namespace_max_entries_);
-    TRACEPOINT("Registering", reply.region_id_, reply.region_size_, reply.request_unit_)
-    client_ipc->GetSocket().SendMSG(&reply, sizeof(reply));
-    labstor::kernel::netlink::ShmemClient().GrantPidShmem(creds.pid_, reply.namespace_region_id_);
+        //Send all setup metadata in one message
+        TRACEPOINT("Registering", reply.region_id_, reply.region_size_, reply.request_unit_)
+        client_ipc->GetSocket().SendMSG(&reply, sizeof(reply));
+        if(shmem_->PassesFds()) {
+            int fds[2] = {(int)reply.region_id_, (int)reply.namespace_region_id_};
+            client_ipc->GetSocket().SendFDs(fds, 2);
+        }
+    } LABSTOR_ERROR_HANDLE_CATCH {
+        work_orchestrator_->RemoveQueuePairs(creds.pid_);
+        UnregisterIPC(client_ipc);
+        work_orchestrator_->WaitForQuiescence();
+        FreeClientRegion(client_ipc);
+        delete client_ipc;
+        throw err;
+    }
+    client_ipc->MarkSetup();
 
-    //Receive and register client QPs
-    RegisterClientQP(client_ipc, region);
+    //Replace the region off the client's critical path
+    RequestClientRegions();
 }
 
-void labstor::Server::IPCManager::RegisterClientQP(PerProcessIPC *client_ipc, void *region) {
+void labstor::Server::IPCManager::RegisterClientQP(PerProcessIPC *client_ipc) {
     AUTO_TRACE("")
+    MemoryConfig memconf;
+    LoadMemoryConfig("client", memconf);
+
     //Receive SHMEM queue offsets
     labstor::ipc::register_qp_request request;
     client_ipc->GetSocket().RecvMSG((void*)&request, sizeof(labstor::ipc::register_qp_request));
@@ -255,33 +505,100 @@ void labstor::Server::IPCManager::RegisterClientQP(PerProcessIPC *client_ipc, vo
     client_ipc->GetSocket().RecvMSG((void*)ptrs, size);
     TRACEPOINT("count", request.count_);
 
-    //Attach request allocator
-    labstor::ipc::shmem_allocator *alloc = new labstor::ipc::shmem_allocator();
-    alloc->Attach(region, region);
-    client_ipc->SetShmemAlloc(alloc);
-
     //Schedule QP with the work orchestrator
+    std::vector<labstor::ipc::shmem_queue_pair*> registered;
+    registered.reserve(request.count_);
     for(int i = 0; i < request.count_; ++i) {
         labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
         qp->Attach(ptrs[i], client_ipc->GetRegion());
-        if(i == 0) {
-            labstor_qid_flags_t flags = qp->GetQID().flags_;
-            client_ipc->ReserveQueues(0, flags, request.count_);
+        labstor_qid_flags_t flags = qp->GetQID().flags_;
+        if(qp->GetQID().cnt_ >= memconf.max_queues || client_ipc->FindQueuePair(qp->GetQID()) ||
+           FindIPC(qp->GetQID()) != client_ipc) {
+            //The client asked for more queues than its queue region can hold, reused a live index,
+            //or labeled the queue with another process's IPC id
+            delete qp;
+            break;
         }
+        //Clients grow their queue set at runtime, so never let the vector move
+        client_ipc->ReserveQueues(0, flags, memconf.max_queues);
         TRACEPOINT("pid", qp->GetQID().pid_, "pid", qp->GetQID().type_, "flags", qp->GetQID().flags_, "cnt", qp->GetQID().cnt_)
         if(!RegisterQueuePair(qp)) {
-            free(ptrs);
-            throw IPC_MANAGER_CANT_REGISTER_QP.format();
+            delete qp;
+            break;
         }
-        work_orchestrator_->AssignQueuePair(qp, i);
+        LABSTOR_ERROR_HANDLE_TRY {
+            work_orchestrator_->AssignQueuePair(qp, qp->GetQID().cnt_);
+        } LABSTOR_ERROR_HANDLE_CATCH {
+            LABSTOR_ERROR_PTR->print();
+            UnregisterQueuePair(qp);
+            delete qp;
+            break;
+        }
+        registered.emplace_back(qp);
     }
     free(ptrs);
 
+    //The batch is all or nothing: undo the queues registered before the failure
+    if((int)registered.size() < request.count_) {
+        TRACEPOINT("Rolling back", registered.size(), "of", request.count_)
+        for(auto qp : registered) {
+            work_orchestrator_->RemoveQueuePair(qp);
+            UnregisterQueuePair(qp);
+            delete qp;
+        }
+        labstor::ipc::register_qp_reply reply(LABSTOR_REQUEST_FAILED);
+        client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(labstor::ipc::register_qp_reply));
+        return;
+    }
+
     //Reply success
     labstor::ipc::register_qp_reply reply(0);
     client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(labstor::ipc::register_qp_reply));
 }
 
+void labstor::Server::IPCManager::UnregisterClientQP(PerProcessIPC *client_ipc) {
+    AUTO_TRACE("")
+    labstor::ipc::unregister_qp_request request;
+    client_ipc->GetSocket().RecvMSG((void*)&request, sizeof(labstor::ipc::unregister_qp_request));
+    TRACEPOINT("pid", request.qid_.pid_, "type", request.qid_.type_, "flags", request.qid_.flags_, "cnt", request.qid_.cnt_)
+
+    //Clients may only tear down their own queues
+    labstor::queue_pair *qp = nullptr;
+    if(request.qid_.pid_ == (uint32_t)client_ipc->GetPID() && request.qid_.type_ == 0) {
+        qp = client_ipc->FindQueuePair(request.qid_);
+    }
+    if(!qp) {
+        labstor::ipc::unregister_qp_reply reply(LABSTOR_REQUEST_FAILED);
+        client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(labstor::ipc::unregister_qp_reply));
+        return;
+    }
+
+    //Detach the QP from its worker before the client frees its memory
+    labstor::ipc::shmem_queue_pair *shmem_qp = static_cast<labstor::ipc::shmem_queue_pair*>(qp);
+    work_orchestrator_->RemoveQueuePair(shmem_qp);
+    UnregisterQueuePair(qp);
+    delete shmem_qp;
+
+    labstor::ipc::unregister_qp_reply reply(0);
+    client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(labstor::ipc::unregister_qp_reply));
+}
+
+void labstor::Server::IPCManager::FreeClientRegion(PerProcessIPC *client_ipc) {
+    AUTO_TRACE(client_ipc->GetPID())
+    MemoryConfig memconf;
+    LoadMemoryConfig("client", memconf);
+    //The client disconnected before it was handed a region
+    if(client_ipc->GetShmemAlloc() == nullptr) {
+        return;
+    }
+    //The request allocator came with the prepared region, so it goes with it
+    void *region = client_ipc->GetRegion();
+    delete client_ipc->GetShmemAlloc();
+    client_ipc->SetShmemAlloc(nullptr);
+    shmem_->UnmapShmem(region, memconf.region_size);
+    shmem_->FreeShmem(client_ipc->region_id_);
+}
+
 void labstor::Server::IPCManager::PauseQueues() {
 }
 
@@ -25,6 +25,10 @@
  */
 
 #include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
 #include <labstor/userspace/server/server.h>
 #include <labstor/userspace/util/errors.h>
 #include <labstor/constants/debug.h>
@@ -34,79 +38,315 @@
 #include <labstor/userspace/server/module_manager.h>
 #include <labstor/userspace/server/namespace.h>
 #include <labstor/userspace/server/ipc_manager.h>
+#include <labstor/userspace/server/work_orchestrator.h>
+#include <labstor/userspace/server/state_manager.h>
+#include <labstor/userspace/util/timer.h>
+
+/*Changes when a labmod is added to or removed from the repo, which is when its manifest entry goes stale*/
+static std::string RepoStamp(const std::string &repo_path) {
+    std::stringstream ss;
+    for(auto dir : {repo_path + "/include/labmods", repo_path + "/lib"}) {
+        std::error_code ec;
+        auto mtime = std::filesystem::last_write_time(dir, ec);
+        ss << (ec ? 0 : mtime.time_since_epoch().count()) << ":";
+    }
+    return ss.str();
+}
 
 bool labstor::Server::ModuleManager::LoadRepos() {
     AUTO_TRACE("")
-    if(labstor_config_->config_["repos"]) {
-        for(auto repo : labstor_config_->config_["repos"]) {
+    YAML::Node &config = labstor_config_->config_;
+    std::string manifest_path;
+    YAML::Node manifest, new_manifest;
+    bool modified = false;
+
+    //Repos whose stamp matches the manifest are not rescanned
+    if(config["modules"] && config["modules"]["manifest"]) {
+        manifest_path = scs::path_parser(config["modules"]["manifest"].as<std::string>());
+        if(std::filesystem::exists(manifest_path)) {
+            try {
+                manifest = YAML::LoadFile(manifest_path);
+            } catch(YAML::Exception &e) {
+                printf("Ignoring unreadable module manifest %s: %s\n", manifest_path.c_str(), e.what());
+            }
+        }
+    }
+
+    //Libraries are only recorded here; they are dlopened on first registration or by PreloadModules
+    if(config["repos"]) {
+        for(auto repo : config["repos"]) {
             std::string repo_path = scs::path_parser(repo.as<std::string>());
+            std::string stamp = RepoStamp(repo_path);
             printf("Processing repo: %s\n", repo_path.c_str());
-            std::string labmod_uuid_path = repo_path + "/include/labmods";
-            labstor::ModulePath paths;
-            if(!std::filesystem::exists(labmod_uuid_path)) {
-                printf("%s doesn't exist in repo yaml\n", labmod_uuid_path.c_str());
-                return false;
-            }
-            for(auto &dir_entry : std::filesystem::directory_iterator(labmod_uuid_path)) {
-                std::string labmod_uuid_str = dir_entry.path().filename();
-                labstor::id labmod_uuid(labmod_uuid_str);
-                if(HasModule(labmod_uuid)) {
-                    continue;
-                }
-                std::string client_lib = repo_path + "/lib/" + "lib" + labmod_uuid_str + "_client.so";
-                std::string server_lib = repo_path + "/lib/" + "lib" + labmod_uuid_str + "_server.so";
-                if(std::filesystem::exists(client_lib)) {
-                    paths.client = client_lib;
+            YAML::Node entry;
+            if(manifest.IsMap() && manifest[repo_path] && manifest[repo_path]["stamp"] &&
+               manifest[repo_path]["stamp"].as<std::string>() == stamp) {
+                entry = manifest[repo_path];
+                AddManifestPaths(entry["modules"]);
+            } else {
+                if(!ScanRepo(repo_path, entry)) {
+                    return false;
                 }
-                if(std::filesystem::exists(server_lib)) {
-                    paths.server = server_lib;
-                    labstor::ModuleHandle module_info = OpenModule(paths.server, labmod_uuid);
-                    SetModuleConstructor(labmod_uuid, module_info);
-                }
-                AddModulePaths(labmod_uuid, paths);
-                printf("Added module %s\n", labmod_uuid_str.c_str());
-                printf("  Client path: %s\n", paths.client.c_str());
-                printf("  Server path: %s\n", paths.server.c_str());
+                entry["stamp"] = stamp;
+                modified = true;
             }
+            new_manifest[repo_path] = entry;
+        }
+    }
+    if(!manifest_path.empty() && (modified || !manifest.IsMap() || manifest.size() != new_manifest.size())) {
+        std::ofstream out(manifest_path);
+        out << new_manifest;
+    }
+
+    PreloadModules();
+    return true;
+}
+
+bool labstor::Server::ModuleManager::ScanRepo(const std::string &repo_path, YAML::Node &manifest) {
+    AUTO_TRACE("")
+    std::string labmod_uuid_path = repo_path + "/include/labmods";
+    if(!std::filesystem::exists(labmod_uuid_path)) {
+        printf("%s doesn't exist in repo yaml\n", labmod_uuid_path.c_str());
+        return false;
+    }
+    manifest["modules"] = YAML::Node(YAML::NodeType::Sequence);
+    for(auto &dir_entry : std::filesystem::directory_iterator(labmod_uuid_path)) {
+        std::string labmod_uuid_str = dir_entry.path().filename();
+        labstor::id labmod_uuid(labmod_uuid_str);
+        labstor::ModulePath paths;
+        if(paths_.find(labmod_uuid) != paths_.end()) {
+            continue;
+        }
+        std::string client_lib = repo_path + "/lib/" + "lib" + labmod_uuid_str + "_client.so";
+        std::string server_lib = repo_path + "/lib/" + "lib" + labmod_uuid_str + "_server.so";
+        if(std::filesystem::exists(client_lib)) {
+            paths.client = client_lib;
+        }
+        if(std::filesystem::exists(server_lib)) {
+            paths.server = server_lib;
         }
+        AddModulePaths(labmod_uuid, paths);
+        YAML::Node module;
+        module["uuid"] = labmod_uuid_str;
+        module["client"] = paths.client;
+        module["server"] = paths.server;
+        manifest["modules"].push_back(module);
+        printf("Added module %s\n", labmod_uuid_str.c_str());
+        printf("  Client path: %s\n", paths.client.c_str());
+        printf("  Server path: %s\n", paths.server.c_str());
     }
     return true;
 }
 
+void labstor::Server::ModuleManager::AddManifestPaths(const YAML::Node &manifest) {
+    AUTO_TRACE("")
+    for(auto module : manifest) {
+        labstor::id labmod_uuid(module["uuid"].as<std::string>());
+        labstor::ModulePath paths;
+        if(paths_.find(labmod_uuid) != paths_.end()) {
+            continue;
+        }
+        paths.client = module["client"].as<std::string>();
+        paths.server = module["server"].as<std::string>();
+        AddModulePaths(labmod_uuid, paths);
+    }
+}
+
+void labstor::Server::ModuleManager::PreloadModules() {
+    AUTO_TRACE("")
+    YAML::Node &config = labstor_config_->config_;
+    std::vector<labstor::id> module_ids;
+    if(!config["modules"] || !config["modules"]["preload"]) {
+        return;
+    }
+    YAML::Node preload = config["modules"]["preload"];
+    if(preload.IsScalar() && preload.as<std::string>() == "all") {
+        for(auto &paths : paths_) {
+            if(!paths.second.server.empty()) {
+                module_ids.emplace_back(paths.first);
+            }
+        }
+    } else {
+        for(auto module : preload) {
+            labstor::id module_id(module.as<std::string>());
+            if(std::find(module_ids.begin(), module_ids.end(), module_id) == module_ids.end()) {
+                module_ids.emplace_back(module_id);
+            }
+        }
+    }
+
+    //Each thread loads a distinct module before any worker starts, so no load lock is needed
+    std::vector<std::thread> threads;
+    std::vector<LABSTOR_ERROR_TYPE> errors(module_ids.size());
+    for(size_t i = 0; i < module_ids.size(); ++i) {
+        threads.emplace_back([this, &module_ids, &errors, i]() {
+            LABSTOR_ERROR_HANDLE_TRY {
+                LoadModule(module_ids[i]);
+            } LABSTOR_ERROR_HANDLE_CATCH {
+                errors[i] = err;
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    for(auto &err : errors) {
+        if(err) {
+            throw err;
+        }
+    }
+}
+
+void labstor::Server::ModuleManager::LoadModule(labstor::id module_id) {
+    AUTO_TRACE(module_id.key_)
+    labstor::ModuleHandle module_info;
+    labstor::id lib_module_id;
+
+    //Labmods linked into the server need no dlopen
+    module_info.constructor_ = labstor::StaticModuleRegistry::Find(module_id);
+    module_info.handle_ = nullptr;
+    if(module_info.constructor_ == nullptr) {
+        auto iter = paths_.find(module_id);
+        if(iter == paths_.end() || iter->second.server.empty()) {
+            throw labstor::INVALID_MODULE_ID.format(module_id.key_);
+        }
+        module_info = OpenModule(iter->second.server, lib_module_id);
+        if(!(lib_module_id == module_id)) {
+            dlclose(module_info.handle_);
+            throw labstor::MODULE_ID_MISMATCH.format(iter->second.server, lib_module_id.key_, module_id.key_);
+        }
+    }
+    SetModuleConstructor(module_id, module_info);
+}
+
+labstor::create_module_fn labstor::Server::ModuleManager::GetModuleConstructor(labstor::id module_id) {
+    AUTO_TRACE(module_id.key_)
+    if(!HasModule(module_id)) {
+        std::lock_guard<std::mutex> lock(load_mutex_);
+        if(!HasModule(module_id)) {
+            LoadModule(module_id);
+        }
+    }
+    return ModuleTable::GetModuleConstructor(module_id);
+}
+
+labstor::Module* labstor::Server::ModuleManager::UpgradeInstance(labstor::Module *old_instance, labstor::ModuleHandle &module_info) {
+    AUTO_TRACE("")
+    LABSTOR_NAMESPACE_T namespace_ = LABSTOR_NAMESPACE;
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+    LABSTOR_STATE_MANAGER_T state_manager_ = LABSTOR_STATE_MANAGER;
+    uint32_t ns_id = old_instance->GetNamespaceID();
+    labstor::HighResMonotonicTimer t;
+
+    //Construct the replacement before any queue stalls
+    labstor::Module *new_instance = module_info.constructor_();
+    new_instance->SetNamespaceID(ns_id);
+
+    //Only queues whose next request targets ns_id stall; the rest keep running
+    t.Resume();
+    namespace_->PauseModule(ns_id);
+    work_orchestrator_->WaitForQuiescence();
+
+    //Suspended handlers and deadline-queue requests the old instance started still run its code, so let them finish
+    while(old_instance->GetNumPending()) {
+        LABSTOR_YIELD();
+    }
+    work_orchestrator_->WaitForQuiescence();
+    LABSTOR_ERROR_HANDLE_TRY {
+        //State kept in the StateManager is re-attached here rather than copied
+        new_instance->StateUpdate(old_instance);
+    } LABSTOR_ERROR_HANDLE_CATCH {
+        //The old instance keeps serving ns_id with the regions it attached to
+        state_manager_->Rollback(ns_id);
+        namespace_->ResumeModule(ns_id);
+        delete new_instance;
+        throw err;
+    }
+    namespace_->PublishModule(ns_id, new_instance);
+    //The old instance is quiesced and unpublished, so the regions it used are no longer needed
+    state_manager_->Commit(ns_id);
+    namespace_->ResumeModule(ns_id);
+    t.Pause();
+    TRACEPOINT("Upgraded", old_instance->GetModuleID().key_, ns_id, t.GetUsec())
+    return new_instance;
+}
+
 void labstor::Server::ModuleManager::CentralizedUpdateModule(YAML::Node config) {
     AUTO_TRACE("")
-    std::string path = config["code_upgrade"]["centralized"].as<std::string>();
     labstor::id module_id;
     labstor::ModuleHandle module_info;
     labstor::Module *old_instance, *new_instance;
-    labstor_runtime_id_t runtime_id;
+    std::vector<labstor::Module*> retired;
+    std::vector<std::pair<labstor::id, labstor::ModuleHandle>> handles;
+    std::vector<void*> upgraded_handles;
     LABSTOR_NAMESPACE_T namespace_ = LABSTOR_NAMESPACE;
-    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
 
-    //Pause all queues & wait until there are no busy queues
-    ipc_manager_->PauseQueues();
-    ipc_manager_->WaitForPause();
-
-    //Process update
     LABSTOR_ERROR_HANDLE_TRY {
-        module_info = OpenModule(path, module_id);
-        std::queue<labstor::Module*> &modules = namespace_->AllModuleInstances(module_id);
-        for(int i = 0; i < modules.size(); ++i) {
-            labstor::Module *old_instance = modules.front();
-            modules.pop();
-            new_instance = module_info.constructor_();
-            new_instance->StateUpdate(old_instance);
-            modules.push(new_instance);
-            delete old_instance;
-        }
-        SetModuleConstructor(module_id, module_info);
+        //Replace every instance of a module with the code at the given path
+        if(config["code_upgrade"] && config["code_upgrade"]["centralized"]) {
+            std::string path = config["code_upgrade"]["centralized"].as<std::string>();
+            module_info = OpenModule(path, module_id);
+            handles.emplace_back(module_id, module_info);
+            std::queue<labstor::Module*> &modules = namespace_->AllModuleInstances(module_id);
+            for(size_t i = 0, count = modules.size(); i < count; ++i) {
+                old_instance = modules.front();
+                modules.pop();
+                LABSTOR_ERROR_HANDLE_TRY {
+                    new_instance = UpgradeInstance(old_instance, module_info);
+                } LABSTOR_ERROR_HANDLE_CATCH {
+                    //The old instance still serves its ns_id
+                    modules.push(old_instance);
+                    throw err;
+                }
+                modules.push(new_instance);
+                retired.emplace_back(old_instance);
+                upgraded_handles.emplace_back(module_info.handle_);
+            }
+        }
+
+        //Replace the instances a modified LabStack marks for upgrade
+        if(config["dag"]) {
+            for(auto iter : config["dag"]) {
+                YAML::Node vertex = config["dag"].IsMap() ? iter.second : iter;
+                if(!vertex["upgrade"] || !vertex["upgrade"].as<bool>()) { continue; }
+                uint32_t ns_id = namespace_->GetNamespaceID(vertex["labmod_uuid"].as<std::string>());
+                old_instance = namespace_->GetModule(ns_id);
+                if(old_instance == nullptr) { continue; }
+                module_id = old_instance->GetModuleID();
+                module_info = OpenModule(GetModulePath(module_id, labstor::ModulePathType::kServer), module_id);
+                handles.emplace_back(module_id, module_info);
+                new_instance = UpgradeInstance(old_instance, module_info);
+                std::queue<labstor::Module*> &modules = namespace_->AllModuleInstances(module_id);
+                for(size_t i = 0, count = modules.size(); i < count; ++i) {
+                    labstor::Module *module = modules.front();
+                    modules.pop();
+                    modules.push(module == old_instance ? new_instance : module);
+                }
+                retired.emplace_back(old_instance);
+                upgraded_handles.emplace_back(module_info.handle_);
+            }
+        }
+        namespace_->MarkMountsModified();
     } LABSTOR_ERROR_HANDLE_CATCH {
-        ipc_manager_->ResumeQueues();
+        work_orchestrator_->WaitForQuiescence();
+        for(auto module : retired) { delete module; }
+        //Instances that were not upgraded still run the old code, so its constructors stay installed.
+        //Libraries backing an upgraded instance stay open; the rest are closed.
+        for(auto &handle : handles) {
+            if(std::find(upgraded_handles.begin(), upgraded_handles.end(), handle.second.handle_) == upgraded_handles.end()) {
+                dlclose(handle.second.handle_);
+            }
+        }
         throw err;
     }
 
-    //Resume all queues
-    ipc_manager_->ResumeQueues();
+    //Workers may still hold a replaced instance until they pass a quiescent point
+    work_orchestrator_->WaitForQuiescence();
+    for(auto module : retired) { delete module; }
+
+    //The old code can only be unloaded once none of its instances remain
+    for(auto &handle : handles) { SetModuleConstructor(handle.first, handle.second); }
 }
 
 void labstor::Server::ModuleManager::DecentralizedUpdateModule(YAML::Node config) {
@@ -27,8 +27,10 @@
 #include <labstor/userspace/server/server.h>
 #include <labstor/constants/debug.h>
 #include <labstor/userspace/server/namespace.h>
-#include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
+#include <labstor/userspace/server/ipc_manager.h>
 #include <labmods/registrar/server/registrar_server.h>
+#include <labstor/userspace/types/labstack_dag.h>
+#include <labstor/userspace/server/work_orchestrator.h>
 
 labstor::Server::Namespace::Namespace() {
     AUTO_TRACE("")
@@ -37,11 +39,15 @@ labstor::Server::Namespace::Namespace() {
     uint32_t max_collisions = labstor_config_->config_["namespace"]["max_collisions"].as<uint32_t>();
     uint32_t request_unit = labstor_config_->config_["namespace"]["shmem_request_unit"].as<uint32_t>() * SizeType::BYTES;
     uint32_t shmem_size = labstor_config_->config_["namespace"]["shmem_kb"].as<uint32_t>() * SizeType::KB;
+    uint32_t max_labstacks = max_entries / LABSTOR_LABSTACK_MAX_STAGES + 1;
+    if(labstor_config_->config_["namespace"]["max_labstacks"]) {
+        max_labstacks = labstor_config_->config_["namespace"]["max_labstacks"].as<uint32_t>();
+    }
     region_size_ = shmem_size;
 
     //Create a shared memory region
-    TRACEPOINT(max_entries, max_collisions, request_unit, shmem_size)
-    LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC;
+    TRACEPOINT(max_entries, max_collisions, max_labstacks, request_unit, shmem_size)
+    labstor::ShmemProvider *shmem = LABSTOR_IPC_MANAGER->GetShmem();
     region_id_ = shmem->CreateShmem(shmem_size, true);
     if(region_id_ < 0) {
         throw SHMEM_CREATE_FAILED.format();
@@ -57,16 +63,28 @@ labstor::Server::Namespace::Namespace() {
     TRACEPOINT("NamespaceTables")
     uint32_t remainder = shmem_size;
     void *section = region_;
+    clock_ = (struct labstor_tsc_clock*)section;
+    labstor_tsc_clock_init(clock_, LABSTOR_TSC_CALIBRATE_NS);
+    labstor_set_clock_page(clock_);
+    remainder -= LABSTOR_TSC_CLOCK_PAGE_SIZE;
+    section = (char*)section + LABSTOR_TSC_CLOCK_PAGE_SIZE;
     ns_ids_.Init(section, labstor::ipc::mpmc::ring_buffer<uint32_t>::GetSize(max_entries));
     remainder -= ns_ids_.GetSize();
     section = ns_ids_.GetNextSection();
     key_to_ns_id_.Init(region_, section, labstor::ipc::mpmc::string_map::GetSize(max_entries), 0, 16);
     remainder -= key_to_ns_id_.GetSize();
     section = key_to_ns_id_.GetNextSection();
+    mount_points_.Init(region_, section, labstor::ipc::mount_trie::GetSize(max_entries), max_entries);
+    remainder -= mount_points_.GetSize();
+    section = mount_points_.GetNextSection();
+    routes_.Init(region_, section, max_entries, max_labstacks);
+    remainder -= routes_.GetSize();
+    section = routes_.GetNextSection();
     max_entries_ = max_entries;
+    private_state_.Init(max_entries);
     TRACEPOINT("NamespaceTables")
 
-    TRACEPOINT("SIZES", ns_ids_.GetSize(), key_to_ns_id_.GetSize(), region_id_)
+    TRACEPOINT("SIZES", ns_ids_.GetSize(), key_to_ns_id_.GetSize(), mount_points_.GetSize(), routes_.GetSize(), region_id_)
 
     //Create memory allocator on remaining memory for key names
     labstor::ipc::shmem_allocator *alloc;
@@ -78,4 +96,84 @@ labstor::Server::Namespace::Namespace() {
 void labstor::Server::Namespace::Init() {
     //Add the registration module
     AddKey(labstor::ipc::string("Registrar", shmem_alloc_), new labstor::Registrar::Server());
-}
\ No newline at end of file
+}
+
+void labstor::Server::Namespace::MountLabStack(YAML::Node config) {
+    AUTO_TRACE("")
+    labstor::LabStackDAG dag;
+    dag.Compile(config);
+    labstor::ipc::labstack_routes *routes;
+    std::lock_guard<std::mutex> lock(labstack_lock_);
+    routes = routes_.AllocRoutes();
+    if(routes == nullptr) {
+        throw LABSTACK_INVALID.format(dag.GetMountPoint(), "every routing table is in use");
+    }
+    LABSTOR_ERROR_HANDLE_TRY {
+        dag.BuildRoutes(routes, [this](const std::string &key) { return GetNamespaceID(key); });
+        auto &stages = dag.GetStages();
+        for(size_t i = 0; i < stages.size(); ++i) {
+            if(!stages[i].worker_group_.empty()) {
+                routes->stages_[i].qp_type_ = LABSTOR_WORK_ORCHESTRATOR->GetWorkerGroupType(stages[i].worker_group_);
+            }
+        }
+    } LABSTOR_ERROR_HANDLE_CATCH {
+        routes_.FreeRoutes(routes);
+        throw err;
+    }
+    routes_.Publish(routes);
+    auto iter = labstacks_.find(routes->mount_ns_id_);
+    if(iter != labstacks_.end()) {
+        //Stages dropped by the remount must not keep routing through the old table
+        routes_.Unpublish(iter->second);
+        retired_routes_.emplace_back(iter->second);
+        iter->second = routes;
+    } else {
+        labstacks_.emplace(routes->mount_ns_id_, routes);
+    }
+    RestoreMountPoint(dag.GetMountPoint(), routes->mount_ns_id_);
+    MarkMountsModified();
+    TRACEPOINT(dag.GetMountPoint(), routes->mount_ns_id_, routes->num_stages_, routes->version_)
+}
+
+void labstor::Server::Namespace::UnmountLabStack(labstor::ipc::string key, uint32_t mount_ns_id) {
+    std::lock_guard<std::mutex> lock(labstack_lock_);
+    if(labstor::ipc::mount_trie::IsMountPoint(key)) {
+        mount_points_.Remove(key);
+    }
+    auto iter = labstacks_.find(mount_ns_id);
+    if(iter == labstacks_.end()) {
+        return;
+    }
+    routes_.Unpublish(iter->second);
+    retired_routes_.emplace_back(iter->second);
+    labstacks_.erase(iter);
+    MarkMountsModified();
+}
+
+void labstor::Server::Namespace::RestoreMountPoint(const std::string &mount_point, uint32_t mount_ns_id) {
+    //Mount points are added when their module registers, so only a stack remounted after an unmount is missing
+    labstor::ipc::string key(mount_point);
+    uint32_t ns_id, match_len;
+    if(!labstor::ipc::mount_trie::IsMountPoint(key) || GetNamespaceID(key) != mount_ns_id) {
+        return;
+    }
+    if(mount_points_.Find(mount_point.c_str(), mount_point.size(), ns_id, match_len) && match_len == mount_point.size()) {
+        return;
+    }
+    if(!mount_points_.Insert(labstor::ipc::string(mount_point, shmem_alloc_), mount_ns_id)) {
+        FAILED_TO_SET_NAMESPACE_KEY.format(mount_ns_id)->print();
+    }
+}
+
+std::vector<labstor::ipc::labstack_routes*> labstor::Server::Namespace::TakeRetiredRoutes() {
+    std::lock_guard<std::mutex> lock(labstack_lock_);
+    return std::move(retired_routes_);
+}
+
+void labstor::Server::Namespace::FreeRoutes(std::vector<labstor::ipc::labstack_routes*> &routes) {
+    std::lock_guard<std::mutex> lock(labstack_lock_);
+    for(auto table : routes) {
+        routes_.FreeRoutes(table);
+    }
+    routes.clear();
+}
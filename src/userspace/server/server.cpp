@@ -47,9 +47,12 @@
 #include <labstor/userspace/server/module_manager.h>
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/server/work_orchestrator.h>
+#include <labstor/kernel/client/macros.h>
 #include <labstor/kernel/client/kernel_client.h>
 #include "labstor/userspace/server/wreaper_thread.h"
 #include "labstor/userspace/server/upgrade_thread.h"
+#include "labstor/userspace/server/auto_tune_thread.h"
+#include "labstor/userspace/server/prepare_thread.h"
 
 #define TRUSTED_SERVER_PATH "/tmp/labstor_trusted_server"
 
@@ -149,10 +152,20 @@ int main(int argc, char **argv) {
     //Initialize labstor configuration
     auto labstor_config_ = LABSTOR_CONFIGURATION_MANAGER;
     labstor_config_->LoadConfig(argv[1]);
+    if(labstor_config_->IsAutoTuned()) {
+        labstor::Server::AutoTuner tuner;
+        tuner.Tune(labstor_config_->config_, labstor::Server::AutoTuner::ReadTopology());
+        if(labstor_config_->config_["auto_tune"]["emit"]) {
+            labstor::Server::AutoTuner::Emit(labstor_config_->config_, labstor_config_->config_["auto_tune"]["emit"].as<std::string>());
+        }
+    }
 
     //Connect to kernel server
+    bool userspace_only = labstor_config_->IsUserspaceOnly();
     auto netlink_client_ = LABSTOR_KERNEL_CLIENT;
-    netlink_client_->Connect();
+    if(!userspace_only) {
+        netlink_client_->Connect();
+    }
 
     //Load modules
     auto module_manager_ = LABSTOR_MODULE_MANAGER;
@@ -164,15 +177,20 @@ int main(int argc, char **argv) {
 
     //Initialize IPC Manager
     auto ipc_manager_ = LABSTOR_IPC_MANAGER;
-    ipc_manager_->InitializeKernelIPCManager();
+    if(!userspace_only) {
+        ipc_manager_->InitializeKernelIPCManager();
+    }
 
     //Initialize workers
     auto work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
     work_orchestrator_->CreateWorkers();
 
     //Establish queues
-    ipc_manager_->CreateKernelQueues();
+    if(!userspace_only) {
+        ipc_manager_->CreateKernelQueues();
+    }
     ipc_manager_->CreatePrivateQueues();
+    ipc_manager_->PrepareClientRegions();
 
     //Initialize server
     server_init();
@@ -198,11 +216,32 @@ int main(int argc, char **argv) {
     upgrade_daemon->Start();
     upgrade_daemon->SetAffinity(labstor_config_->config_["admin_thread"].as<int>());
 
+    //Create the thread for refilling prepared client regions
+    std::shared_ptr<labstor::UserspaceDaemon> prepare_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
+    std::shared_ptr<labstor::Server::PrepareWorker> prepare_worker = std::shared_ptr<labstor::Server::PrepareWorker>(new labstor::Server::PrepareWorker());
+    prepare_daemon->SetWorker(prepare_worker);
+    prepare_daemon->Start();
+    prepare_daemon->SetAffinity(labstor_config_->config_["admin_thread"].as<int>());
+
+    //Create the thread for resizing client queues
+    std::shared_ptr<labstor::UserspaceDaemon> auto_tune_daemon;
+    if(labstor_config_->IsAutoTuned()) {
+        auto_tune_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
+        std::shared_ptr<labstor::Server::AutoTuneWorker> auto_tune_worker = std::shared_ptr<labstor::Server::AutoTuneWorker>(new labstor::Server::AutoTuneWorker());
+        auto_tune_daemon->SetWorker(auto_tune_worker);
+        auto_tune_daemon->Start();
+        auto_tune_daemon->SetAffinity(labstor_config_->config_["admin_thread"].as<int>());
+    }
+
     //Wait for the daemons to die
     printf("LabStor server has started\n");
     accept_daemon->Wait();
     wreaper_daemon->Wait();
     upgrade_daemon->Wait();
+    prepare_daemon->Wait();
+    if(auto_tune_daemon) {
+        auto_tune_daemon->Wait();
+    }
 
     LABSTOR_ERROR_HANDLE_END()
 }
\ No newline at end of file
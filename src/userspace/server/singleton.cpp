@@ -30,6 +30,7 @@
 #include <labstor/userspace/server/namespace.h>
 #include <labstor/userspace/server/module_manager.h>
 #include <labstor/userspace/server/work_orchestrator.h>
+#include <labstor/userspace/server/state_manager.h>
 #include <labmods/registrar/server/registrar_server.h>
 
 namespace labstor {
@@ -43,4 +44,5 @@ DEFINE_SINGLETON(IPC_MANAGER)
 DEFINE_SINGLETON(MODULE_MANAGER)
 DEFINE_SINGLETON(WORK_ORCHESTRATOR)
 DEFINE_SINGLETON(NAMESPACE)
+DEFINE_SINGLETON(STATE_MANAGER)
 DEFINE_SINGLETON(REGISTRAR)
\ No newline at end of file
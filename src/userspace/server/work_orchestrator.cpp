@@ -45,6 +45,10 @@ void labstor::Server::WorkOrchestrator::CreateWorkers() {
     auto netlink_client_ = LABSTOR_KERNEL_CLIENT;
     const auto &config = labstor_config_->config_["work_orchestrator"];
     uint32_t queue_depth = config["work_queue_depth"].as<uint32_t>();
+    uint32_t max_batch = 1;
+    if(config["max_batch"]) {
+        max_batch = config["max_batch"].as<uint32_t>();
+    }
     int nworkers;
 
     //Server worker threads
@@ -58,15 +62,43 @@ void labstor::Server::WorkOrchestrator::CreateWorkers() {
     for (const auto &worker_conf : config["server_workers"]) {
         int worker_id = worker_conf["worker_id"].as<int>();
         int cpu_id = worker_conf["cpu_id"].as<int>();
-        TRACEPOINT("id", worker_id, "cpu", cpu_id)
+        WorkerRole role = WorkerRole::kGeneral;
+        if(worker_conf["role"]) {
+            role = labstor::Server::Worker::GetRoleFromString(worker_conf["role"].as<std::string>());
+        }
+        if(worker_conf["group"]) {
+            //Grouped workers are reserved for the stages pinned to their group
+            AddToWorkerGroup(worker_conf["group"].as<std::string>(), worker_id);
+        } else {
+            switch(role) {
+                case WorkerRole::kLatency: {
+                    latency_workers_.emplace_back(worker_id);
+                    break;
+                }
+                case WorkerRole::kThroughput: {
+                    throughput_workers_.emplace_back(worker_id);
+                    break;
+                }
+                case WorkerRole::kGeneral: {
+                    general_workers_.emplace_back(worker_id);
+                    break;
+                }
+            }
+        }
+        TRACEPOINT("id", worker_id, "cpu", cpu_id, "role", (int)role)
         std::shared_ptr<labstor::UserspaceDaemon> worker_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
-        std::shared_ptr<labstor::Server::Worker> worker = std::shared_ptr<labstor::Server::Worker>(new labstor::Server::Worker(queue_depth, worker_id));
+        std::shared_ptr<labstor::Server::Worker> worker = std::shared_ptr<labstor::Server::Worker>(new labstor::Server::Worker(queue_depth, worker_id, role, max_batch));
         server_workers[worker_id] = worker_daemon;
         worker_daemon->SetWorker(worker);
         worker_daemon->Start();
         worker_daemon->SetAffinity(cpu_id);
     }
 
+    //The userspace-only profile has no kernel workers to drive
+    if(labstor_config_->IsUserspaceOnly()) {
+        return;
+    }
+
     //Create kernel work queue region
     labstor::kernel::netlink::ShmemClient shmem;
     nworkers = config["kernel_workers"].size();
@@ -103,18 +135,121 @@ void labstor::Server::WorkOrchestrator::CreateWorkers() {
     }
 }
 
+void labstor::Server::WorkOrchestrator::AddToWorkerGroup(const std::string &name, int worker_id) {
+    for(auto &group : worker_groups_) {
+        if(group.name_ == name) {
+            group.workers_.emplace_back(worker_id);
+            return;
+        }
+    }
+    worker_groups_.emplace_back();
+    worker_groups_.back().name_ = name;
+    worker_groups_.back().qp_type_ = worker_groups_.size();
+    worker_groups_.back().workers_.emplace_back(worker_id);
+}
+
+labstor_qid_type_t labstor::Server::WorkOrchestrator::GetWorkerGroupType(const std::string &name) {
+    for(auto &group : worker_groups_) {
+        if(group.name_ == name) {
+            return group.qp_type_;
+        }
+    }
+    throw UNKNOWN_WORKER_GROUP.format(name);
+}
+
+std::vector<int>& labstor::Server::WorkOrchestrator::GetWorkerGroup(labstor_qid_flags_t flags) {
+    //BATCH and HIGH_LATENCY queues go to throughput workers, everything else is latency-sensitive
+    if(LABSTOR_QP_IS_BATCH(flags) || LABSTOR_QP_IS_HIGH_LATENCY(flags)) {
+        if(throughput_workers_.size()) { return throughput_workers_; }
+    } else {
+        if(latency_workers_.size()) { return latency_workers_; }
+    }
+    return general_workers_;
+}
+
 void labstor::Server::WorkOrchestrator::AssignQueuePair(labstor::ipc::shmem_queue_pair *qp, int worker_id) {
     AUTO_TRACE("")
     LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
     labstor::credentials *creds;
     ipc_manager_->GetRegion(qp, creds);
+    std::lock_guard<std::mutex> lock(lock_);
     auto &server_workers = worker_pool_[pid_];
     if(worker_id < 0) {
         throw NOT_YET_IMPLEMENTED.format("Dynamic work orchestration");
     }
-    worker_id = worker_id % server_workers.size();
+    //Route the QP to its worker group, or else to the workers whose role matches its flags
+    labstor_qid_type_t type = qp->GetQID().type_;
+    std::vector<int> &group = (type && type <= worker_groups_.size()) ?
+            worker_groups_[type - 1].workers_ : GetWorkerGroup(qp->GetQID().flags_);
+    if(group.size()) {
+        worker_id = group[worker_id % group.size()];
+    } else {
+        worker_id = worker_id % server_workers.size();
+    }
     TRACEPOINT(worker_id)
     std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(server_workers[worker_id]->GetWorker());
     worker->AssignQP(qp, creds);
     TRACEPOINT("Depth", worker->GetQueueDepth());
-}
\ No newline at end of file
+}
+
+void labstor::Server::WorkOrchestrator::RemoveQueuePairs(int pid) {
+    AUTO_TRACE(pid)
+    std::lock_guard<std::mutex> lock(lock_);
+    auto &server_workers = worker_pool_[pid_];
+    for(auto &worker_daemon : server_workers) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        worker->RemoveQPs(pid);
+    }
+    //Any worker may hold requests or suspended handlers which refer to the queues
+    for(auto &worker_daemon : server_workers) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        worker->FlushQueuePairs(nullptr, pid);
+    }
+}
+void labstor::Server::WorkOrchestrator::RemoveQueuePair(labstor::ipc::shmem_queue_pair *qp) {
+    AUTO_TRACE(qp->GetQID().Hash())
+    std::lock_guard<std::mutex> lock(lock_);
+    auto &server_workers = worker_pool_[pid_];
+    for(auto &worker_daemon : server_workers) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        if(worker->RemoveQP(qp)) {
+            break;
+        }
+    }
+    //Any worker may hold requests or suspended handlers which refer to the queue
+    for(auto &worker_daemon : server_workers) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        worker->FlushQueuePairs(qp);
+    }
+}
+
+void labstor::Server::WorkOrchestrator::WaitForQuiescence() {
+    AUTO_TRACE("")
+    std::lock_guard<std::mutex> lock(lock_);
+    for(auto &worker_daemon : worker_pool_[pid_]) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        worker->WaitForQuiescence();
+    }
+}
+
+uint32_t labstor::Server::WorkOrchestrator::TakeClientHighWaterMark() {
+    AUTO_TRACE("")
+    uint32_t high_water_mark = 0;
+    std::lock_guard<std::mutex> lock(lock_);
+    for(auto &worker_daemon : worker_pool_[pid_]) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        high_water_mark = std::max(high_water_mark, worker->TakeClientHighWaterMark());
+    }
+    return high_water_mark;
+}
+
+uint64_t labstor::Server::WorkOrchestrator::GetNumMissedDeadlines(uint32_t ns_id) {
+    AUTO_TRACE(ns_id)
+    uint64_t num_missed = 0;
+    std::lock_guard<std::mutex> lock(lock_);
+    for(auto &worker_daemon : worker_pool_[pid_]) {
+        std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(worker_daemon->GetWorker());
+        num_missed += worker->GetNumMissedDeadlines(ns_id);
+    }
+    return num_missed;
+}
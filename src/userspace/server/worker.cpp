@@ -32,33 +32,194 @@
 #include <labstor/userspace/server/ipc_manager.h>
 
 void labstor::Server::Worker::DoWork() {
-    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    bool did_work = false;
+    uint32_t gen = namespace_->GetGeneration();
+    if(gen != cache_gen_) {
+        work_queue_.ClearModuleCache();
+        cache_gen_ = gen;
+    }
     work_queue_depth = work_queue_.GetDepth();
+    labstor::request_scheduler::SetCurrent(&scheduler_);
     LABSTOR_ERROR_HANDLE_TRY {
+        //A queue pair removed from this worker is about to be freed
+        if(flush_pending_.load(std::memory_order_acquire)) {
+            FlushRemovedQueuePairs();
+            flush_pending_.store(false, std::memory_order_release);
+        }
+        //Resume handlers whose sub-requests completed. A module being upgraded waits for these to finish.
+        if(scheduler_.GetNumSuspended() || scheduler_.GetNumOrphaned()) {
+            did_work |= scheduler_.Poll() > 0;
+        }
         for (uint32_t i = 0; i < work_queue_depth; ++i) {
-            if (!work_queue_.Peek(qp_struct, creds, i)) { break; }
-            ipc_manager_->GetQueuePair(qp, qp_struct->GetQID());
-            qp_depth = qp->GetDepth();
-            for (uint32_t j = 0; j < qp_depth; ++j) {
-                if (!qp->Peek(rq, 0)) { break; }
-                module = namespace_->GetModule(rq->GetNamespaceID());
-                if (!module) {
-                    rq->SetCode(-1);
-                    qp->Complete(rq);
-                    TRACEPOINT("Could not find module in namespace", rq->GetNamespaceID())
-                    continue;
-                }
-                bool is_complete = module->ProcessRequest(qp, rq, creds);
-                if(is_complete) {
-                    qp->Dequeue(rq);
-                } else {
-                    break;
-                }
+            entry = work_queue_.PeekEntry(i);
+            if (!entry) { break; }
+            if (!__atomic_load_n(&entry->qp_, __ATOMIC_ACQUIRE)) { continue; }
+            creds = entry->creds_;
+            auto qp = reinterpret_cast<labstor::ipc::shmem_queue_pair*>(entry->qp_ptr_);
+            if(LABSTOR_QP_IS_UNORDERED(qp->GetQID().flags_)) {
+                did_work |= DrainQueue(qp);
+            } else {
+                did_work |= ProcessQueue(qp);
             }
         }
+        if(!edf_.IsEmpty()) {
+            did_work |= ProcessDeadlineQueue();
+        }
     }
     LABSTOR_ERROR_HANDLE_CATCH {
         printf("In worker\n");
         LABSTOR_ERROR_PTR->print();
     };
-}
\ No newline at end of file
+    epoch_.fetch_add(1, std::memory_order_release);
+    if(!did_work && role_ == WorkerRole::kThroughput) {
+        LABSTOR_YIELD();
+    }
+}
+
+template<typename QP>
+bool labstor::Server::Worker::ProcessQueue(QP *qp) {
+    bool did_work = false;
+    qp_depth = qp->GetDepth();
+    TrackHighWaterMark(qp);
+    if(role_ == WorkerRole::kLatency) { qp_depth = 1; }
+    for (uint32_t j = 0; j < qp_depth;) {
+        if (!qp->Peek(rq, 0)) { break; }
+        uint32_t ns_id = rq->GetNamespaceID();
+        //The target module is being upgraded; later requests in this queue must wait behind this one
+        if (namespace_->IsPaused(ns_id)) { break; }
+        did_work = true;
+        module = GetModule(entry, ns_id);
+        if (!module) {
+            qp->Dequeue(rq);
+            rq->SetCode(-1);
+            qp->Complete(rq);
+            TRACEPOINT("Could not find module in namespace", ns_id)
+            ++j;
+            continue;
+        }
+
+        //Gather the requests behind the head which target the same module
+        uint32_t n = 1, max_batch = std::min(max_batch_, qp_depth - j);
+        batch_[0] = rq;
+        while (n < max_batch && qp->Peek(batch_[n], n) && batch_[n]->GetNamespaceID() == ns_id) { ++n; }
+        uint64_t now_ns = 0, late = 0;
+        for (uint32_t k = 0; k < n; ++k) {
+            if(batch_[k]->HasDeadline()) {
+                if(!now_ns) { now_ns = labstor_get_monotonic_ns(); }
+                if(batch_[k]->IsPastDeadline(now_ns)) {
+                    //Marked before the handler runs: the client may reuse the request once it completes
+                    batch_[k]->MarkMissedDeadline();
+                    late |= 1ull << k;
+                }
+            }
+        }
+
+        uint32_t num_complete;
+        if (n == 1) {
+            num_complete = module->ProcessRequest(qp, rq, creds) ? 1 : 0;
+        } else {
+            num_complete = module->ProcessRequestBatch(qp, batch_, n, creds);
+        }
+        for (uint32_t k = 0; k < num_complete; ++k) {
+            qp->Dequeue(rq);
+        }
+        //Requests left queued are counted when a later pass completes them
+        if (late) {
+            uint64_t complete_mask = num_complete < 64 ? (1ull << num_complete) - 1 : ~0ull;
+            CountMissedDeadlines(ns_id, __builtin_popcountll(late & complete_mask));
+        }
+        if (num_complete < n) { break; }
+        j += n;
+    }
+    return did_work;
+}
+
+template<typename QP>
+bool labstor::Server::Worker::DrainQueue(QP *qp) {
+    //Unordered queues may be reordered, so take the requests now and run them by deadline
+    bool did_work = false;
+    qp_depth = qp->GetDepth();
+    TrackHighWaterMark(qp);
+    for (uint32_t j = 0; j < qp_depth && !edf_.IsFull(); ++j) {
+        if (!qp->Dequeue(rq)) { break; }
+        did_work = true;
+        edf_.Push(entry, qp, rq);
+    }
+    return did_work;
+}
+
+bool labstor::Server::Worker::ProcessDeadlineQueue() {
+    bool did_work = false;
+    uint64_t now_ns = labstor_get_monotonic_ns();
+    uint32_t depth = edf_.GetDepth();
+    for (uint32_t j = 0; j < depth && !edf_.IsEmpty(); ++j) {
+        deadline_request drq = edf_.Pop();
+        entry = drq.entry_;
+        auto qp = reinterpret_cast<labstor::ipc::shmem_queue_pair*>(drq.qp_ptr_);
+        rq = drq.rq_;
+        //The QP was removed from this worker after its requests were taken
+        if (!__atomic_load_n(&entry->qp_, __ATOMIC_ACQUIRE) || entry->qp_ptr_ != drq.qp_ptr_) {
+            rq->SetCode(LABSTOR_REQUEST_FAILED);
+            qp->Complete(rq);
+            if (drq.module_) { drq.module_->RemoveStarted(); }
+            TRACEPOINT("Queue pair removed with request pending", rq->GetNamespaceID(), rq->GetRequestID())
+            continue;
+        }
+        creds = entry->creds_;
+        //A request finishes on the instance that started it, even while that instance is being replaced
+        module = drq.module_;
+        if (!module) {
+            if (namespace_->IsPaused(rq->GetNamespaceID())) {
+                edf_retry_.emplace_back(drq);
+                continue;
+            }
+            module = GetModule(entry, rq->GetNamespaceID());
+        }
+        did_work = true;
+        if (!module) {
+            rq->SetCode(-1);
+            qp->Complete(rq);
+            TRACEPOINT("Could not find module in namespace", rq->GetNamespaceID())
+            continue;
+        }
+        uint32_t ns_id = rq->GetNamespaceID();
+        bool late = rq->IsPastDeadline(now_ns);
+        if (late) { rq->MarkMissedDeadline(); }
+        if (module->ProcessRequest(qp, rq, creds)) {
+            CountMissedDeadlines(ns_id, late);
+            if (drq.module_) { drq.module_->RemoveStarted(); }
+        } else {
+            if (!drq.module_) {
+                drq.module_ = module;
+                module->AddStarted();
+            }
+            edf_retry_.emplace_back(drq);
+        }
+    }
+    for(auto &retry : edf_retry_) {
+        edf_.Push(retry);
+    }
+    edf_retry_.clear();
+    return did_work;
+}
+
+//Handlers allocate their sub-requests from the IPC manager for the queue pair they await
+void labstor::Server::Worker::FreeSubRequest(labstor::queue_pair *qp, labstor::ipc::request *rq) {
+    LABSTOR_IPC_MANAGER->FreeRequest<labstor::ipc::request>(qp, rq);
+}
+
+void labstor::Server::Worker::FlushRemovedQueuePairs() {
+    auto removed = [this](labstor::queue_pair *qp) {
+        return qp == flush_qp_ || (!flush_qp_ && qp->GetQID().pid_ == (uint32_t)flush_pid_);
+    };
+    edf_.RemoveIf([&removed](deadline_request &drq) {
+        auto qp = reinterpret_cast<labstor::ipc::shmem_queue_pair*>(drq.qp_ptr_);
+        if (!removed(qp)) { return false; }
+        drq.rq_->SetCode(LABSTOR_REQUEST_FAILED);
+        qp->Complete(drq.rq_);
+        if (drq.module_) { drq.module_->RemoveStarted(); }
+        return true;
+    });
+    scheduler_.Cancel(removed);
+    TRACEPOINT("Flushed removed queue pairs", flush_pid_)
+}
@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/client/client.h>
+#include <labstor/userspace/client/ipc_manager.h>
+
+#include <unistd.h>
+#include <thread>
+
+//No module is registered here, so the server completes requests to it with code -1
+#define UNUSED_NS_ID 1000
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+/*The server only completes requests in queues it polls*/
+void Submit(labstor::queue_pair *qp) {
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    labstor::ipc::qtok_t qtok;
+    labstor::ipc::request *rq = ipc_manager_->AllocRequest<labstor::ipc::request>(qp);
+    rq->Start(0, UNUSED_NS_ID, 0, 0);
+    check(qp->Enqueue(rq, qtok), "Could not enqueue request");
+    rq = ipc_manager_->Wait(qtok);
+    check(rq->GetCode() == (uint32_t)-1, "Request was not completed by the server");
+    ipc_manager_->FreeRequest(qtok, rq);
+}
+
+labstor::queue_pair* Claim(labstor_qid_flags_t flags) {
+    labstor::queue_pair *qp;
+    LABSTOR_IPC_MANAGER->GetQueuePair(qp, flags);
+    return qp;
+}
+
+int main() {
+    LABSTOR_ERROR_HANDLE_START()
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    labstor_qid_flags_t flags = LABSTOR_QP_SHMEM | LABSTOR_QP_PRIMARY | LABSTOR_QP_BATCH;
+    labstor::queue_pair *qp, *other_qp, *shared_qp;
+    ipc_manager_->Connect();
+
+    //The first claim under a non-default flag set creates its shared queue and a dedicated queue
+    qp = Claim(flags);
+    check(qp->GetQID().flags_ == flags, "Claimed a queue with other flags");
+    check(qp->GetQID().cnt_ != 0, "Claim fell back to the shared queue");
+    ipc_manager_->GetSharedQueuePair(shared_qp, flags);
+    check(shared_qp->GetQID().flags_ == flags && shared_qp->GetQID().cnt_ == 0, "Flag set has no shared queue");
+    check(static_cast<labstor::ipc::shmem_queue_pair*>(shared_qp)->IsShared(), "Queue 0 of the flag set is not shared");
+
+    //Another thread gets its own queue of the set
+    std::thread([&other_qp, flags]() {
+        other_qp = Claim(flags);
+        Submit(other_qp);
+    }).join();
+    check(other_qp != qp && other_qp->GetQID().flags_ == flags, "Threads did not claim separate queues");
+    Submit(qp);
+    Submit(shared_qp);
+
+    //Queue sets which are not created on demand are rejected when claimed
+    bool rejected = false;
+    LABSTOR_ERROR_HANDLE_TRY {
+        Claim(LABSTOR_QP_SHMEM | LABSTOR_QP_INTERMEDIATE);
+    } LABSTOR_ERROR_HANDLE_CATCH {
+        rejected = LABSTOR_ERROR_IS(LABSTOR_ERROR_PTR, labstor::INVALID_QP_FLAGS);
+    }
+    check(rejected, "Claimed a queue under flags no queue set exists for");
+    LABSTOR_ERROR_HANDLE_END()
+    printf("SUCCESS\n");
+    return 0;
+}
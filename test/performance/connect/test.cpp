@@ -0,0 +1,106 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/client/client.h>
+#include <labstor/userspace/util/timer.h>
+#include <labmods/ipc_test/client/ipc_test_client.h>
+
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * Connect latency: each trial forks a fresh process, which connects to the trusted server
+ * and issues its first request. Reports how long Connect and the first request took.
+ * */
+
+struct connect_latency {
+    double connect_us_;
+    double first_request_us_;
+};
+
+void run_trial(int fd) {
+    connect_latency lat;
+    labstor::HighResMonotonicTimer t;
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    labstor::IPCTest::Client client;
+
+    t.Resume();
+    ipc_manager_->Connect();
+    lat.connect_us_ = t.GetUsecFromStart();
+    client.GetNamespaceID();
+    client.Start(1);
+    lat.first_request_us_ = t.GetUsecFromStart() - lat.connect_us_;
+    write(fd, &lat, sizeof(lat));
+}
+
+double percentile(std::vector<double> &samples, double pct) {
+    std::sort(samples.begin(), samples.end());
+    return samples[(size_t)((samples.size() - 1) * pct)];
+}
+
+int main(int argc, char **argv) {
+    if(argc != 2) {
+        printf("USAGE: ./test_connect_latency [n_trials]\n");
+        exit(1);
+    }
+    int n_trials = atoi(argv[1]);
+    std::vector<double> connect_us, first_request_us;
+
+    for(int i = 0; i < n_trials; ++i) {
+        int fds[2];
+        pipe(fds);
+        int pid = fork();
+        if(pid == 0) {
+            LABSTOR_ERROR_HANDLE_START()
+            close(fds[0]);
+            run_trial(fds[1]);
+            LABSTOR_ERROR_HANDLE_END()
+            _exit(0);
+        }
+        close(fds[1]);
+        connect_latency lat;
+        if(read(fds[0], &lat, sizeof(lat)) == sizeof(lat)) {
+            connect_us.emplace_back(lat.connect_us_);
+            first_request_us.emplace_back(lat.first_request_us_);
+        }
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+    }
+    if(connect_us.empty()) {
+        printf("No trial connected\n");
+        exit(1);
+    }
+
+    //n_trials,connect_p50_us,connect_p99_us,first_request_p50_us,first_request_p99_us
+    printf("%d,%lf,%lf,%lf,%lf\n",
+           (int)connect_us.size(),
+           percentile(connect_us, .5),
+           percentile(connect_us, .99),
+           percentile(first_request_us, .5),
+           percentile(first_request_us, .99));
+}
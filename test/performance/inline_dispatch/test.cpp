@@ -0,0 +1,204 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/worker.h>
+#include <labstor/userspace/server/dispatch.h>
+#include <labstor/userspace/util/timer.h>
+#include <x86intrin.h>
+
+/*
+ * Compares inline and queued dispatch through a three-stage stack (e.g., filesystem, I/O scheduler, driver)
+ * held in private memory. One I/O at a time is submitted to the first stage and a worker is polled until it
+ * completes, so the time per I/O includes every worker pass the stack needed. With inline dispatch, the first
+ * stage runs the other two on the worker's stack in a single pass; with queued dispatch, each stage enqueues
+ * its sub-request for the next and polls its completion on later passes.
+ * */
+
+#define NUM_STAGES 3
+#define QUEUE_DEPTH 64
+#define MAX_ENTRIES 16
+#define MAX_LABSTACKS 4
+
+/*A namespace in private memory, so that the worker can be run without a server*/
+class BenchNamespace : public labstor::Namespace {
+private:
+    char *region_;
+public:
+    BenchNamespace(uint32_t max_entries) {
+        private_state_.Init(max_entries);
+        uint32_t size = labstor::ipc::route_table::GetSize(max_entries, MAX_LABSTACKS);
+        region_ = (char*)calloc(1, size + 64);
+        routes_.Init(region_, region_ + 64, max_entries, MAX_LABSTACKS);
+    }
+    ~BenchNamespace() {
+        free(region_);
+    }
+    uint32_t Add(labstor::Module *module) {
+        uint32_t ns_id = private_state_.Reserve();
+        module->SetNamespaceID(ns_id);
+        PublishModule(ns_id, module);
+        return ns_id;
+    }
+};
+
+struct BenchQueue {
+    labstor::ipc::shmem_queue_pair qp_;
+    labstor::ipc::request *rqs_;
+    void *region_;
+
+    BenchQueue(int cnt, uint32_t depth) {
+        labstor::ipc::qid_t qid;
+        qid.flags_ = 0;
+        qid.type_ = 0;
+        qid.cnt_ = cnt;
+        qid.pid_ = getpid();
+        qid.ipc_id_ = 0;
+        uint32_t sq_size = labstor::ipc::request_queue::GetSize(depth);
+        uint32_t cq_size = labstor::ipc::request_map::GetSize(depth);
+        region_ = malloc(sq_size + cq_size + depth*sizeof(labstor::ipc::request));
+        qp_.Init(qid, region_, depth, region_, sq_size, LABSTOR_REGION_ADD(sq_size, region_), cq_size);
+        rqs_ = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, region_);
+    }
+    ~BenchQueue() {
+        free(region_);
+    }
+};
+
+/*Forwards each request to the next stage through down_qp as NoOp does, or completes it if it is the last stage*/
+class StageModule : public labstor::Module {
+public:
+    labstor::Namespace *ns_;
+    labstor::queue_pair *down_qp_;
+    uint32_t next_ns_id_;
+    labstor::ipc::request sub_;
+    labstor::ipc::qtok_t sub_qtok_;
+    StageModule(labstor::Namespace *ns, bool inlinable, labstor::queue_pair *down_qp, uint32_t next_ns_id) :
+        labstor::Module("StageModule"), ns_(ns), down_qp_(down_qp), next_ns_id_(next_ns_id) {
+        inlinable_ = inlinable;
+    }
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        labstor::ipc::request *sub = &sub_;
+        if(down_qp_ != nullptr) {
+            switch(request->GetCode()) {
+                case 0: {
+                    sub->Start(0, next_ns_id_, request->GetOp(), 0);
+                    if(!labstor::Server::Dispatch(down_qp_, sub, sub_qtok_, creds, ns_)) {
+                        request->SetCode(1);
+                        return false;
+                    }
+                    break;
+                }
+                case 1: {
+                    if(!down_qp_->IsComplete(sub_qtok_, sub)) {
+                        return false;
+                    }
+                    break;
+                }
+            }
+        }
+        request->SetCode(0);
+        qp->Complete(request);
+        return true;
+    }
+};
+
+struct op_stats {
+    uint64_t cycles_;
+    uint64_t passes_;
+    labstor::HighResMonotonicTimer t_;
+    op_stats() : cycles_(0), passes_(0) {}
+};
+
+void test_dispatch(bool inlinable, int total_ios, op_stats &stats) {
+    BenchNamespace ns(MAX_ENTRIES);
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    std::vector<BenchQueue*> queues;
+    std::vector<StageModule*> modules(NUM_STAGES);
+    labstor::Server::Worker worker(QUEUE_DEPTH, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+    labstor::ipc::qtok_t qtok;
+    labstor::ipc::request *rq;
+    uint64_t start;
+
+    //queues[i] holds the requests of stage i
+    for(int i = 0; i < NUM_STAGES; ++i) {
+        queues.emplace_back(new BenchQueue(i, QUEUE_DEPTH));
+    }
+    uint32_t next_ns_id = LABSTOR_INVALID_NAMESPACE_KEY;
+    for(int i = NUM_STAGES - 1; i >= 0; --i) {
+        labstor::queue_pair *down_qp = (i + 1 < NUM_STAGES) ? &queues[i + 1]->qp_ : nullptr;
+        modules[i] = new StageModule(&ns, inlinable, down_qp, next_ns_id);
+        next_ns_id = ns.Add(modules[i]);
+    }
+    for(auto queue : queues) {
+        worker.AssignQP(&queue->qp_, &creds);
+    }
+
+    stats.t_.Resume();
+    start = __rdtsc();
+    for(int i = 0; i < total_ios; ++i) {
+        rq = &queues[0]->rqs_[0];
+        rq->Start(0, next_ns_id, 0, 0);
+        queues[0]->qp_.Enqueue(rq, qtok);
+        do {
+            worker.DoWork();
+            ++stats.passes_;
+        } while(!queues[0]->qp_.IsComplete(qtok, rq));
+    }
+    stats.cycles_ += __rdtsc() - start;
+    stats.t_.Pause();
+
+    for(int i = 0; i < NUM_STAGES; ++i) {
+        worker.RemoveQP(&queues[i]->qp_);
+        delete queues[i];
+        delete modules[i];
+    }
+}
+
+void print(const char *dispatch, op_stats &stats, int total_ios) {
+    printf("dispatch=%s, stages=%d, cycles/io=%lf, ns/io=%lf, passes/io=%lf\n",
+           dispatch, NUM_STAGES,
+           (double)stats.cycles_/total_ios,
+           stats.t_.GetNsec()/total_ios,
+           (double)stats.passes_/total_ios);
+}
+
+int main(int argc, char **argv) {
+    int total_ios = 100000, reps = 10;
+    op_stats inlined, queued;
+    if(argc >= 2) { total_ios = atoi(argv[1]); }
+    if(argc >= 3) { reps = atoi(argv[2]); }
+    for(int i = 0; i < reps; ++i) {
+        test_dispatch(true, total_ios, inlined);
+        test_dispatch(false, total_ios, queued);
+    }
+    print("inline", inlined, total_ios*reps);
+    print("queued", queued, total_ios*reps);
+    return 0;
+}
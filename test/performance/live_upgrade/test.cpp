@@ -0,0 +1,99 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <labstor/userspace/client/client.h>
+#include <labstor/userspace/util/timer.h>
+#include <labmods/registrar/client/registrar_client.h>
+#include <labmods/dummy/dummy.h>
+
+#include <vector>
+
+/*
+ * Every thread is a tenant with its own queue pair. Each tenant keeps qdepth dummy requests in flight
+ * until time_sec passes and records the longest time a batch took to complete, i.e., the worst-case
+ * pause it observed while modules were being upgraded.
+ * */
+int main(int argc, char **argv) {
+    if(argc < 4) {
+        printf("./labstor_dummy [n_tenants] [qdepth] [time_sec] [key (lab::dummy)] [log.csv]\n");
+        exit(1);
+    }
+    int n_tenants = atoi(argv[1]);
+    int qdepth = atoi(argv[2]);
+    double time_us = atof(argv[3]) * 1000000;
+    std::string key = argc > 4 ? argv[4] : "lab::dummy";
+    FILE *log = argc > 5 ? fopen(argv[5], "a") : nullptr;
+
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    ipc_manager_->Connect();
+    uint32_t ns_id = LABSTOR_REGISTRAR->GetNamespaceID(key);
+    if(ns_id == LABSTOR_INVALID_NAMESPACE_KEY) {
+        printf("%s is not mounted\n", key.c_str());
+        exit(1);
+    }
+
+    std::vector<double> worst_pause_us(n_tenants, 0);
+    std::vector<size_t> num_reqs(n_tenants, 0);
+    omp_set_dynamic(0);
+#pragma omp parallel shared(worst_pause_us, num_reqs) num_threads(n_tenants)
+    {
+        LABSTOR_ERROR_HANDLE_START()
+        int rank = omp_get_thread_num();
+        labstor::queue_pair *qp;
+        labstor::test::Dummy::dummy_request *rq;
+        std::vector<labstor::ipc::qtok_t> qtoks(qdepth);
+        labstor::HighResMonotonicTimer total, batch;
+
+        ipc_manager_->GetQueuePair(qp, 0);
+        total.Resume();
+        while(total.GetUsecFromStart() < time_us) {
+            batch.Reset();
+            batch.Resume();
+            for(int i = 0; i < qdepth; ++i) {
+                rq = ipc_manager_->AllocRequest<labstor::test::Dummy::dummy_request>(qp);
+                rq->Start(ns_id);
+                qp->Enqueue(rq, qtoks[i]);
+            }
+            for(int i = 0; i < qdepth; ++i) {
+                rq = ipc_manager_->Wait<labstor::test::Dummy::dummy_request>(qtoks[i]);
+                ipc_manager_->FreeRequest(qtoks[i], rq);
+            }
+            batch.Pause();
+            worst_pause_us[rank] = std::max(worst_pause_us[rank], batch.GetUsec());
+            num_reqs[rank] += qdepth;
+        }
+        LABSTOR_ERROR_HANDLE_END()
+    }
+
+    for(int rank = 0; rank < n_tenants; ++rank) {
+        printf("tenant=%d,reqs=%lu,worst_pause_us=%lf\n", rank, num_reqs[rank], worst_pause_us[rank]);
+        if(log) {
+            fprintf(log, "%s,%d,%lu,%lf\n", key.c_str(), rank, num_reqs[rank], worst_pause_us[rank]);
+        }
+    }
+    if(log) { fclose(log); }
+}
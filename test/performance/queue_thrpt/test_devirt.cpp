@@ -0,0 +1,126 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/util/timer.h>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+#include <x86intrin.h>
+
+/*
+ * Compares the virtual labstor::queue_pair interface against the devirtualized
+ * labstor::direct_queue_pair path taken by the worker and the client.
+ * */
+
+struct op_stats {
+    uint64_t cycles_;
+    labstor::HighResMonotonicTimer t_;
+    op_stats() : cycles_(0) {}
+};
+
+template<typename QP>
+void run(QP *q, labstor::ipc::request *req_region, int total_reqs, op_stats *stats) {
+    labstor::ipc::request *rq;
+    labstor::ipc::qtok_t qtok;
+    uint64_t start;
+
+    //Enqueue
+    stats[0].t_.Resume();
+    start = __rdtsc();
+    for(int i = 0; i < total_reqs; ++i) {
+        q->Enqueue(&req_region[i], qtok);
+    }
+    stats[0].cycles_ += __rdtsc() - start;
+    stats[0].t_.Pause();
+
+    //Dequeue + Complete
+    stats[1].t_.Resume();
+    start = __rdtsc();
+    for(int i = 0; i < total_reqs; ++i) {
+        q->Dequeue(rq);
+        q->Complete(rq);
+    }
+    stats[1].cycles_ += __rdtsc() - start;
+    stats[1].t_.Pause();
+
+    //IsComplete
+    stats[2].t_.Resume();
+    start = __rdtsc();
+    for(int i = 0; i < total_reqs; ++i) {
+        q->IsComplete(req_region[i].req_id_, rq);
+    }
+    stats[2].cycles_ += __rdtsc() - start;
+    stats[2].t_.Pause();
+}
+
+void print(const char *path, op_stats *stats, int total_reqs) {
+    const char *ops[] = {"enqueue", "dequeue+complete", "is_complete"};
+    for(int i = 0; i < 3; ++i) {
+        printf("path=%s, op=%s, cycles/op=%lf, ns/op=%lf\n",
+               path, ops[i],
+               (double)stats[i].cycles_/total_reqs,
+               stats[i].t_.GetNsec()/total_reqs);
+    }
+}
+
+void test_devirt(int total_reqs, int reps) {
+    labstor::ipc::shmem_queue_pair q;
+    labstor::ipc::request *req_region;
+    size_t sq_size, cq_size;
+    void *region, *sq_region, *cq_region;
+    op_stats virt[3], direct[3];
+    int queue_depth = total_reqs;
+
+    //Allocate region & initialize queue
+    LABSTOR_ERROR_HANDLE_START()
+    sq_size = labstor::ipc::request_queue::GetSize(queue_depth);
+    cq_size = labstor::ipc::request_map::GetSize(queue_depth);
+    region = malloc(sq_size + cq_size + total_reqs*sizeof(labstor::ipc::request));
+    sq_region = region;
+    cq_region = LABSTOR_REGION_ADD(sq_size, region);
+    req_region = (labstor::ipc::request*)LABSTOR_REGION_ADD(cq_size, cq_region);
+    q.Init(0, region, queue_depth, sq_region, sq_size, cq_region, cq_size);
+    LABSTOR_ERROR_HANDLE_END()
+
+    //Hide the dynamic type so the compiler can't devirtualize the virtual path
+    labstor::queue_pair *vq = &q;
+    asm volatile("" : "+r"(vq));
+
+    for(int i = 0; i < reps; ++i) {
+        run<labstor::queue_pair>(vq, req_region, total_reqs, virt);
+        run<labstor::ipc::shmem_queue_pair>(&q, req_region, total_reqs, direct);
+    }
+
+    print("virtual", virt, total_reqs*reps);
+    print("direct", direct, total_reqs*reps);
+    free(region);
+}
+
+int main(int argc, char **argv) {
+    int total_reqs = 4096, reps = 100;
+    if(argc >= 2) { total_reqs = atoi(argv[1]); }
+    if(argc >= 3) { reps = atoi(argv[2]); }
+    test_devirt(total_reqs, reps);
+    return 0;
+}
@@ -0,0 +1,148 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/worker.h>
+#include <labstor/userspace/util/timer.h>
+#include <x86intrin.h>
+
+/*
+ * Measures Worker::DoWork on queue pairs held in private memory. Every pass, each queue pair is given
+ * reqs_per_qp requests for one of num_modules modules, and only the DoWork call itself is timed.
+ * With "uncached", the namespace generation is bumped before each pass so that the worker drops
+ * its ns_id -> Module cache and resolves every module through the namespace again.
+ * */
+
+/*A namespace in private memory, so that the worker can be run without a server*/
+class BenchNamespace : public labstor::Namespace {
+public:
+    BenchNamespace(uint32_t max_entries) {
+        private_state_.Init(max_entries);
+    }
+    uint32_t Add(labstor::Module *module) {
+        uint32_t ns_id = private_state_.Reserve();
+        PublishModule(ns_id, module);
+        return ns_id;
+    }
+};
+
+class NullModule : public labstor::Module {
+public:
+    NullModule() : labstor::Module("NullModule") {}
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        qp->Complete(request);
+        return true;
+    }
+};
+
+struct BenchQueue {
+    labstor::ipc::shmem_queue_pair qp_;
+    labstor::ipc::request *rqs_;
+    void *region_;
+
+    BenchQueue(int cnt, uint32_t depth) {
+        labstor::ipc::qid_t qid;
+        qid.flags_ = 0;
+        qid.type_ = 0;
+        qid.cnt_ = cnt;
+        qid.pid_ = getpid();
+        qid.ipc_id_ = 0;
+        uint32_t sq_size = labstor::ipc::request_queue::GetSize(depth);
+        uint32_t cq_size = labstor::ipc::request_map::GetSize(depth);
+        region_ = malloc(sq_size + cq_size + depth*sizeof(labstor::ipc::request));
+        qp_.Init(qid, region_, depth, region_, sq_size, LABSTOR_REGION_ADD(sq_size, region_), cq_size);
+        rqs_ = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, region_);
+    }
+    ~BenchQueue() {
+        free(region_);
+    }
+};
+
+void test_dowork(int num_qps, int reqs_per_qp, int num_modules, int passes, bool uncached) {
+    BenchNamespace ns(64);
+    std::vector<NullModule> modules(num_modules);
+    std::vector<uint32_t> ns_ids;
+    std::vector<BenchQueue*> queues;
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    labstor::HighResMonotonicTimer t;
+    labstor::ipc::request *done;
+    labstor::ipc::qtok_t qtok;
+    uint64_t cycles = 0, start;
+
+    LABSTOR_ERROR_HANDLE_START()
+    for(auto &module : modules) {
+        ns_ids.emplace_back(ns.Add(&module));
+    }
+    labstor::Server::Worker worker(num_qps, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+    for(int i = 0; i < num_qps; ++i) {
+        queues.emplace_back(new BenchQueue(i, reqs_per_qp));
+        worker.AssignQP(&queues.back()->qp_, &creds);
+    }
+
+    for(int pass = 0; pass < passes; ++pass) {
+        for(int i = 0; i < num_qps; ++i) {
+            for(int j = 0; j < reqs_per_qp; ++j) {
+                labstor::ipc::request *rq = &queues[i]->rqs_[j];
+                rq->Start(0, ns_ids[(i + j) % num_modules], 0, 0);
+                queues[i]->qp_.Enqueue(rq, qtok);
+            }
+        }
+        if(uncached) { ns.MarkModified(); }
+        t.Resume();
+        start = __rdtsc();
+        worker.DoWork();
+        cycles += __rdtsc() - start;
+        t.Pause();
+        for(int i = 0; i < num_qps; ++i) {
+            for(int j = 0; j < reqs_per_qp; ++j) {
+                queues[i]->qp_.IsComplete(queues[i]->rqs_[j].GetRequestID(), done);
+            }
+        }
+    }
+    LABSTOR_ERROR_HANDLE_END()
+
+    uint64_t total_reqs = (uint64_t)passes*num_qps*reqs_per_qp;
+    printf("cache=%s, num_qps=%d, reqs_per_qp=%d, num_modules=%d, cycles/req=%lf, ns/req=%lf, ns/pass=%lf\n",
+           uncached ? "off" : "on", num_qps, reqs_per_qp, num_modules,
+           (double)cycles/total_reqs, t.GetNsec()/total_reqs, t.GetNsec()/passes);
+    for(auto queue : queues) {
+        delete queue;
+    }
+}
+
+int main(int argc, char **argv) {
+    int num_qps = 16, reqs_per_qp = 1, num_modules = 4, passes = 100000;
+    if(argc >= 2) { num_qps = atoi(argv[1]); }
+    if(argc >= 3) { reqs_per_qp = atoi(argv[2]); }
+    if(argc >= 4) { num_modules = atoi(argv[3]); }
+    if(argc >= 5) { passes = atoi(argv[4]); }
+    test_dowork(num_qps, reqs_per_qp, num_modules, passes, false);
+    test_dowork(num_qps, reqs_per_qp, num_modules, passes, true);
+    return 0;
+}
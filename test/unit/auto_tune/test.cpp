@@ -0,0 +1,130 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/auto_tuner.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+void write(const std::string &path, const std::string &value) {
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    std::ofstream(path) << value << "\n";
+}
+
+/*Two NUMA nodes with two SMT cores each: cpus 0-3 on node 0 and cpus 4-7 on node 1*/
+std::string MakeSysfs() {
+    std::string root = std::filesystem::temp_directory_path().string() + "/labstor_auto_tune_sysfs";
+    std::filesystem::remove_all(root);
+    write(root + "/devices/system/cpu/online", "0-7");
+    for(int cpu = 0; cpu < 8; ++cpu) {
+        std::string path = root + "/devices/system/cpu/cpu" + std::to_string(cpu);
+        write(path + "/topology/core_id", std::to_string((cpu % 4) / 2));
+        write(path + "/topology/physical_package_id", std::to_string(cpu / 4));
+    }
+    write(root + "/devices/system/cpu/cpu0/cache/index0/level", "1");
+    write(root + "/devices/system/cpu/cpu0/cache/index0/type", "Data");
+    write(root + "/devices/system/cpu/cpu0/cache/index0/size", "32K");
+    write(root + "/devices/system/cpu/cpu0/cache/index3/level", "3");
+    write(root + "/devices/system/cpu/cpu0/cache/index3/type", "Unified");
+    write(root + "/devices/system/cpu/cpu0/cache/index3/size", "2M");
+    write(root + "/devices/system/cpu/cpu0/cache/index3/coherency_line_size", "64");
+    write(root + "/devices/system/node/node0/cpulist", "0-3");
+    write(root + "/devices/system/node/node1/cpulist", "4-7");
+    return root;
+}
+
+int main() {
+    check(labstor::Server::AutoTuner::ParseCpuList("0-2,5,7-8\n") == std::vector<int>({0, 1, 2, 5, 7, 8}), "Bad cpu list");
+
+    std::string root = MakeSysfs();
+    labstor::Server::CpuTopology topo = labstor::Server::AutoTuner::ReadTopology(root);
+    check(topo.cpus_.size() == 8, "Wrong number of CPUs");
+    check(topo.num_nodes_ == 2, "Wrong number of NUMA nodes");
+    check(topo.llc_size_kb_ == 2048, "Wrong LLC size");
+    check(topo.cpus_[5].node_id_ == 1 && topo.cpus_[5].core_id_ == 0, "Wrong CPU placement");
+
+    //Explicit values are kept; "auto" and missing values are derived
+    YAML::Node config = YAML::Load(
+        "admin_thread: auto\n"
+        "profile: kernel\n"
+        "auto_tune: {enabled: true, min_queue_depth: 64, max_queue_depth: 1024}\n"
+        "work_orchestrator: {work_queue_depth: 128, server_workers: auto}\n"
+        "ipc_manager:\n"
+        "  client: {queue_depth: auto, request_unit_bytes: 200}\n"
+        "  private: {num_queues: 3}\n");
+    labstor::Server::AutoTuner tuner;
+    tuner.Tune(config, topo);
+    check(config["admin_thread"].as<int>() == 0, "Admin thread is not on the first CPU");
+
+    //Four cores minus the admin's core, less one kernel worker per node
+    auto server_workers = config["work_orchestrator"]["server_workers"];
+    auto kernel_workers = config["work_orchestrator"]["kernel_workers"];
+    check(server_workers.size() == 1 && kernel_workers.size() == 2, "Wrong worker split");
+    std::set<int> worker_cpus;
+    for(auto worker : server_workers) { worker_cpus.emplace(worker["cpu_id"].as<int>()); }
+    for(auto worker : kernel_workers) { worker_cpus.emplace(worker["cpu_id"].as<int>()); }
+    check(worker_cpus == std::set<int>({2, 4, 6}), "Workers must use one SMT thread per non-admin core");
+
+    //Derived sizes always satisfy LoadMemoryConfig
+    auto client = config["ipc_manager"]["client"];
+    check(client["request_unit_bytes"].as<uint32_t>() == 200, "Explicit request unit was overwritten");
+    check(config["ipc_manager"]["kernel"]["request_unit_bytes"].as<uint32_t>() == 64, "Request units are not cache-line aligned");
+    check(client["num_queues"].as<uint32_t>() == 1 && client["max_queues"].as<uint32_t>() == 4, "Wrong queue counts");
+    check(client["queue_depth"].as<uint32_t>() == 1024, "Client depth ignores max_queue_depth");
+    check(config["ipc_manager"]["private"]["num_queues"].as<uint32_t>() == 3, "Explicit value was overwritten");
+    for(auto type : {"client", "kernel", "private"}) {
+        auto conf = config["ipc_manager"][type];
+        uint32_t max_queues = conf["max_queues"] ? conf["max_queues"].as<uint32_t>() : conf["num_queues"].as<uint32_t>();
+        uint64_t queue_region = (uint64_t)max_queues * labstor::ipc::shmem_queue_pair::GetSize(conf["queue_depth"].as<uint32_t>());
+        uint64_t region = conf["max_region_size_kb"].as<uint64_t>() * labstor::SizeType::KB;
+        check(queue_region < region, "Queue region does not fit");
+        check(region - queue_region >= conf["min_request_region_kb"].as<uint64_t>() * labstor::SizeType::KB, "Request region does not fit");
+    }
+
+    //The userspace-only profile has no kernel workers
+    YAML::Node userspace = YAML::Load("profile: userspace-only\nwork_orchestrator: {}\nipc_manager: {}\n");
+    tuner.Tune(userspace, topo);
+    check(userspace["work_orchestrator"]["server_workers"].size() == 3, "Userspace-only should use every non-admin core");
+    check(userspace["work_orchestrator"]["kernel_workers"].size() == 0, "Userspace-only has no kernel workers");
+
+    //Depths grow near full, shrink when mostly idle, and stay within bounds
+    check(labstor::Server::AutoTuner::AdjustQueueDepth(256, 200, 64, 1024) == 512, "Depth did not grow");
+    check(labstor::Server::AutoTuner::AdjustQueueDepth(1024, 1024, 64, 1024) == 1024, "Depth exceeded its bound");
+    check(labstor::Server::AutoTuner::AdjustQueueDepth(256, 100, 64, 1024) == 256, "Depth changed without cause");
+    check(labstor::Server::AutoTuner::AdjustQueueDepth(256, 10, 64, 1024) == 128, "Depth did not shrink");
+    check(labstor::Server::AutoTuner::AdjustQueueDepth(64, 0, 64, 1024) == 64, "Depth fell below its bound");
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
@@ -0,0 +1,218 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/types/coroutine.h>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+
+#include <cstdint>
+
+/*
+ * A handler forwards its request to a downstream queue, suspends on the sub-request,
+ * and completes once the downstream "worker" completes the sub-request.
+ * */
+
+uint32_t num_freed = 0;
+std::vector<void*> regions;
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+labstor::request_task handler(labstor::queue_pair *down_qp, labstor::ipc::request *sub_rq, int &stage) {
+    //Frames must keep the alignment of operator new so that over-aligned locals are valid
+    alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) char local[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+    check((uintptr_t)local % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0, "Misaligned coroutine frame");
+    labstor::ipc::qtok_t qtok;
+    stage = 1;
+    down_qp->Enqueue(sub_rq, qtok);
+    labstor::ipc::request *done = co_await labstor::await_qtok<>(down_qp, qtok);
+    check(done == sub_rq, "Resumed with the wrong sub-request");
+    stage = 2;
+}
+
+void free_sub_request(labstor::queue_pair *qp, labstor::ipc::request *rq) {
+    ++num_freed;
+}
+
+struct frame_local {
+    uint32_t *num_destroyed_;
+    ~frame_local() { ++(*num_destroyed_); }
+};
+
+labstor::request_task failing_handler(labstor::queue_pair *down_qp, labstor::ipc::request *sub_rq, uint32_t &num_destroyed) {
+    frame_local local{&num_destroyed};
+    labstor::ipc::qtok_t qtok;
+    down_qp->Enqueue(sub_rq, qtok);
+    co_await labstor::await_qtok<>(down_qp, qtok);
+    throw labstor::Error(1000, "Handler failed after resuming").format();
+}
+
+labstor::ipc::request* init_qp(labstor::ipc::shmem_queue_pair &qp, int depth) {
+    size_t sq_size = labstor::ipc::request_queue::GetSize(depth);
+    size_t cq_size = labstor::ipc::request_map::GetSize(depth);
+    void *region = malloc(sq_size + cq_size + depth*sizeof(labstor::ipc::request));
+    regions.emplace_back(region);
+    qp.Init(0, region, depth, region, sq_size, LABSTOR_REGION_ADD(sq_size, region), cq_size);
+    return (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, region);
+}
+
+int main() {
+    int nreqs = 64;
+    uint32_t held_ns = 2;
+    labstor::ipc::shmem_queue_pair up_qp, down_qp, orphan_up_qp, orphan_down_qp;
+    labstor::request_scheduler scheduler;
+    labstor::ipc::request *up_rqs, *sub_rqs, *orphan_up_rqs, *orphan_sub_rqs;
+    labstor::ipc::qtok_t qtok;
+    std::vector<int> stages(nreqs, 0);
+    std::atomic<uint32_t> num_suspended(0);
+    labstor::ipc::request *rq;
+
+    LABSTOR_ERROR_HANDLE_START()
+    up_rqs = init_qp(up_qp, nreqs);
+    sub_rqs = init_qp(down_qp, nreqs);
+    orphan_up_rqs = init_qp(orphan_up_qp, nreqs);
+    orphan_sub_rqs = init_qp(orphan_down_qp, nreqs);
+    scheduler.Init(free_sub_request);
+    labstor::request_scheduler::SetCurrent(&scheduler);
+
+    //Start every handler as a worker would; each one suspends on its sub-request.
+    //Handlers in the last quarter belong to a namespace which is held below.
+    for(int i = 0; i < nreqs; ++i) {
+        check(up_qp.Enqueue(&up_rqs[i], qtok), "Could not enqueue upstream request");
+        check(up_qp.Dequeue(rq), "Could not dequeue upstream request");
+        uint32_t ns_id = i < 3*nreqs/4 ? 1 : held_ns;
+        scheduler.SetOrigin(labstor::request_origin{&up_qp, rq, ns_id, &num_suspended});
+        auto handle = handler(&down_qp, &sub_rqs[i], stages[i]).Release();
+        scheduler.SetOrigin(labstor::request_origin());
+        check(!handle.done(), "Handler did not suspend");
+        check(stages[i] == 1, "Handler did not start");
+    }
+    check(scheduler.GetNumSuspended() == (uint32_t)nreqs, "Wrong number of suspended handlers");
+    check(num_suspended == (uint32_t)nreqs, "Suspended handlers were not counted");
+    check(scheduler.Poll() == 0, "Resumed a handler before its sub-request completed");
+
+    //Complete half of the sub-requests downstream
+    for(int i = 0; i < nreqs/2; ++i) {
+        check(down_qp.Dequeue(rq), "Could not dequeue sub-request");
+        down_qp.Complete(rq);
+    }
+    check(scheduler.Poll() == (uint32_t)nreqs/2, "Wrong number of handlers resumed");
+    check(scheduler.GetNumSuspended() == (uint32_t)nreqs/2, "Resumed handlers are still suspended");
+    check(num_suspended == (uint32_t)nreqs/2, "Resumed handlers are still counted");
+    for(int i = 0; i < nreqs; ++i) {
+        check(stages[i] == (i < nreqs/2 ? 2 : 1), "Wrong handler resumed");
+    }
+
+    //Complete the rest; handlers of the held namespace must stay suspended
+    while(down_qp.Dequeue(rq)) {
+        down_qp.Complete(rq);
+    }
+    auto hold = [held_ns](uint32_t ns_id) { return ns_id == held_ns; };
+    check(scheduler.Poll(hold) == (uint32_t)nreqs/4, "Held handlers were resumed");
+    check(scheduler.GetNumSuspended() == (uint32_t)nreqs/4, "Wrong number of held handlers");
+    for(int i = 0; i < nreqs; ++i) {
+        check(stages[i] == (i < 3*nreqs/4 ? 2 : 1), "Held handler was resumed");
+    }
+
+    //Cancel the held handlers: their frames are destroyed and their requests fail upstream
+    check(num_freed == 0, "Freed a sub-request of a running handler");
+    uint32_t cancelled = scheduler.Cancel([&up_qp](labstor::queue_pair *qp) {
+        return qp == &up_qp;
+    });
+    check(cancelled == (uint32_t)nreqs/4, "Wrong number of handlers cancelled");
+    check(num_freed == (uint32_t)nreqs/4, "Completed sub-requests of cancelled handlers were not freed");
+    check(scheduler.GetNumOrphaned() == 0, "Completed sub-requests were orphaned");
+    check(scheduler.GetNumSuspended() == 0, "Cancelled handlers are still suspended");
+    check(num_suspended == 0, "Cancelled handlers are still counted");
+    for(int i = 3*nreqs/4; i < nreqs; ++i) {
+        check(stages[i] == 1, "Cancelled handler was resumed");
+        check(up_qp.IsComplete(up_rqs[i].GetRequestID(), rq), "Cancelled request was not completed");
+        check(rq->GetCode() == (uint32_t)LABSTOR_REQUEST_FAILED, "Cancelled request did not fail");
+    }
+
+    //Cancel handlers whose sub-requests are still in flight: the sub-requests are freed as they complete
+    num_freed = 0;
+    std::vector<int> orphan_stages(nreqs, 0);
+    for(int i = 0; i < nreqs; ++i) {
+        check(orphan_up_qp.Enqueue(&orphan_up_rqs[i], qtok), "Could not enqueue upstream request");
+        check(orphan_up_qp.Dequeue(rq), "Could not dequeue upstream request");
+        scheduler.SetOrigin(labstor::request_origin{&orphan_up_qp, rq, 1, &num_suspended});
+        handler(&orphan_down_qp, &orphan_sub_rqs[i], orphan_stages[i]).Release();
+        scheduler.SetOrigin(labstor::request_origin());
+    }
+    cancelled = scheduler.Cancel([&orphan_up_qp](labstor::queue_pair *qp) {
+        return qp == &orphan_up_qp;
+    });
+    check(cancelled == (uint32_t)nreqs, "Wrong number of in-flight handlers cancelled");
+    check(num_suspended == 0, "Cancelled in-flight handlers are still counted");
+    check(num_freed == 0, "Freed a sub-request which is still in flight");
+    check(scheduler.GetNumOrphaned() == (uint32_t)nreqs, "In-flight sub-requests were not orphaned");
+    for(int i = 0; i < nreqs/2; ++i) {
+        check(orphan_down_qp.Dequeue(rq), "Could not dequeue orphaned sub-request");
+        orphan_down_qp.Complete(rq);
+    }
+    check(scheduler.Poll() == 0, "Resumed a cancelled handler");
+    check(num_freed == (uint32_t)nreqs/2, "Completed orphans were not freed");
+    check(scheduler.GetNumOrphaned() == (uint32_t)nreqs/2, "Completed orphans are still tracked");
+    for(int i = 0; i < nreqs; ++i) {
+        check(orphan_stages[i] == 1, "Cancelled in-flight handler was resumed");
+    }
+
+    //Orphans of a queue pair being torn down go with it
+    cancelled = scheduler.Cancel([&orphan_down_qp](labstor::queue_pair *qp) {
+        return qp == &orphan_down_qp;
+    });
+    check(cancelled == 0, "Cancelled a handler which was not suspended");
+    check(scheduler.GetNumOrphaned() == 0, "Orphans of a removed queue pair are still tracked");
+    check(num_freed == (uint32_t)nreqs/2, "Freed a sub-request of a removed queue pair");
+
+    //A handler which throws once resumed is destroyed and its request fails upstream
+    uint32_t num_destroyed = 0;
+    check(up_qp.Enqueue(&up_rqs[0], qtok), "Could not enqueue upstream request");
+    check(up_qp.Dequeue(rq), "Could not dequeue upstream request");
+    labstor::ipc::request *failed_rq = rq;
+    scheduler.SetOrigin(labstor::request_origin{&up_qp, failed_rq, 1, &num_suspended});
+    failing_handler(&down_qp, &sub_rqs[0], num_destroyed).Release();
+    scheduler.SetOrigin(labstor::request_origin());
+    check(num_suspended == 1, "Failing handler did not suspend");
+    check(down_qp.Dequeue(rq), "Could not dequeue sub-request of failing handler");
+    down_qp.Complete(rq);
+    check(scheduler.Poll() == 1, "Failing handler was not resumed");
+    check(num_destroyed == 1, "Frame of failing handler was not destroyed");
+    check(scheduler.GetNumSuspended() == 0, "Failing handler is still suspended");
+    check(num_suspended == 0, "Failing handler is still counted");
+    check(up_qp.IsComplete(failed_rq->GetRequestID(), rq), "Request of failing handler was not completed");
+    check(rq->GetCode() == (uint32_t)LABSTOR_REQUEST_FAILED, "Request of failing handler did not fail");
+    LABSTOR_ERROR_HANDLE_END()
+    for(void *region : regions) {
+        free(region);
+    }
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -0,0 +1,246 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/dispatch.h>
+
+#define QUEUE_DEPTH 64
+#define MAX_ENTRIES 16
+#define MAX_LABSTACKS 4
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+/*A namespace in private memory, with a route table so stages can be pinned to a worker group*/
+class TestNamespace : public labstor::Namespace {
+private:
+    char *region_;
+public:
+    TestNamespace(uint32_t max_entries) {
+        private_state_.Init(max_entries);
+        uint32_t size = labstor::ipc::route_table::GetSize(max_entries, MAX_LABSTACKS);
+        region_ = (char*)calloc(1, size + 64);
+        routes_.Init(region_, region_ + 64, max_entries, MAX_LABSTACKS);
+    }
+    ~TestNamespace() {
+        free(region_);
+    }
+    uint32_t Add(labstor::Module *module) {
+        uint32_t ns_id = private_state_.Reserve();
+        module->SetNamespaceID(ns_id);
+        PublishModule(ns_id, module);
+        return ns_id;
+    }
+    /*Route ns_id to the worker group serving queue pairs of qp_type, as a mounted LabStack would*/
+    void Pin(uint32_t ns_id, labstor_qid_type_t qp_type) {
+        labstor::ipc::labstack_routes *table = routes_.AllocRoutes();
+        memset(table, 0, sizeof(*table));
+        table->mount_ns_id_ = ns_id;
+        table->num_stages_ = 1;
+        table->stages_[0].ns_id_ = ns_id;
+        table->stages_[0].qp_type_ = qp_type;
+        routes_.Publish(table);
+    }
+};
+
+/*
+ * An inlinable stage. It completes each request, or returns false without completing it the way a
+ * handler waiting on a device would, or forwards it to next_ns_id through Dispatch as NoOp does.
+ * */
+class StubModule : public labstor::Module {
+public:
+    labstor::Namespace *ns_;
+    bool blocks_;
+    uint32_t next_ns_id_;
+    uint32_t num_calls_, max_depth_;
+    labstor::queue_pair *last_qp_;
+    labstor::ipc::request sub_;
+    labstor::ipc::qtok_t sub_qtok_;
+    StubModule(labstor::Namespace *ns, bool inlinable = true) : labstor::Module("StubModule"), ns_(ns), blocks_(false),
+        next_ns_id_(LABSTOR_INVALID_NAMESPACE_KEY), num_calls_(0), max_depth_(0), last_qp_(nullptr) {
+        inlinable_ = inlinable;
+    }
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        ++num_calls_;
+        max_depth_ = std::max(max_depth_, labstor::Server::GetInlineDepth());
+        last_qp_ = qp;
+        if(blocks_) {
+            request->SetCode(1);
+            return false;
+        }
+        if(next_ns_id_ != (uint32_t)LABSTOR_INVALID_NAMESPACE_KEY) {
+            labstor::ipc::request *sub = &sub_;
+            sub->Start(0, next_ns_id_, 0, 0);
+            if(!labstor::Server::Dispatch(qp, sub, sub_qtok_, creds, ns_)) {
+                request->SetCode(1);
+                return false;
+            }
+        }
+        qp->Complete(request);
+        return true;
+    }
+};
+
+/*A queue pair and its requests in private memory*/
+struct TestQueue {
+    labstor::ipc::shmem_queue_pair qp_;
+    labstor::ipc::request *rqs_;
+    void *region_;
+
+    TestQueue(uint32_t depth = QUEUE_DEPTH) {
+        labstor::ipc::qid_t qid;
+        qid.flags_ = 0;
+        qid.type_ = 0;
+        qid.cnt_ = 0;
+        qid.pid_ = getpid();
+        qid.ipc_id_ = 0;
+        uint32_t sq_size = labstor::ipc::request_queue::GetSize(depth);
+        uint32_t cq_size = labstor::ipc::request_map::GetSize(depth);
+        region_ = malloc(sq_size + cq_size + depth*sizeof(labstor::ipc::request));
+        qp_.Init(qid, region_, depth, region_, sq_size, LABSTOR_REGION_ADD(sq_size, region_), cq_size);
+        rqs_ = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, region_);
+    }
+    ~TestQueue() {
+        free(region_);
+    }
+    labstor::ipc::request* Start(int i, uint32_t ns_id) {
+        labstor::ipc::request *rq = &rqs_[i];
+        rq->Start(0, ns_id, 0, 0);
+        return rq;
+    }
+};
+
+/*An inlinable stage completes on the caller's thread without touching either queue*/
+void TestInline(labstor::credentials *creds) {
+    TestNamespace ns(MAX_ENTRIES);
+    StubModule module(&ns);
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue;
+    labstor::ipc::qtok_t qtok;
+    labstor::ipc::request *rq = queue.Start(0, ns_id), *done;
+
+    check(labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Inlinable stage did not complete inline");
+    check(rq == &queue.rqs_[0] && module.num_calls_ == 1, "Inline completion returned the wrong request");
+    check(module.max_depth_ == 1 && labstor::Server::GetInlineDepth() == 0, "Inline depth was not restored");
+    check(module.last_qp_ != &queue.qp_, "Inlined stage was given the caller's queue pair");
+    check(queue.qp_.GetDepth() == 0, "Inline request was enqueued");
+    check(!queue.qp_.IsComplete(rq->GetRequestID(), done), "Inline completion was published to the completion queue");
+}
+
+/*A stage which would block is left to a worker, which resumes it from the progress it left in the request*/
+void TestBlocking(labstor::credentials *creds) {
+    TestNamespace ns(MAX_ENTRIES);
+    StubModule module(&ns);
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue;
+    labstor::ipc::qtok_t qtok;
+    labstor::ipc::request *rq = queue.Start(0, ns_id), *head;
+
+    module.blocks_ = true;
+    check(!labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Blocking stage reported completion");
+    check(module.num_calls_ == 1 && labstor::Server::GetInlineDepth() == 0, "Blocking stage was not tried inline");
+    check(queue.qp_.GetDepth() == 1 && queue.qp_.Peek(head, 0) && head == rq, "Blocking request was not enqueued");
+    check(qtok.req_id_ == rq->GetRequestID() && rq->GetCode() == 1, "Blocking request lost its progress");
+}
+
+/*A chain of inlinable stages is inlined up to LABSTOR_MAX_INLINE_DEPTH deep, then falls back to the queue*/
+void TestDepthCap(labstor::credentials *creds) {
+    TestNamespace ns(MAX_ENTRIES);
+    std::vector<StubModule*> modules;
+    std::vector<uint32_t> ns_ids;
+    TestQueue queue;
+    labstor::ipc::qtok_t qtok;
+
+    for(int i = 0; i < LABSTOR_MAX_INLINE_DEPTH + 2; ++i) {
+        modules.emplace_back(new StubModule(&ns));
+        ns_ids.emplace_back(ns.Add(modules.back()));
+    }
+    for(int i = 0; i < LABSTOR_MAX_INLINE_DEPTH + 1; ++i) {
+        modules[i]->next_ns_id_ = ns_ids[i + 1];
+    }
+    labstor::ipc::request *rq = queue.Start(0, ns_ids[0]), *head;
+    check(!labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Inlined past the depth cap");
+    for(int i = 0; i < LABSTOR_MAX_INLINE_DEPTH; ++i) {
+        check(modules[i]->num_calls_ == 1 && modules[i]->max_depth_ == (uint32_t)i + 1, "Stage below the cap was not inlined");
+    }
+    check(modules[LABSTOR_MAX_INLINE_DEPTH]->num_calls_ == 0, "Stage past the cap was called inline");
+    check(labstor::Server::GetInlineDepth() == 0, "Inline depth was not restored");
+
+    //The request past the cap is queued first, then each stage which was waiting on it, out to the caller's
+    check(queue.qp_.GetDepth() == LABSTOR_MAX_INLINE_DEPTH + 1, "Waiting stages were not enqueued");
+    check(queue.qp_.Peek(head, 0) && head == &modules[LABSTOR_MAX_INLINE_DEPTH - 1]->sub_,
+          "Stage past the cap was not enqueued");
+    check(head->GetNamespaceID() == ns_ids[LABSTOR_MAX_INLINE_DEPTH], "Enqueued the request for the wrong stage");
+    check(queue.qp_.Peek(head, LABSTOR_MAX_INLINE_DEPTH) && head == rq && rq->GetCode() == 1,
+          "The caller's request was not enqueued with its progress");
+    for(auto module : modules) {
+        delete module;
+    }
+}
+
+/*Stages which are being upgraded, pinned to another worker group, or not inlinable always go through the queue*/
+void TestSkipped(labstor::credentials *creds) {
+    TestNamespace ns(MAX_ENTRIES);
+    StubModule paused(&ns), pinned(&ns), queued(&ns, false);
+    uint32_t paused_ns = ns.Add(&paused);
+    uint32_t pinned_ns = ns.Add(&pinned);
+    uint32_t queued_ns = ns.Add(&queued);
+    TestQueue queue;
+    labstor::ipc::qtok_t qtok;
+    labstor::ipc::request *rq;
+
+    ns.PauseModule(paused_ns);
+    ns.Pin(pinned_ns, 1);
+    rq = queue.Start(0, paused_ns);
+    check(!labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Paused stage completed inline");
+    rq = queue.Start(1, pinned_ns);
+    check(!labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Pinned stage completed inline");
+    rq = queue.Start(2, queued_ns);
+    check(!labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Non-inlinable stage completed inline");
+    check(paused.num_calls_ == 0 && pinned.num_calls_ == 0 && queued.num_calls_ == 0, "Skipped stage was called inline");
+    check(queue.qp_.GetDepth() == 3, "Skipped stages were not enqueued");
+
+    //An unpinned stage is inlined again once its upgrade finishes
+    ns.ResumeModule(paused_ns);
+    rq = queue.Start(3, paused_ns);
+    check(labstor::Server::Dispatch(&queue.qp_, rq, qtok, creds, &ns), "Resumed stage was not inlined");
+}
+
+int main() {
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    TestInline(&creds);
+    TestBlocking(&creds);
+    TestDepthCap(&creds);
+    TestSkipped(&creds);
+    printf("SUCCESS\n");
+}
@@ -0,0 +1,108 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labmods/generic_posix/client/generic_posix_client.h>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+class TestPosix : public labstor::Posix::Client {
+public:
+    TestPosix() : labstor::Posix::Client(labstor::id("TestPosix")) {}
+    void Register(YAML::Node) override {}
+    void Initialize(int) override {}
+    int Open(int fd, const char*, int, int) override { return fd; }
+    int Close(int) override { return 0; }
+    labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops, int, void*, size_t, ssize_t) override { return labstor::ipc::qtok_t(); }
+    labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops, int, void*, ssize_t) override { return labstor::ipc::qtok_t(); }
+    ssize_t IO(labstor::GenericPosix::Ops, int, void*, size_t, ssize_t size) override { return size; }
+    ssize_t IO(labstor::GenericPosix::Ops, int, void*, ssize_t size) override { return size; }
+};
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+int main() {
+    TestPosix module;
+    labstor::GenericPosix::FDTable table(LABSTOR_FD_MIN, 16);
+    int fd = LABSTOR_FD_MIN + 3;
+    labstor::GenericPosix::FDEntry *entry;
+
+    check(table.Acquire(fd) == nullptr, "Acquired an fd that was never installed");
+    check(table.Acquire(LABSTOR_FD_MIN - 1) == nullptr, "Acquired an fd outside the table");
+    table.Install(fd, &module, 7, 0);
+    entry = table.Acquire(fd);
+    check(entry != nullptr && entry->ns_id_ == 7, "Failed to acquire an installed fd");
+
+    //A short transfer only advances the offset by the bytes transferred
+    size_t off = entry->ReserveOffset(100);
+    entry->CommitOffset(off, 100, 40);
+    check(entry->ReserveOffset(0) == 40, "Short transfer advanced by the requested size");
+
+    //A failed transfer does not move the offset
+    off = entry->ReserveOffset(100);
+    entry->CommitOffset(off, 100, -1);
+    check(entry->ReserveOffset(0) == 40, "Failed transfer moved the offset");
+
+    //A reservation made after a short transfer started keeps its range
+    off = entry->ReserveOffset(100);
+    size_t next = entry->ReserveOffset(50);
+    entry->CommitOffset(off, 100, 10);
+    entry->CommitOffset(next, 50, 50);
+    check(next == 140 && entry->ReserveOffset(0) == 190, "Short transfer overlapped a later reservation");
+    table.Release(entry);
+
+    //Threads sharing the fd never overlap
+    int num_threads = 8, num_ios = 1000;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&]() {
+            for(int j = 0; j < num_ios; ++j) {
+                labstor::GenericPosix::FDEntry *shared = table.Acquire(fd);
+                size_t shared_off = shared->ReserveOffset(8);
+                shared->CommitOffset(shared_off, 8, 8);
+                table.Release(shared);
+            }
+        });
+    }
+    for(auto &thread : threads) {
+        thread.join();
+    }
+    entry = table.Acquire(fd);
+    check(entry->ReserveOffset(0) == 190 + (size_t)num_threads*num_ios*8, "Concurrent transfers lost an update");
+    table.Release(entry);
+
+    //Closing waits for references and hides the fd
+    check(table.Remove(fd) == &module, "Failed to remove an installed fd");
+    check(table.Acquire(fd) == nullptr, "Acquired a removed fd");
+    check(table.Remove(fd) == nullptr, "Removed an fd twice");
+    printf("Finished fd table test\n");
+}
@@ -0,0 +1,145 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/types/labstack_dag.h>
+#include <labstor/types/data_structures/shmem_route_table.h>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#define MAX_ENTRIES 64
+#define MAX_LABSTACKS 4
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+bool rejects(const char *yaml) {
+    labstor::LabStackDAG dag;
+    try {
+        dag.Compile(YAML::Load(yaml));
+    } catch(LABSTOR_ERROR_TYPE &err) {
+        return true;
+    }
+    return false;
+}
+
+int main() {
+    const char *stack =
+        "mount_point: \"fs::/home/compute\"\n"
+        "dag:\n"
+        "  v1: {labmod_uuid: \"driver::MQDriver\", labmod: \"MQDriver\", queue: throughput}\n"
+        "  v2: {labmod_uuid: \"comp::zlib\", labmod: \"ZlibFS\", next: \"iosched::NoOp\", worker_group: compress}\n"
+        "  v3: {labmod_uuid: \"fs::/home/compute\", labmod: \"LabFS\", next: [\"iosched::NoOp\", \"comp::zlib\"]}\n"
+        "  v4: {labmod_uuid: \"iosched::NoOp\", labmod: \"NoOp\", next: \"driver::MQDriver\", unordered: true}\n";
+    std::map<std::string, uint32_t> ns_ids = {
+        {"fs::/home/compute", 10}, {"comp::zlib", 11}, {"iosched::NoOp", 12}, {"driver::MQDriver", 13}
+    };
+    auto resolve = [&ns_ids](const std::string &key) -> uint32_t {
+        auto iter = ns_ids.find(key);
+        return iter == ns_ids.end() ? LABSTOR_INVALID_NAMESPACE_KEY : iter->second;
+    };
+
+    //Stages are ordered so that every stage precedes the stages it forwards to
+    labstor::LabStackDAG dag;
+    dag.Compile(YAML::Load(stack));
+    auto &stages = dag.GetStages();
+    check(stages.size() == 4, "Wrong number of stages");
+    std::map<std::string, size_t> pos;
+    for(size_t i = 0; i < stages.size(); ++i) { pos[stages[i].key_] = i; }
+    for(auto &stage : stages) {
+        for(auto &next : stage.next_) {
+            check(pos[stage.key_] < pos[next], "Stages are not in topological order");
+        }
+    }
+    check(dag.GetEntry().key_ == "fs::/home/compute", "Entry should be the mount point");
+    check(stages[pos["iosched::NoOp"]].num_prev_ == 2, "NoOp should have a fan-in of 2");
+    check(stages[pos["comp::zlib"]].worker_group_ == "compress", "Worker group lost");
+
+    //Invalid DAGs are rejected
+    check(rejects("mount_point: a\ndag:\n  v1: {labmod_uuid: a, labmod: A, next: b}\n  v2: {labmod_uuid: b, labmod: B, next: a}\n"), "Cycle accepted");
+    check(rejects("mount_point: a\ndag:\n  v1: {labmod_uuid: a, labmod: A, next: a}\n"), "Self loop accepted");
+    check(rejects("mount_point: a\ndag:\n  v1: {labmod_uuid: a, labmod: A}\n  v2: {labmod_uuid: a, labmod: B}\n"), "Duplicate accepted");
+    check(rejects("mount_point: a\ndag:\n  v1: {labmod_uuid: a, labmod: A, next: [b, b]}\n"), "Duplicate edge accepted");
+    check(rejects("mount_point: a\ndag:\n  v1: {labmod_uuid: a, labmod: A, queue: fast}\n"), "Bad queue hint accepted");
+    check(rejects("mount_point: a\n"), "Empty dag accepted");
+
+    //Build and publish the routes
+    uint32_t size = labstor::ipc::route_table::GetSize(MAX_ENTRIES, MAX_LABSTACKS);
+    char *region = (char*)calloc(1, size + 64);
+    labstor::ipc::route_table routes;
+    routes.Init(region, region + 64, MAX_ENTRIES, MAX_LABSTACKS);
+    labstor::ipc::labstack_routes *table = routes.AllocRoutes();
+    dag.BuildRoutes(table, resolve);
+    routes.Publish(table);
+    check(table->mount_ns_id_ == 10, "Wrong mount ns_id");
+    const labstor::ipc::labstack_stage *fs = routes.Get(10);
+    check(fs != nullptr && fs->num_next_ == 2 && fs->next_[0] == 12 && fs->next_[1] == 11, "Wrong fan-out");
+    const labstor::ipc::labstack_stage *noop = routes.Get(12);
+    check(noop->num_next_ == 1 && noop->next_[0] == 13 && noop->num_prev_ == 2, "Wrong NoOp route");
+    check(LABSTOR_QP_IS_UNORDERED(noop->qp_flags_), "Unordered hint lost");
+    check(LABSTOR_QP_IS_BATCH(routes.Get(13)->qp_flags_), "Throughput hint lost");
+    check(routes.Get(20) == nullptr, "Unrouted ns_id has a route");
+    check(routes.Get(11)->qp_type_ == 0, "Worker groups are resolved by the runtime, not the compiler");
+
+    //An edge to an unregistered stage fails to build
+    labstor::LabStackDAG dangling;
+    dangling.Compile(YAML::Load("mount_point: a\ndag:\n  v1: {labmod_uuid: fs::/home/compute, labmod: LabFS, next: missing}\n"));
+    bool threw = false;
+    try {
+        dangling.BuildRoutes(routes.AllocRoutes(), resolve);
+    } catch(LABSTOR_ERROR_TYPE &err) {
+        threw = true;
+    }
+    check(threw, "Unknown next stage accepted");
+
+    //A remount swaps in the new table while the old one stays readable until it is freed
+    labstor::LabStackDAG remount;
+    remount.Compile(YAML::Load(
+        "mount_point: \"fs::/home/compute\"\n"
+        "dag:\n"
+        "  v1: {labmod_uuid: \"fs::/home/compute\", labmod: \"LabFS\", next: \"driver::MQDriver\"}\n"));
+    labstor::ipc::labstack_routes *new_table = routes.AllocRoutes();
+    remount.BuildRoutes(new_table, resolve);
+    routes.Publish(new_table);
+    routes.Unpublish(table);
+    check(new_table->version_ > table->version_, "Version did not increase");
+    check(routes.Get(10)->num_next_ == 1 && routes.Get(10)->next_[0] == 13, "Remount not visible");
+    check(routes.Get(12) == nullptr, "Dropped stage still routed");
+    check(fs->next_[0] == 12, "Old table was modified");
+    routes.FreeRoutes(table);
+
+    //Tables come from a fixed pool
+    for(int i = 0; i < MAX_LABSTACKS - 2; ++i) {
+        check(routes.AllocRoutes() != nullptr, "Pool too small");
+    }
+    check(routes.AllocRoutes() == nullptr, "Pool should be exhausted");
+    free(region);
+    printf("SUCCESS\n");
+}
@@ -0,0 +1,106 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/macros.h>
+#include <labstor/userspace/server/module_manager.h>
+#include <labstor/userspace/server/namespace.h>
+#include <labstor/userspace/server/work_orchestrator.h>
+#include <string>
+#include <vector>
+
+#define NUM_INSTANCES 3
+
+/*The code running before the upgrade*/
+class OldModule : public labstor::Module {
+public:
+    OldModule() : Module("UpgradeModule") {}
+    bool Initialize(labstor::queue_pair*, labstor::ipc::request*, labstor::credentials*) override { return true; }
+    size_t EstCpuTime(labstor::ipc::request*) override { return 1; }
+};
+
+labstor::Module* CreateOldModule() {
+    return new OldModule();
+}
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv) {
+    if(argc != 2) {
+        printf("USAGE: ./test [upgrade_module.so]\n");
+        exit(1);
+    }
+    labstor::id module_id("UpgradeModule");
+    std::vector<uint32_t> ns_ids;
+    LABSTOR_CONFIGURATION_MANAGER->config_ = YAML::Load(
+            "{profile: userspace-only,"
+            " namespace: {max_entries: 64, max_collisions: 16, max_labstacks: 4, shmem_request_unit: 128, shmem_kb: 1024}}");
+    LABSTOR_NAMESPACE_T namespace_ = LABSTOR_NAMESPACE;
+    LABSTOR_MODULE_MANAGER_T module_manager_ = LABSTOR_MODULE_MANAGER;
+    labstor::ModuleHandle old_code = {CreateOldModule, nullptr};
+    module_manager_->SetModuleConstructor(module_id, old_code);
+    for(int i = 0; i < NUM_INSTANCES; ++i) {
+        ns_ids.emplace_back(namespace_->AddKey("upgrade_" + std::to_string(i), CreateOldModule()));
+    }
+
+    //The second instance's StateUpdate throws, after the first was upgraded
+    YAML::Node config;
+    config["code_upgrade"]["centralized"] = argv[1];
+    bool threw = false;
+    try {
+        module_manager_->CentralizedUpdateModule(config);
+    } catch(LABSTOR_ERROR_TYPE &err) {
+        threw = true;
+    }
+    check(threw, "A failed StateUpdate was not reported");
+
+    //Every ns_id is still served by an instance in the table and none stays paused
+    std::queue<labstor::Module*> instances = namespace_->AllModuleInstances(module_id);
+    check(instances.size() == NUM_INSTANCES, "An instance dropped out of the table");
+    for(auto ns_id : ns_ids) {
+        labstor::Module *module = namespace_->GetModule(ns_id);
+        bool found = false;
+        for(size_t i = 0; i < instances.size(); ++i) {
+            found |= instances.front() == module;
+            instances.push(instances.front());
+            instances.pop();
+        }
+        check(found, "An instance serving an ns_id is not in the table");
+        check(!namespace_->IsPaused(ns_id), "An ns_id stayed paused");
+    }
+
+    //The upgraded instance still runs the new code, and the others the old code
+    check(namespace_->GetModule(ns_ids[0])->EstCpuTime(nullptr) == 2, "The first instance was not upgraded");
+    check(namespace_->GetModule(ns_ids[1])->EstCpuTime(nullptr) == 1, "The failed instance was replaced");
+    check(namespace_->GetModule(ns_ids[2])->EstCpuTime(nullptr) == 1, "An instance after the failure was replaced");
+    check(module_manager_->GetModuleConstructor(module_id) == CreateOldModule, "The old constructor was replaced");
+    printf("SUCCESS\n");
+}
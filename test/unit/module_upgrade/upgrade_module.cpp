@@ -0,0 +1,44 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/types/module.h>
+
+/*The code an upgrade installs. Its second StateUpdate fails, as a layout change without a migration would.*/
+class UpgradeModule : public labstor::Module {
+public:
+    UpgradeModule() : Module("UpgradeModule") {}
+    bool Initialize(labstor::queue_pair*, labstor::ipc::request*, labstor::credentials*) override { return true; }
+    size_t EstCpuTime(labstor::ipc::request*) override { return 2; }
+    void StateUpdate(labstor::Module *prior) override {
+        static int num_updates = 0;
+        if(++num_updates == 2) {
+            throw labstor::STATE_LAYOUT_MISMATCH.format("state", prior->GetNamespaceID(), 1, 2);
+        }
+    }
+};
+
+LABSTOR_MODULE_CONSTRUCT(UpgradeModule, "UpgradeModule")
@@ -0,0 +1,101 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <labstor/types/data_structures/shmem_mount_trie.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct Case {
+    const char *path_;
+    bool found_;
+    uint32_t ns_id_;
+    uint32_t match_len_;
+};
+
+int main() {
+    uint32_t max_entries = 16, string_size = 4096;
+    uint32_t region_size = string_size + labstor::ipc::mount_trie::GetSize(max_entries);
+    char *region = (char*)malloc(region_size);
+    labstor::ipc::mount_trie trie;
+    trie.Init(region, region + string_size, labstor::ipc::mount_trie::GetSize(max_entries), max_entries);
+
+    //Mount points share prefixes so that edges get split
+    std::vector<std::string> mounts = {"lab::/home", "lab::/home/async", "lab::/home/sync", "lab::/h", "lab::dummy", "fs::/home/luke"};
+    char *str_region = region;
+    std::vector<char*> keys;
+    for(uint32_t i = 0; i < mounts.size(); ++i) {
+        labstor::ipc::string key;
+        key.Init(str_region, mounts[i]);
+        keys.emplace_back(str_region);
+        str_region += (labstor::ipc::string::GetSize(mounts[i].size()) + 7) & ~7;
+        if(labstor::ipc::mount_trie::IsMountPoint(key) != true || !trie.Insert(key, i)) {
+            printf("Failed to mount %s\n", mounts[i].c_str());
+            exit(1);
+        }
+    }
+
+    std::vector<Case> cases = {
+            {"lab::/home/async/file.txt", true, 1, 16},
+            {"lab::/home/sync", true, 2, 15},
+            {"lab::/home/synchronous/a", true, 0, 10},
+            {"lab::/home", true, 0, 10},
+            {"lab::/h/x", true, 3, 7},
+            {"lab::/ho", false, 0, 0},
+            {"lab::dummy/a/b/c", true, 4, 10},
+            {"fs::/home/luke/f", true, 5, 14},
+            {"fs::/home", false, 0, 0},
+            {"/home/async", false, 0, 0},
+    };
+    for(auto &c : cases) {
+        uint32_t ns_id = 0, match_len = 0;
+        bool found = trie.Find(c.path_, strlen(c.path_), ns_id, match_len);
+        if(found != c.found_ || (found && (ns_id != c.ns_id_ || match_len != c.match_len_))) {
+            printf("Wrong resolution for %s: found=%d ns_id=%u len=%u\n", c.path_, found, ns_id, match_len);
+            exit(1);
+        }
+    }
+
+    //Unmounting falls back to the enclosing mount point and bumps the generation
+    uint32_t gen = trie.GetGeneration(), ns_id = 0, match_len = 0;
+    labstor::ipc::string async_key;
+    async_key.Attach(keys[1]);
+    if(!trie.Remove(async_key) || trie.GetGeneration() == gen) {
+        printf("Failed to unmount %s\n", mounts[1].c_str());
+        exit(1);
+    }
+    if(!trie.Find("lab::/home/async/file.txt", 25, ns_id, match_len) || ns_id != 0) {
+        printf("Unmounted path resolved to %u\n", ns_id);
+        exit(1);
+    }
+
+    //Remounting the same key resolves its paths again
+    if(!trie.Insert(async_key, 1) || !trie.Find("lab::/home/async/file.txt", 25, ns_id, match_len) || ns_id != 1) {
+        printf("Remounted path resolved to %u\n", ns_id);
+        exit(1);
+    }
+    printf("Finished mount trie test\n");
+    free(region);
+}
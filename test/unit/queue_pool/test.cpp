@@ -0,0 +1,101 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/util/errors.h>
+#include <labstor/types/data_structures/c/shmem_queue_pair.h>
+#include <labstor/userspace/types/queue_pool.h>
+#include <unistd.h>
+#include <memory>
+
+#define QUEUE_DEPTH 16
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+/*A private queue pair of the given type in private memory*/
+struct TestQueue {
+    labstor::ipc::shmem_queue_pair qp_;
+    void *region_;
+
+    TestQueue(labstor_qid_type_t type, labstor_qid_flags_t flags, uint32_t cnt) {
+        labstor::ipc::qid_t qid;
+        qid.flags_ = flags;
+        qid.type_ = type;
+        qid.cnt_ = cnt;
+        qid.pid_ = getpid();
+        qid.ipc_id_ = 0;
+        uint32_t sq_size = labstor::ipc::request_queue::GetSize(QUEUE_DEPTH);
+        uint32_t cq_size = labstor::ipc::request_map::GetSize(QUEUE_DEPTH);
+        region_ = malloc(sq_size + cq_size);
+        qp_.Init(qid, region_, QUEUE_DEPTH, region_, sq_size, LABSTOR_REGION_ADD(sq_size, region_), cq_size);
+    }
+    ~TestQueue() {
+        free(region_);
+    }
+};
+
+/*A stage pinned to a worker group forwards on the group's queues, an unpinned stage on the shared pool*/
+void TestPinnedStage() {
+    labstor::QueuePool pool;
+    std::vector<std::unique_ptr<TestQueue>> queues;
+    int group_type = pool.RegisterQueuePairType("group:fast", LABSTOR_QP_ALL_FLAGS);
+    int num_shared = 4, num_group = 2;
+    pool.ReserveQueues(0, LABSTOR_QP_PRIVATE_DEFAULT, num_shared);
+    for(int i = 0; i < num_shared; ++i) {
+        queues.emplace_back(new TestQueue(0, LABSTOR_QP_PRIVATE_DEFAULT, i));
+        pool.RegisterQueuePair(&queues.back()->qp_);
+    }
+    pool.ReserveQueues(group_type, LABSTOR_QP_PRIVATE_DEFAULT, num_group);
+    for(int i = 0; i < num_group; ++i) {
+        queues.emplace_back(new TestQueue(group_type, LABSTOR_QP_PRIVATE_DEFAULT, i));
+        pool.RegisterQueuePair(&queues.back()->qp_);
+    }
+
+    for(uint32_t hash = 0; hash < 8; ++hash) {
+        labstor::queue_pair *qp;
+        pool.GetQueuePairOfType(qp, group_type, LABSTOR_QP_PRIVATE_DEFAULT, hash);
+        check(qp->GetQID().type_ == group_type, "A pinned stage did not land on its group's queue");
+        check(qp->GetQID().cnt_ == hash % num_group, "A pinned stage landed on the wrong group queue");
+        check(LABSTOR_QP_IS_INTERMEDIATE(qp->GetQID().flags_), "A pinned stage landed on a primary queue");
+
+        pool.GetQueuePairOfType(qp, 0, LABSTOR_QP_PRIVATE_DEFAULT, hash);
+        check(qp->GetQID().type_ == 0, "An unpinned stage did not land on the shared pool");
+
+        //A group with no queues of these flags falls back to the shared pool
+        pool.GetQueuePairOfType(qp, group_type + 1, LABSTOR_QP_PRIVATE_DEFAULT, hash);
+        check(qp->GetQID().type_ == 0, "An unknown group did not fall back to the shared pool");
+    }
+}
+
+int main() {
+    TestPinnedStage();
+    printf("SUCCESS\n");
+    return 0;
+}
@@ -0,0 +1,90 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <labstor/userspace/types/socket.h>
+#include <labmods/secure_shmem/memfd_client/secure_shmem_client_memfd.h>
+
+int main() {
+    int region_id;
+    size_t region_size = 128;
+    char *region;
+    int socks[2];
+    labstor::memfd::ShmemClient shmem;
+
+    //Create a shared memory region
+    region_id = shmem.CreateShmem(region_size, true);
+    printf("REGION ID: %d\n", region_id);
+    if(region_id < 0) {
+        printf("Failed to allocate region");
+        return -1;
+    }
+
+    //Map the shared memory region
+    region = (char*)shmem.MapShmem(region_id, region_size);
+    if(!region) {
+        perror("Can't open shmem");
+        return -1;
+    }
+    region[0] = 'h';
+
+    //Sealed regions cannot be resized
+    if(ftruncate(region_id, 0) == 0) {
+        printf("Region was not sealed\n");
+        return -1;
+    }
+
+    //Pass the region to another process, which writes to it
+    socketpair(AF_UNIX, SOCK_STREAM, 0, socks);
+    fflush(stdout);
+    int pid = fork();
+    if(pid == 0) {
+        labstor::UnixSocket sock(socks[1]);
+        int fd;
+        sock.RecvFDs(&fd, 1);
+        char *child_region = (char*)shmem.MapShmem(fd, region_size);
+        if(!child_region || child_region[0] != 'h') {
+            exit(1);
+        }
+        child_region[1] = 'i';
+        exit(0);
+    }
+    labstor::UnixSocket sock(socks[0]);
+    sock.SendFDs(&region_id, 1);
+    int status;
+    waitpid(pid, &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || region[1] != 'i') {
+        printf("Child did not see the region\n");
+        return -1;
+    }
+    printf("SUCCESS\n");
+
+    //Free the shared memory region
+    shmem.UnmapShmem(region, region_size);
+    shmem.FreeShmem(region_id);
+}
@@ -0,0 +1,108 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <labstor/userspace/server/state_manager.h>
+#include <cstdio>
+#include <cstdlib>
+
+struct index_v1 {
+    uint32_t keys_[1024];
+};
+
+struct index_v2 {
+    uint64_t keys_[1024];
+};
+
+void migrate_v1_to_v2(labstor::Server::module_state &old_state, labstor::Server::module_state &new_state) {
+    auto old_index = reinterpret_cast<index_v1*>(old_state.data_);
+    auto new_index = reinterpret_cast<index_v2*>(new_state.data_);
+    for(int i = 0; i < 1024; ++i) {
+        new_index->keys_[i] = old_index->keys_[i];
+    }
+}
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+int main() {
+    labstor::Server::StateManager states;
+    labstor::Server::module_state state, reattached;
+
+    //First attach creates a zeroed region
+    check(!states.Attach(5, "index", sizeof(index_v1), 1, state), "Region should be new");
+    auto index = reinterpret_cast<index_v1*>(state.data_);
+    for(int i = 0; i < 1024; ++i) {
+        check(index->keys_[i] == 0, "Region was not zeroed");
+        index->keys_[i] = i;
+    }
+
+    //An upgraded instance with the same layout gets the same memory back
+    check(states.Attach(5, "index", sizeof(index_v1), 1, reattached), "Region should exist");
+    check(reattached.data_ == state.data_, "Same layout should not copy");
+
+    //Other ns_ids and names do not alias
+    check(!states.Attach(6, "index", sizeof(index_v1), 1, reattached), "Region of ns_id 6 should be new");
+    check(reattached.data_ != state.data_, "Regions of different ns_ids alias");
+
+    //A new layout without a migration is rejected
+    bool threw = false;
+    try {
+        states.Attach(5, "index", sizeof(index_v2), 2, reattached);
+    } catch(LABSTOR_ERROR_TYPE &err) {
+        threw = true;
+    }
+    check(threw, "Layout change without migration should throw");
+
+    //A new layout with a migration converts the state
+    check(states.Attach(5, "index", sizeof(index_v2), 2, reattached, migrate_v1_to_v2), "Region should exist");
+    check(reattached.version_ == 2, "Version was not updated");
+    auto new_index = reinterpret_cast<index_v2*>(reattached.data_);
+    for(int i = 0; i < 1024; ++i) {
+        check(new_index->keys_[i] == (uint64_t)i, "Migration lost state");
+    }
+
+    //Until the upgrade commits, the old instance still uses the old region; a rollback gives it back
+    for(int i = 0; i < 1024; ++i) {
+        check(index->keys_[i] == (uint32_t)i, "Old region was freed before the upgrade committed");
+    }
+    states.Rollback(5);
+    check(states.Attach(5, "index", sizeof(index_v1), 1, reattached), "Region should exist");
+    check(reattached.data_ == state.data_ && reattached.version_ == 1, "Rollback did not restore the old region");
+
+    //Once committed, the new layout is the only one left
+    check(states.Attach(5, "index", sizeof(index_v2), 2, reattached, migrate_v1_to_v2), "Region should exist");
+    states.Commit(5);
+    states.Rollback(5);
+    check(states.Attach(5, "index", sizeof(index_v2), 2, state), "Region should exist");
+    check(state.data_ == reattached.data_ && state.version_ == 2, "Commit did not keep the new region");
+
+    states.Release(5, "index");
+    check(!states.Attach(5, "index", sizeof(index_v2), 2, reattached), "Released region should be new");
+    printf("SUCCESS\n");
+}
@@ -0,0 +1,78 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/types/tsc_clock.h>
+#include <cstdio>
+#include <cstdlib>
+
+#define CALIBRATE_NS 5000000ull
+#define MAX_ERROR_NS 200000
+#define NUM_READS 1000000
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+int main() {
+    struct labstor_tsc_clock clock;
+    labstor_tsc_clock_init(&clock, CALIBRATE_NS);
+    check((clock.seq_ & 1) == 0, "Calibration left the clock mid-update");
+    printf("Invariant TSC: %u, mult: %lu\n", clock.invariant_, (unsigned long)clock.mult_);
+
+    //The TSC clock tracks CLOCK_MONOTONIC
+    for(int i = 0; i < 10; ++i) {
+        int64_t before = (int64_t)labstor_clock_gettime_ns();
+        int64_t tsc_ns = (int64_t)labstor_tsc_clock_now_ns(&clock);
+        int64_t after = (int64_t)labstor_clock_gettime_ns();
+        check(tsc_ns >= before - MAX_ERROR_NS && tsc_ns <= after + MAX_ERROR_NS, "TSC clock drifted from CLOCK_MONOTONIC");
+    }
+
+    //Readings on one thread never go backwards
+    uint64_t prior = labstor_tsc_clock_now_ns(&clock);
+    for(int i = 0; i < NUM_READS; ++i) {
+        uint64_t now = labstor_tsc_clock_now_ns(&clock);
+        check(now >= prior, "TSC clock went backwards");
+        prior = now;
+    }
+
+    //Recalibration never moves the clock back
+    for(int i = 0; i < 32; ++i) {
+        prior = labstor_tsc_clock_now_ns(&clock);
+        labstor_tsc_clock_calibrate(&clock, CALIBRATE_NS / 32);
+        check(labstor_tsc_clock_now_ns(&clock) >= prior, "TSC clock jumped back across recalibration");
+    }
+    check(clock.seq_ == 2 + 2*32, "Recalibration did not bump the sequence");
+
+    //Without a clock page or an invariant TSC, readers use clock_gettime
+    uint64_t before = labstor_clock_gettime_ns();
+    check(labstor_tsc_clock_now_ns(nullptr) >= before, "Fallback clock is behind CLOCK_MONOTONIC");
+    clock.invariant_ = 0;
+    check(labstor_tsc_clock_now_ns(&clock) >= before, "Fallback clock is behind CLOCK_MONOTONIC");
+    return 0;
+}
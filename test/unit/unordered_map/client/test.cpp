@@ -31,11 +31,12 @@
 #include <cstdint>
 
 int main() {
-    uint32_t region_size = 8192;
+    uint32_t string_region_size = 8192;
     int num_inserts = 50;
     int max_collisions = 16;
     int num_buckets = 2*num_inserts + max_collisions;
     uint32_t map_region_size = labstor::ipc::mpmc::string_map::GetSize(num_buckets);
+    uint32_t region_size = string_region_size + map_region_size;
     void *region = malloc(region_size);
     char *string_region = (char*)region;
     char *map_region = (char*)region + region_size - map_region_size;
@@ -50,7 +51,7 @@ int main() {
     for(int i = 0; i < num_inserts; ++i) {
         LABSTOR_ERROR_HANDLE_START()
         labstor::ipc::string str;
-        str.Init(string_region + (i+16)*16, "hi" + std::to_string(i));
+        str.Init(string_region + (i+16)*32, "hi" + std::to_string(i));
         if(!map.Set(str, i)) {
             printf("Failed: %d\n", i);
             exit(1);
@@ -63,7 +64,7 @@ int main() {
     for(int i = 0; i < num_inserts; ++i) {
         LABSTOR_ERROR_HANDLE_START()
         labstor::ipc::string str;
-        str.Attach(string_region + (i+16)*16);
+        str.Attach(string_region + (i+16)*32);
         value = map[str];
         if(value != i) {
             printf("Value not set properly: %d\n", i);
@@ -76,7 +77,7 @@ int main() {
     //Test deletion
     for(int i = 0; i < num_inserts; ++i) {
         labstor::ipc::string str;
-        str.Attach(string_region + (i+16)*16);
+        str.Attach(string_region + (i+16)*32);
         if(!map.Remove(str)) {
             printf("Error removing %d\n", i);
             exit(1);
@@ -87,7 +88,7 @@ int main() {
     //Retest find
     for(int i = 0; i < num_inserts; ++i) {
         labstor::ipc::string str;
-        str.Attach(string_region + (i+16)*16);
+        str.Attach(string_region + (i+16)*32);
         if(map.Find(str, value)) {
             printf("Was still able to find map[%d]\n", i);
             exit(1);
@@ -0,0 +1,158 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <labstor/userspace/util/errors.h>
+#include <labstor/types/data_structures/unordered_map/shmem_int_map.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char **argv) {
+    uint32_t num_inserts = 1 << 16, num_readers = 4;
+    uint32_t region_size = labstor::ipc::mpmc::int_map<uint32_t,uint32_t>::GetSize(num_inserts);
+    void *region = malloc(region_size);
+    labstor::ipc::mpmc::int_map<uint32_t,uint32_t> map;
+    std::atomic<uint32_t> num_set(0);
+    std::atomic<uint32_t> num_missed(0);
+    std::vector<std::thread> readers;
+
+    //Start from the smallest table so that inserts trigger several rehashes
+    LABSTOR_ERROR_HANDLE_START()
+    map.Init(region, region, region_size, 0, 16);
+    LABSTOR_ERROR_HANDLE_END()
+
+    //Readers verify that every key already inserted stays visible while the table grows
+    for(uint32_t r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&, r]() {
+            uint32_t value, seed = r + 1;
+            while(num_set.load() < num_inserts) {
+                uint32_t count = num_set.load();
+                if(count == 0) { continue; }
+                seed = seed*1103515245 + 12345;
+                uint32_t key = seed % count;
+                if(!map.Find(key, value) || value != key) {
+                    ++num_missed;
+                }
+            }
+        });
+    }
+    for(uint32_t i = 0; i < num_inserts; ++i) {
+        if(!map.Set(i, i)) {
+            printf("Failed to set %u (buckets=%u)\n", i, map.GetNumBuckets());
+            exit(1);
+        }
+        num_set.store(i + 1);
+    }
+    for(auto &reader : readers) {
+        reader.join();
+    }
+    printf("Inserted %u entries, table has %u/%u buckets\n", num_inserts, map.GetNumBuckets(), map.GetMaxBuckets());
+    if(num_missed.load()) {
+        printf("Readers missed %u entries during resize\n", num_missed.load());
+        exit(1);
+    }
+
+    //Churn: remove and reinsert so that tombstones force rehashes of the same size
+    for(int round = 0; round < 8; ++round) {
+        for(uint32_t i = 0; i < num_inserts; i += 2) {
+            if(!map.Remove(i)) {
+                printf("Failed to remove %u in round %d\n", i, round);
+                exit(1);
+            }
+        }
+        for(uint32_t i = 0; i < num_inserts; i += 2) {
+            if(!map.Set(i, i + round)) {
+                printf("Failed to reinsert %u in round %d\n", i, round);
+                exit(1);
+            }
+        }
+    }
+    for(uint32_t i = 0; i < num_inserts; ++i) {
+        uint32_t value;
+        if(!map.Find(i, value) || value != ((i % 2) ? i : i + 7)) {
+            printf("Wrong value for %u after churn\n", i);
+            exit(1);
+        }
+    }
+
+    //A reader that dies inside a lookup leaves its count raised, which must not hang the next rehash
+    uint32_t dead_state = map.BeginRead();
+    for(int round = 0; round < 2; ++round) {
+        for(uint32_t i = 0; i < num_inserts; i += 2) {
+            map.Remove(i);
+        }
+        for(uint32_t i = 0; i < num_inserts; i += 2) {
+            if(!map.Set(i, i + 7)) {
+                printf("Failed to reinsert %u with a dead reader\n", i);
+                exit(1);
+            }
+        }
+    }
+    //Leaving a slot that newer readers took over must not release them
+    map.EndRead(dead_state);
+    for(uint32_t i = 0; i < num_inserts; ++i) {
+        uint32_t value;
+        if(!map.Find(i, value) || value != ((i % 2) ? i : i + 7)) {
+            printf("Wrong value for %u after a dead reader\n", i);
+            exit(1);
+        }
+    }
+
+    //Shrink: a rehash sized from a few live entries must still hold every insert made while it drains
+    uint32_t small_size = labstor::ipc::mpmc::int_map<uint32_t,uint32_t>::GetSize(4096);
+    void *small_region = malloc(small_size);
+    labstor::ipc::mpmc::int_map<uint32_t,uint32_t> small;
+    LABSTOR_ERROR_HANDLE_START()
+    small.Init(small_region, small_region, small_size, 4096, 16);
+    LABSTOR_ERROR_HANDLE_END()
+    for(uint32_t i = 0; i < 3000; ++i) {
+        if(!small.Set(i, i)) {
+            printf("Failed to set %u before shrinking\n", i);
+            exit(1);
+        }
+    }
+    for(uint32_t i = 0; i < 2990; ++i) {
+        small.Remove(i);
+    }
+    for(uint32_t i = 0; i < 3000; ++i) {
+        if(!small.Set(num_inserts + i, i)) {
+            printf("Failed to set fresh key #%u after shrinking (buckets=%u)\n", i, small.GetNumBuckets());
+            exit(1);
+        }
+    }
+    for(uint32_t i = 2990; i < 3000; ++i) {
+        uint32_t value;
+        if(!small.Find(i, value) || value != i || !small.Find(num_inserts + i, value) || value != i) {
+            printf("Lost key %u after shrinking\n", i);
+            exit(1);
+        }
+    }
+    free(small_region);
+
+    printf("Finished resize test\n");
+    free(region);
+}
@@ -24,3 +24,388 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/worker.h>
+#include <thread>
+
+#define QUEUE_DEPTH 64
+
+void check(bool cond, const char *msg) {
+    if(!cond) {
+        printf("%s\n", msg);
+        exit(1);
+    }
+}
+
+/*A namespace in private memory, so that workers can be run without a server*/
+class TestNamespace : public labstor::Namespace {
+public:
+    TestNamespace(uint32_t max_entries) {
+        private_state_.Init(max_entries);
+    }
+    uint32_t Add(labstor::Module *module) {
+        uint32_t ns_id = private_state_.Reserve();
+        PublishModule(ns_id, module);
+        return ns_id;
+    }
+};
+
+/*Completes every request and records the order they arrived in*/
+class RecordModule : public labstor::Module {
+public:
+    std::vector<labstor::ipc::request*> order_;
+    RecordModule() : labstor::Module("RecordModule") {}
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        order_.emplace_back(request);
+        qp->Complete(request);
+        return true;
+    }
+};
+
+/*Returns without completing the first time it sees a request, as a handler waiting on a device would*/
+class StartModule : public labstor::Module {
+public:
+    std::vector<labstor::ipc::request*> started_, completed_;
+    StartModule() : labstor::Module("StartModule") {}
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        if(std::find(started_.begin(), started_.end(), request) == started_.end()) {
+            started_.emplace_back(request);
+            return false;
+        }
+        completed_.emplace_back(request);
+        qp->Complete(request);
+        return true;
+    }
+};
+
+/*Completes at most two requests of each batch it is given, leaving the rest queued*/
+class PrefixModule : public labstor::Module {
+public:
+    std::vector<labstor::ipc::request*> completed_;
+    std::vector<labstor::ipc::request*> heads_;
+    PrefixModule() : labstor::Module("PrefixModule") {}
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return ProcessRequestBatch(qp, &request, 1, creds) == 1;
+    }
+    uint32_t ProcessRequestBatch(labstor::queue_pair *qp, labstor::ipc::request **requests, uint32_t n,
+                                 labstor::credentials *creds) override {
+        uint32_t num_complete = std::min(n, 2u);
+        heads_.emplace_back(requests[0]);
+        for(uint32_t i = 0; i < num_complete; ++i) {
+            completed_.emplace_back(requests[i]);
+            qp->Complete(requests[i]);
+        }
+        return num_complete;
+    }
+};
+
+/*
+ * Suspends every request on a sub-request which never completes, as a coroutine handler waiting on a
+ * downstream queue would
+ * */
+class SuspendModule : public labstor::Module {
+public:
+    labstor::queue_pair *down_qp_;
+    labstor::ipc::request *result_;
+    std::atomic<uint32_t> num_started_, num_destroyed_;
+    SuspendModule(labstor::queue_pair *down_qp) : labstor::Module("SuspendModule"), down_qp_(down_qp) {
+        num_started_ = 0;
+        num_destroyed_ = 0;
+    }
+    bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        return true;
+    }
+    bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override {
+        labstor::request_scheduler *scheduler = labstor::request_scheduler::GetCurrent();
+        labstor::suspended_request req;
+        req.frame_ = this;
+        req.resume_ = Resume;
+        req.destroy_ = Destroy;
+        req.await_qp_ = down_qp_;
+        req.await_req_id_ = 0;
+        req.result_ = &result_;
+        scheduler->SetOrigin(labstor::request_origin{qp, request, GetNamespaceID(), &num_suspended_});
+        scheduler->Suspend(req);
+        scheduler->SetOrigin(labstor::request_origin());
+        ++num_started_;
+        return true;
+    }
+    static bool Resume(void *frame) {
+        return true;
+    }
+    static void Destroy(void *frame) {
+        ++reinterpret_cast<SuspendModule*>(frame)->num_destroyed_;
+    }
+};
+
+/*A queue pair and its requests in private memory*/
+struct TestQueue {
+    labstor::ipc::shmem_queue_pair qp_;
+    labstor::ipc::request *rqs_;
+    void *region_;
+
+    TestQueue(uint8_t flags, uint32_t depth = QUEUE_DEPTH) {
+        labstor::ipc::qid_t qid;
+        qid.flags_ = flags;
+        qid.type_ = 0;
+        qid.cnt_ = 0;
+        qid.pid_ = getpid();
+        qid.ipc_id_ = 0;
+        uint32_t sq_size = labstor::ipc::request_queue::GetSize(depth);
+        uint32_t cq_size = labstor::ipc::request_map::GetSize(depth);
+        region_ = malloc(sq_size + cq_size + depth*sizeof(labstor::ipc::request));
+        qp_.Init(qid, region_, depth, region_, sq_size, LABSTOR_REGION_ADD(sq_size, region_), cq_size);
+        rqs_ = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, region_);
+    }
+    ~TestQueue() {
+        free(region_);
+    }
+    labstor::ipc::request* Submit(int i, uint32_t ns_id) {
+        labstor::ipc::qtok_t qtok;
+        labstor::ipc::request *rq = &rqs_[i];
+        rq->Start(0, ns_id, 0, 0);
+        check(qp_.Enqueue(rq, qtok), "Could not enqueue request");
+        return rq;
+    }
+    bool Failed(labstor::ipc::request *rq) {
+        labstor::ipc::request *done;
+        return qp_.IsComplete(rq->GetRequestID(), done) && done->GetCode() == (uint32_t)LABSTOR_REQUEST_FAILED;
+    }
+};
+
+/*Requests from an UNORDERED queue execute earliest-deadline-first, then in arrival order*/
+void TestDeadlineOrder() {
+    TestNamespace ns(16);
+    RecordModule module;
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue(LABSTOR_QP_UNORDERED);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+
+    //Deadline offsets in ms; -1 submits the request without a deadline
+    std::vector<int> offsets = {5, 1, -1, 7, 3, -1, 2, 0};
+    std::vector<int> expected = {7, 1, 6, 4, 0, 3, 2, 5};
+    uint64_t now_ns = labstor_get_monotonic_ns() + 1000000000ull;
+    for(size_t i = 0; i < offsets.size(); ++i) {
+        labstor::ipc::request *rq = queue.Submit(i, ns_id);
+        if(offsets[i] >= 0) {
+            rq->SetDeadline(now_ns + offsets[i]*1000000ull);
+        }
+    }
+    worker.AssignQP(&queue.qp_, &creds);
+    worker.DoWork();
+    check(module.order_.size() == offsets.size(), "Not every request executed");
+    for(size_t i = 0; i < expected.size(); ++i) {
+        check(module.order_[i] == &queue.rqs_[expected[i]], "Requests did not execute earliest-deadline-first");
+    }
+    check(worker.GetNumMissedDeadlines() == 0, "Counted a deadline that was not missed");
+    for(size_t i = 0; i < offsets.size(); ++i) {
+        check(!queue.rqs_[i].MissedDeadline(), "Marked a request which met its deadline");
+    }
+}
+
+/*A batch the module only partly completes leaves its tail queued, and only completed requests count as late*/
+void TestPartialBatch() {
+    TestNamespace ns(16);
+    PrefixModule module;
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue(0);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 4, &ns);
+    std::vector<labstor::ipc::request*> rqs;
+
+    //Every request is already past its deadline
+    for(int i = 0; i < 4; ++i) {
+        rqs.emplace_back(queue.Submit(i, ns_id));
+        rqs.back()->SetDeadline(1);
+    }
+    worker.AssignQP(&queue.qp_, &creds);
+    worker.DoWork();
+    check(module.completed_.size() == 2 && queue.qp_.GetDepth() == 2, "The tail of a partial batch was not left queued");
+    check(worker.GetNumMissedDeadlines() == 2, "Counted missed deadlines of requests which did not complete");
+    check(worker.GetNumMissedDeadlines(ns_id) == 2, "Missed deadlines were not counted for the ns_id");
+    check(worker.GetNumMissedDeadlines(ns_id + 1) == 0, "Missed deadlines were counted for another ns_id");
+    check(rqs[0]->MissedDeadline() && rqs[1]->MissedDeadline(), "Late completions were not marked on the request");
+
+    worker.DoWork();
+    check(module.heads_.size() == 2 && module.heads_[1] == rqs[2], "The queued tail was not passed again first");
+    check(module.completed_.size() == 4 && queue.qp_.GetDepth() == 0, "The queued tail did not complete");
+    check(worker.GetNumMissedDeadlines() == 4, "Missed deadlines were counted more than once");
+    check(rqs[2]->MissedDeadline() && rqs[3]->MissedDeadline(), "Late completions were not marked on the request");
+    rqs[0]->SetDeadline(1);
+    check(!rqs[0]->MissedDeadline(), "A new deadline kept the mark of the last one");
+}
+
+/*A request for an ns_id with no module fails and leaves the queue, so the requests behind it still run*/
+void TestMissingModule() {
+    TestNamespace ns(16);
+    RecordModule module;
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue(0);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+
+    labstor::ipc::request *missing = queue.Submit(0, ns_id + 1);
+    labstor::ipc::request *rq = queue.Submit(1, ns_id);
+    worker.AssignQP(&queue.qp_, &creds);
+    worker.DoWork();
+    check(queue.qp_.GetDepth() == 0, "A request for a missing module was left queued");
+    check(missing->GetCode() == (uint32_t)-1, "A request for a missing module did not fail");
+    check(module.order_.size() == 1 && module.order_[0] == rq, "The request behind it did not run");
+}
+
+/*Requests taken from a queue pair which is then removed from the worker fail instead of being dropped*/
+void TestRemovedQueue() {
+    TestNamespace ns(16);
+    RecordModule module;
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t ns_id = ns.Add(&module);
+    TestQueue queue(LABSTOR_QP_UNORDERED);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+    std::vector<labstor::ipc::request*> rqs;
+
+    //Hold the requests in the deadline queue while the module is paused
+    ns.PauseModule(ns_id);
+    for(int i = 0; i < 4; ++i) {
+        rqs.emplace_back(queue.Submit(i, ns_id));
+    }
+    worker.AssignQP(&queue.qp_, &creds);
+    worker.DoWork();
+    check(module.order_.empty(), "Executed a request of a paused module");
+    check(worker.RemoveQP(&queue.qp_), "Could not remove queue pair");
+    ns.ResumeModule(ns_id);
+    worker.DoWork();
+    check(module.order_.empty(), "Executed a request of a removed queue pair");
+    for(auto rq : rqs) {
+        check(queue.Failed(rq), "Request of a removed queue pair did not fail");
+    }
+}
+
+/*While a module is paused for an upgrade, the requests and handlers it already started still finish on it*/
+void TestDrainPaused() {
+    TestNamespace ns(16);
+    StartModule start_module;
+    TestQueue down_queue(0);
+    SuspendModule suspend_module(&down_queue.qp_);
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t start_ns = ns.Add(&start_module);
+    uint32_t suspend_ns = ns.Add(&suspend_module);
+    TestQueue unordered_queue(LABSTOR_QP_UNORDERED);
+    TestQueue ordered_queue(0);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+
+    unordered_queue.Submit(0, start_ns);
+    unordered_queue.Submit(1, start_ns);
+    ordered_queue.Submit(0, suspend_ns);
+    worker.AssignQP(&unordered_queue.qp_, &creds);
+    worker.AssignQP(&ordered_queue.qp_, &creds);
+    worker.DoWork();
+    check(start_module.GetNumPending() == 2, "Started requests were not counted");
+    check(suspend_module.GetNumPending() == 1, "Suspended handler was not counted");
+
+    //New requests wait for the paused module, the ones it started do not
+    ns.PauseModule(start_ns);
+    ns.PauseModule(suspend_ns);
+    labstor::ipc::request *held = unordered_queue.Submit(2, start_ns);
+    down_queue.qp_.Complete(down_queue.Submit(0, 0));
+    worker.DoWork();
+    check(start_module.completed_.size() == 2 && start_module.GetNumPending() == 0, "Started requests did not drain");
+    check(suspend_module.GetNumPending() == 0 && suspend_module.num_destroyed_ == 1, "Suspended handler did not drain");
+    check(std::find(start_module.started_.begin(), start_module.started_.end(), held) == start_module.started_.end(),
+          "Started a request of a paused module");
+
+    ns.ResumeModule(start_ns);
+    ns.ResumeModule(suspend_ns);
+    worker.DoWork();
+    worker.DoWork();
+    check(start_module.completed_.size() == 3 && start_module.GetNumPending() == 0, "Held request did not run after resuming");
+}
+
+/*Runs a worker on its own thread, as the work orchestrator does*/
+struct WorkerThread {
+    labstor::Server::Worker &worker_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+    WorkerThread(labstor::Server::Worker &worker) : worker_(worker), stop_(false) {
+        thread_ = std::thread([this]() {
+            while(!stop_.load()) { worker_.DoWork(); }
+        });
+    }
+    ~WorkerThread() {
+        stop_ = true;
+        thread_.join();
+    }
+};
+
+/*Queue pairs torn down with requests in the deadline queue and suspended handlers are safe to free*/
+void TestDestroyInFlight() {
+    TestNamespace ns(16);
+    RecordModule held_module;
+    TestQueue down_queue(0);
+    SuspendModule suspend_module(&down_queue.qp_);
+    labstor::credentials creds = {getpid(), 0, 0, 0};
+    uint32_t held_ns = ns.Add(&held_module);
+    uint32_t suspend_ns = ns.Add(&suspend_module);
+    TestQueue *unordered_queue = new TestQueue(LABSTOR_QP_UNORDERED);
+    TestQueue *ordered_queue = new TestQueue(0);
+    labstor::Server::Worker worker(16, 0, labstor::Server::WorkerRole::kGeneral, 1, &ns);
+    std::vector<labstor::ipc::request*> held_rqs, suspended_rqs;
+
+    ns.PauseModule(held_ns);
+    for(int i = 0; i < 4; ++i) {
+        held_rqs.emplace_back(unordered_queue->Submit(i, held_ns));
+        suspended_rqs.emplace_back(ordered_queue->Submit(i, suspend_ns));
+    }
+    worker.AssignQP(&unordered_queue->qp_, &creds);
+    worker.AssignQP(&ordered_queue->qp_, &creds);
+    {
+        WorkerThread thread(worker);
+        while(unordered_queue->qp_.GetDepth() || suspend_module.num_started_ < suspended_rqs.size()) {
+            LABSTOR_YIELD();
+        }
+
+        //Tear down both queues as WorkOrchestrator::RemoveQueuePair does
+        check(worker.RemoveQP(&unordered_queue->qp_), "Could not remove unordered queue pair");
+        worker.FlushQueuePairs(&unordered_queue->qp_);
+        check(worker.RemoveQP(&ordered_queue->qp_), "Could not remove ordered queue pair");
+        worker.FlushQueuePairs(&ordered_queue->qp_);
+        for(auto rq : held_rqs) {
+            check(unordered_queue->Failed(rq), "Request in the deadline queue did not fail");
+        }
+        for(auto rq : suspended_rqs) {
+            check(ordered_queue->Failed(rq), "Suspended request did not fail");
+        }
+        check(suspend_module.num_destroyed_ == suspended_rqs.size(), "Suspended handlers were not destroyed");
+        check(suspend_module.GetNumSuspended() == 0, "Cancelled handlers are still counted");
+
+        //The worker must not touch the freed queues in its later passes
+        delete unordered_queue;
+        delete ordered_queue;
+        ns.ResumeModule(held_ns);
+        worker.WaitForQuiescence();
+        worker.WaitForQuiescence();
+    }
+    check(held_module.order_.empty(), "Executed a request of a freed queue pair");
+}
+
+int main() {
+    LABSTOR_ERROR_HANDLE_START()
+    TestDeadlineOrder();
+    TestPartialBatch();
+    TestMissingModule();
+    TestRemovedQueue();
+    TestDrainPaused();
+    TestDestroyInFlight();
+    LABSTOR_ERROR_HANDLE_END()
+    printf("SUCCESS\n");
+    return 0;
+}
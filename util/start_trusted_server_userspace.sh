@@ -0,0 +1,3 @@
+#!/bin/bash
+
+${LABSTOR_BIN}/labstor_trusted_server ${LABSTOR_ROOT}/config/config_userspace.yaml
\ No newline at end of file